@@ -0,0 +1,1096 @@
+/*-------------------------------------------------------------------------
+ *
+ * arrow_export.c
+ *    Выгрузка путей в формате Apache Arrow IPC
+ *
+ * ee.export_arrow(query_ids, path) записывает пути указанных EXPLAIN
+ * запросов из ee.paths в файл на сервере в потоковом формате Arrow IPC
+ * (streaming format): схема, затем пакеты строк (record batch) по
+ * EE_ARROW_BATCH_ROWS путей. ee.export_arrow(query_ids) возвращает тот же
+ * поток значением bytea. Такой поток читается, например,
+ * pyarrow.ipc.open_stream() или polars.read_ipc_stream() без построчного
+ * разбора, как при выгрузке через COPY ... CSV.
+ *
+ * Названия путей и отношений, результаты add_path и результаты сравнения
+ * путей кодируются словарями: колонка хранит номера строк словаря (int32).
+ * Словари пополняются при том же единственном проходе по путям, строки
+ * нумеруются в порядке появления. Перед каждым пакетом строк в поток
+ * записываются строки словарей, появившиеся в этом пакете: перед первым --
+ * словари целиком, перед последующими -- их приращения (isDelta). Колонки
+ * pathkeys, required_outer и indexoid не выгружаются.
+ *
+ * Метаданные сообщений Arrow кодируются во flatbuffers. Для этого
+ * используется минимальный построитель, заполняющий буфер с конца, как и
+ * эталонная реализация flatbuffers.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_authid.h"
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+
+/* Количество путей в одном пакете строк */
+#define EE_ARROW_BATCH_ROWS 65536
+
+/* Пути запросов $1 из ee.paths и из упакованных ee.query.packed_paths */
+#define EE_ARROW_SOURCE \
+	"(SELECT * FROM ee.paths WHERE query_id = ANY($1) " \
+	"UNION ALL SELECT u.* FROM unnest($1) q(id), ee.unpack_paths(q.id) u) p"
+
+/* Максимальное количество полей таблицы flatbuffers */
+#define EE_FB_MAX_FIELDS 8
+
+/* Значения из Schema.fbs и Message.fbs формата Arrow */
+#define ARROW_METADATA_V5			4
+#define ARROW_HEADER_SCHEMA			1
+#define ARROW_HEADER_DICTIONARY		2
+#define ARROW_HEADER_RECORD_BATCH	3
+#define ARROW_TYPE_INT				2
+#define ARROW_TYPE_FLOATING_POINT	3
+#define ARROW_TYPE_UTF8				5
+#define ARROW_TYPE_BOOL				6
+#define ARROW_TYPE_LIST				12
+#define ARROW_PRECISION_DOUBLE		2
+
+/* Признак продолжения потока перед каждым сообщением */
+#define ARROW_CONTINUATION			0xFFFFFFFF
+
+typedef enum EEArrowType
+{
+	EE_ARROW_INT32,
+	EE_ARROW_INT64,
+	EE_ARROW_FLOAT64,
+	EE_ARROW_BOOL,
+	EE_ARROW_DICTIONARY,		/* text, закодированный словарем */
+	EE_ARROW_INT64_LIST,		/* bigint[] */
+} EEArrowType;
+
+typedef struct EEArrowColumnDef
+{
+	const char *name;
+	EEArrowType type;
+} EEArrowColumnDef;
+
+/*
+ * Выгружаемые колонки ee.paths
+ */
+static const EEArrowColumnDef arrow_columns[] = {
+	{"query_id", EE_ARROW_INT64},
+	{"subquery_id", EE_ARROW_INT64},
+	{"subquery_level", EE_ARROW_INT64},
+	{"rel_id", EE_ARROW_INT64},
+	{"path_id", EE_ARROW_INT64},
+	{"path_type", EE_ARROW_DICTIONARY},
+	{"child_paths", EE_ARROW_INT64_LIST},
+	{"startup_cost", EE_ARROW_FLOAT64},
+	{"total_cost", EE_ARROW_FLOAT64},
+	{"rows", EE_ARROW_INT32},
+	{"width", EE_ARROW_INT32},
+	{"rel_name", EE_ARROW_DICTIONARY},
+	{"rel_alias", EE_ARROW_DICTIONARY},
+	{"level", EE_ARROW_INT32},
+	{"add_path_result", EE_ARROW_DICTIONARY},
+	{"displaced_by", EE_ARROW_INT64},
+	{"cost_cmp", EE_ARROW_DICTIONARY},
+	{"fuzz_factor", EE_ARROW_FLOAT64},
+	{"pathkeys_cmp", EE_ARROW_DICTIONARY},
+	{"bms_cmp", EE_ARROW_DICTIONARY},
+	{"rows_cmp", EE_ARROW_DICTIONARY},
+	{"parallel_safe_cmp", EE_ARROW_DICTIONARY},
+	{"disabled_nodes", EE_ARROW_INT32},
+	{"plan_kind", EE_ARROW_DICTIONARY},
+	{"partial", EE_ARROW_BOOL},
+	{"parallel_aware", EE_ARROW_BOOL},
+	{"parallel_workers", EE_ARROW_INT32},
+	{"cheapest_total", EE_ARROW_BOOL},
+	{"cheapest_startup", EE_ARROW_BOOL},
+	{"cheapest_parameterized", EE_ARROW_BOOL},
+	{"in_final_plan", EE_ARROW_BOOL},
+	{"plan_depth", EE_ARROW_INT32},
+	{"agg_strategy", EE_ARROW_DICTIONARY},
+	{"num_groups", EE_ARROW_FLOAT64},
+	{"fingerprint", EE_ARROW_INT64},
+};
+
+#define EE_ARROW_NCOLUMNS lengthof(arrow_columns)
+
+/*
+ * Значения одной колонки в текущем пакете строк
+ */
+typedef struct EEArrowColumn
+{
+	const EEArrowColumnDef *def;
+
+	/* Битовая карта непустых значений и количество NULL */
+	uint8	   *validity;
+	int64		null_count;
+
+	/*
+	 * Значения колонки (для bool -- битовая карта, для словаря -- номера
+	 * строк словаря)
+	 */
+	char	   *values;
+
+	/* Для bigint[]: смещения списков в items и элементы списков */
+	int32	   *offsets;
+	StringInfoData items;
+
+	/*
+	 * Словарь: строки в порядке появления (dict_size -- размер массива),
+	 * таблица номеров строк и количество строк, уже записанных в поток
+	 */
+	char	  **dict;
+	int			ndict;
+	int			dict_size;
+	HTAB	   *dict_index;
+	int			nwritten;
+} EEArrowColumn;
+
+typedef struct EEArrowDictEntry
+{
+	char	   *value;
+	int32		index;
+} EEArrowDictEntry;
+
+/*
+ * Приемник потока: файл на сервере либо, если file равен NULL, буфер в
+ * памяти
+ */
+typedef struct EEArrowOutput
+{
+	FILE	   *file;
+	const char *path;
+	StringInfoData buf;
+} EEArrowOutput;
+
+/*
+ * Построитель flatbuffers.
+ *
+ * Буфер заполняется с конца: записанные байты занимают data[cap - used,
+ * cap). Объект задается количеством байт от конца буфера на момент
+ * окончания его записи (EEFlatRef), что не зависит от последующего
+ * расширения буфера.
+ */
+typedef uint32 EEFlatRef;
+
+typedef struct EEFlatBuilder
+{
+	uint8	   *data;
+	Size		cap;
+	Size		used;
+	Size		minalign;
+
+	/* Начало текущей таблицы и положения ее полей (0 -- поле не задано) */
+	Size		table_start;
+	Size		fields[EE_FB_MAX_FIELDS];
+	int			nfields;
+} EEFlatBuilder;
+
+/*
+ * Тело сообщения: буферы Arrow, выровненные на 8 байт, вместе с их
+ * описанием (смещение, длина) и описанием узлов (длина, количество NULL)
+ */
+typedef struct EEArrowBody
+{
+	StringInfoData data;
+	int64	   *buffers;
+	int			nbuffers;
+	int64	   *nodes;
+	int			nnodes;
+} EEArrowBody;
+
+static void
+fb_init(EEFlatBuilder *fb)
+{
+	fb->cap = 1024;
+	fb->data = (uint8 *) palloc(fb->cap);
+	fb->used = 0;
+	fb->minalign = 1;
+}
+
+static void
+fb_reset(EEFlatBuilder *fb)
+{
+	fb->used = 0;
+	fb->minalign = 1;
+}
+
+/*
+ * Резервирование места под n байт перед уже записанными
+ */
+static void
+fb_reserve(EEFlatBuilder *fb, Size n)
+{
+	Size		newcap;
+	uint8	   *newdata;
+
+	if (fb->used + n <= fb->cap)
+		return;
+
+	newcap = fb->cap;
+	while (fb->used + n > newcap)
+		newcap *= 2;
+
+	newdata = (uint8 *) palloc(newcap);
+	memcpy(newdata + newcap - fb->used, fb->data + fb->cap - fb->used, fb->used);
+	pfree(fb->data);
+
+	fb->data = newdata;
+	fb->cap = newcap;
+}
+
+static void
+fb_push(EEFlatBuilder *fb, const void *bytes, Size n)
+{
+	fb_reserve(fb, n);
+	fb->used += n;
+	memcpy(fb->data + fb->cap - fb->used, bytes, n);
+}
+
+static void
+fb_pad(EEFlatBuilder *fb, Size n)
+{
+	fb_reserve(fb, n);
+	fb->used += n;
+	memset(fb->data + fb->cap - fb->used, 0, n);
+}
+
+/*
+ * Выравнивание: после записи additional байт конец записанной части должен
+ * быть выровнен на align байт.
+ */
+static void
+fb_prep(EEFlatBuilder *fb, Size align, Size additional)
+{
+	if (align > fb->minalign)
+		fb->minalign = align;
+
+	fb_pad(fb, (~(fb->used + additional) + 1) & (align - 1));
+}
+
+/*
+ * Запись целых чисел. Flatbuffers всегда хранит числа в порядке
+ * little-endian.
+ */
+static void
+fb_push_uint(EEFlatBuilder *fb, uint64 value, Size size)
+{
+	uint8		bytes[8];
+	Size		i;
+
+	for (i = 0; i < size; i++)
+		bytes[i] = (uint8) (value >> (8 * i));
+
+	fb_push(fb, bytes, size);
+}
+
+/*
+ * Ссылка на ранее записанный объект. Ссылка -- беззнаковое смещение от
+ * самой ссылки до объекта.
+ */
+static void
+fb_push_ref(EEFlatBuilder *fb, EEFlatRef ref)
+{
+	fb_prep(fb, sizeof(uint32), 0);
+	fb_push_uint(fb, fb->used + sizeof(uint32) - ref, sizeof(uint32));
+}
+
+static EEFlatRef
+fb_string(EEFlatBuilder *fb, const char *str)
+{
+	Size		len = strlen(str);
+
+	fb_prep(fb, sizeof(uint32), len + 1);
+	fb_pad(fb, 1);
+	fb_push(fb, str, len);
+	fb_push_uint(fb, len, sizeof(uint32));
+
+	return fb->used;
+}
+
+/*
+ * Вектор ссылок на объекты
+ */
+static EEFlatRef
+fb_ref_vector(EEFlatBuilder *fb, const EEFlatRef *refs, int n)
+{
+	int			i;
+
+	fb_prep(fb, sizeof(uint32), sizeof(uint32) * n);
+	for (i = n - 1; i >= 0; i--)
+		fb_push_ref(fb, refs[i]);
+	fb_push_uint(fb, n, sizeof(uint32));
+
+	return fb->used;
+}
+
+/*
+ * Вектор структур из двух int64 (FieldNode и Buffer в Arrow). values
+ * содержит поля структур подряд.
+ */
+static EEFlatRef
+fb_pair_vector(EEFlatBuilder *fb, const int64 *values, int n)
+{
+	int			i;
+
+	fb_prep(fb, sizeof(uint32), 2 * sizeof(int64) * n);
+	fb_prep(fb, sizeof(int64), 2 * sizeof(int64) * n);
+	for (i = 2 * n - 1; i >= 0; i--)
+		fb_push_uint(fb, (uint64) values[i], sizeof(int64));
+	fb_push_uint(fb, n, sizeof(uint32));
+
+	return fb->used;
+}
+
+static void
+fb_start_table(EEFlatBuilder *fb)
+{
+	fb->table_start = fb->used;
+	fb->nfields = 0;
+	memset(fb->fields, 0, sizeof(fb->fields));
+}
+
+static void
+fb_add_scalar(EEFlatBuilder *fb, int field, uint64 value, Size size)
+{
+	Assert(field < EE_FB_MAX_FIELDS);
+
+	fb_prep(fb, size, 0);
+	fb_push_uint(fb, value, size);
+	fb->fields[field] = fb->used;
+	fb->nfields = Max(fb->nfields, field + 1);
+}
+
+static void
+fb_add_ref(EEFlatBuilder *fb, int field, EEFlatRef ref)
+{
+	Assert(field < EE_FB_MAX_FIELDS);
+
+	fb_push_ref(fb, ref);
+	fb->fields[field] = fb->used;
+	fb->nfields = Max(fb->nfields, field + 1);
+}
+
+/*
+ * Окончание таблицы: запись ссылки на vtable и самой vtable со смещениями
+ * полей относительно начала таблицы.
+ */
+static EEFlatRef
+fb_end_table(EEFlatBuilder *fb)
+{
+	EEFlatRef	table;
+	int32		vtable_offset;
+	int			i;
+
+	fb_prep(fb, sizeof(int32), 0);
+	fb_pad(fb, sizeof(int32));
+	table = fb->used;
+
+	for (i = fb->nfields - 1; i >= 0; i--)
+		fb_push_uint(fb, fb->fields[i] ? table - fb->fields[i] : 0,
+					 sizeof(uint16));
+	fb_push_uint(fb, table - fb->table_start, sizeof(uint16));
+	fb_push_uint(fb, (fb->nfields + 2) * sizeof(uint16), sizeof(uint16));
+
+	/* vtable расположена перед таблицей */
+	vtable_offset = fb->used - table;
+	for (i = 0; i < sizeof(int32); i++)
+		fb->data[fb->cap - table + i] = (uint8) (vtable_offset >> (8 * i));
+
+	return table;
+}
+
+static void
+fb_finish(EEFlatBuilder *fb, EEFlatRef root)
+{
+	fb_prep(fb, fb->minalign, sizeof(uint32));
+	fb_push_ref(fb, root);
+}
+
+/*
+ * Запись в приемник с проверкой ошибок записи в файл
+ */
+static void
+write_bytes(EEArrowOutput *out, const void *data, Size len)
+{
+	if (len == 0)
+		return;
+
+	if (out->file == NULL)
+		appendBinaryStringInfo(&out->buf, data, len);
+	else if (fwrite(data, 1, len, out->file) != len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m", out->path)));
+}
+
+static void
+write_uint32(EEArrowOutput *out, uint32 value)
+{
+	uint8		bytes[4];
+	int			i;
+
+	for (i = 0; i < 4; i++)
+		bytes[i] = (uint8) (value >> (8 * i));
+
+	write_bytes(out, bytes, 4);
+}
+
+static void
+body_reset(EEArrowBody *body)
+{
+	resetStringInfo(&body->data);
+	body->nbuffers = 0;
+	body->nnodes = 0;
+}
+
+static void
+body_add_node(EEArrowBody *body, int64 length, int64 null_count)
+{
+	body->nodes[2 * body->nnodes] = length;
+	body->nodes[2 * body->nnodes + 1] = null_count;
+	body->nnodes++;
+}
+
+static void
+body_add_buffer(EEArrowBody *body, const void *data, Size len)
+{
+	body->buffers[2 * body->nbuffers] = body->data.len;
+	body->buffers[2 * body->nbuffers + 1] = len;
+	body->nbuffers++;
+
+	if (len > 0)
+		appendBinaryStringInfo(&body->data, data, len);
+	while (body->data.len % 8 != 0)
+		appendStringInfoChar(&body->data, '\0');
+}
+
+/*
+ * Запись сообщения: признак продолжения, размер метаданных, метаданные
+ * (Message), дополненные до 8 байт, и тело сообщения.
+ */
+static void
+write_message(EEArrowOutput *out, EEFlatBuilder *fb,
+			  uint8 header_type, EEFlatRef header, EEArrowBody *body)
+{
+	EEFlatRef	message;
+	Size		padding;
+
+	fb_start_table(fb);
+	fb_add_scalar(fb, 3, body ? body->data.len : 0, sizeof(int64));
+	fb_add_ref(fb, 2, header);
+	fb_add_scalar(fb, 0, ARROW_METADATA_V5, sizeof(int16));
+	fb_add_scalar(fb, 1, header_type, sizeof(uint8));
+	message = fb_end_table(fb);
+	fb_finish(fb, message);
+
+	padding = (8 - fb->used % 8) % 8;
+
+	write_uint32(out, ARROW_CONTINUATION);
+	write_uint32(out, fb->used + padding);
+	write_bytes(out, fb->data + fb->cap - fb->used, fb->used);
+	write_bytes(out, "\0\0\0\0\0\0\0", padding);
+	if (body)
+		write_bytes(out, body->data.data, body->data.len);
+
+	fb_reset(fb);
+}
+
+/*
+ * Таблица Int: целочисленный тип со знаком указанной разрядности
+ */
+static EEFlatRef
+build_int_type(EEFlatBuilder *fb, int bit_width)
+{
+	fb_start_table(fb);
+	fb_add_scalar(fb, 0, bit_width, sizeof(int32));
+	fb_add_scalar(fb, 1, true, sizeof(uint8));
+	return fb_end_table(fb);
+}
+
+/*
+ * Таблица Field: описание колонки. children -- уже записанный вектор
+ * дочерних полей (читатели Arrow требуют его и для простых типов).
+ */
+static EEFlatRef
+build_field(EEFlatBuilder *fb, const char *name, uint8 type_type,
+			EEFlatRef type, EEFlatRef dictionary, EEFlatRef children)
+{
+	EEFlatRef	name_ref = fb_string(fb, name);
+
+	fb_start_table(fb);
+	fb_add_ref(fb, 0, name_ref);
+	fb_add_ref(fb, 3, type);
+	if (dictionary)
+		fb_add_ref(fb, 4, dictionary);
+	fb_add_ref(fb, 5, children);
+	fb_add_scalar(fb, 1, true, sizeof(uint8));
+	fb_add_scalar(fb, 2, type_type, sizeof(uint8));
+	return fb_end_table(fb);
+}
+
+/*
+ * Сообщение Schema
+ */
+static void
+write_schema(EEArrowOutput *out, EEFlatBuilder *fb)
+{
+	EEFlatRef	fields[EE_ARROW_NCOLUMNS];
+	EEFlatRef	fields_ref;
+	EEFlatRef	schema;
+	int			i;
+
+	for (i = 0; i < EE_ARROW_NCOLUMNS; i++)
+	{
+		const EEArrowColumnDef *def = &arrow_columns[i];
+		EEFlatRef	children = fb_ref_vector(fb, NULL, 0);
+		EEFlatRef	type;
+		EEFlatRef	dictionary = 0;
+		uint8		type_type;
+
+		switch (def->type)
+		{
+			case EE_ARROW_INT32:
+				type = build_int_type(fb, 32);
+				type_type = ARROW_TYPE_INT;
+				break;
+			case EE_ARROW_INT64:
+				type = build_int_type(fb, 64);
+				type_type = ARROW_TYPE_INT;
+				break;
+			case EE_ARROW_FLOAT64:
+				fb_start_table(fb);
+				fb_add_scalar(fb, 0, ARROW_PRECISION_DOUBLE, sizeof(int16));
+				type = fb_end_table(fb);
+				type_type = ARROW_TYPE_FLOATING_POINT;
+				break;
+			case EE_ARROW_BOOL:
+				fb_start_table(fb);
+				type = fb_end_table(fb);
+				type_type = ARROW_TYPE_BOOL;
+				break;
+			case EE_ARROW_DICTIONARY:
+				{
+					EEFlatRef	index_type = build_int_type(fb, 32);
+
+					/* DictionaryEncoding: id словаря -- номер колонки */
+					fb_start_table(fb);
+					fb_add_scalar(fb, 0, i, sizeof(int64));
+					fb_add_ref(fb, 1, index_type);
+					dictionary = fb_end_table(fb);
+
+					fb_start_table(fb);
+					type = fb_end_table(fb);
+					type_type = ARROW_TYPE_UTF8;
+					break;
+				}
+			case EE_ARROW_INT64_LIST:
+				{
+					EEFlatRef	item_children = children;
+					EEFlatRef	item;
+
+					type = build_int_type(fb, 64);
+					item = build_field(fb, "item", ARROW_TYPE_INT, type, 0,
+									   item_children);
+					children = fb_ref_vector(fb, &item, 1);
+
+					fb_start_table(fb);
+					type = fb_end_table(fb);
+					type_type = ARROW_TYPE_LIST;
+					break;
+				}
+			default:
+				elog(ERROR, "unrecognized arrow column type: %d", (int) def->type);
+		}
+
+		fields[i] = build_field(fb, def->name, type_type, type, dictionary,
+								children);
+	}
+
+	fields_ref = fb_ref_vector(fb, fields, EE_ARROW_NCOLUMNS);
+
+	fb_start_table(fb);
+	fb_add_ref(fb, 1, fields_ref);
+#ifdef WORDS_BIGENDIAN
+	fb_add_scalar(fb, 0, 1, sizeof(int16));
+#else
+	fb_add_scalar(fb, 0, 0, sizeof(int16));
+#endif
+	schema = fb_end_table(fb);
+
+	write_message(out, fb, ARROW_HEADER_SCHEMA, schema, NULL);
+}
+
+/*
+ * Таблица RecordBatch по описанию узлов и буферов тела сообщения
+ */
+static EEFlatRef
+build_record_batch(EEFlatBuilder *fb, int64 length, EEArrowBody *body)
+{
+	EEFlatRef	nodes = fb_pair_vector(fb, body->nodes, body->nnodes);
+	EEFlatRef	buffers = fb_pair_vector(fb, body->buffers, body->nbuffers);
+
+	fb_start_table(fb);
+	fb_add_scalar(fb, 0, length, sizeof(int64));
+	fb_add_ref(fb, 1, nodes);
+	fb_add_ref(fb, 2, buffers);
+	return fb_end_table(fb);
+}
+
+/*
+ * Сообщение DictionaryBatch со строками словаря колонки, еще не записанными
+ * в поток. Первое сообщение словаря содержит его целиком, последующие --
+ * приращения.
+ */
+static void
+write_dictionary(EEArrowOutput *out, EEFlatBuilder *fb,
+				 EEArrowBody *body, int column, EEArrowColumn *col)
+{
+	StringInfoData values;
+	int32	   *offsets;
+	int			nvalues = col->ndict - col->nwritten;
+	EEFlatRef	data;
+	EEFlatRef	batch;
+	int			i;
+
+	initStringInfo(&values);
+	offsets = (int32 *) palloc((nvalues + 1) * sizeof(int32));
+
+	offsets[0] = 0;
+	for (i = 0; i < nvalues; i++)
+	{
+		appendStringInfoString(&values, col->dict[col->nwritten + i]);
+		offsets[i + 1] = values.len;
+	}
+
+	body_reset(body);
+	body_add_node(body, nvalues, 0);
+	body_add_buffer(body, NULL, 0);
+	body_add_buffer(body, offsets, (nvalues + 1) * sizeof(int32));
+	body_add_buffer(body, values.data, values.len);
+
+	data = build_record_batch(fb, nvalues, body);
+
+	fb_start_table(fb);
+	fb_add_scalar(fb, 0, column, sizeof(int64));
+	fb_add_ref(fb, 1, data);
+	if (col->nwritten > 0)
+		fb_add_scalar(fb, 2, true, sizeof(uint8));
+	batch = fb_end_table(fb);
+
+	write_message(out, fb, ARROW_HEADER_DICTIONARY, batch, body);
+
+	col->nwritten = col->ndict;
+
+	pfree(offsets);
+	pfree(values.data);
+}
+
+/*
+ * Сообщение RecordBatch с накопленными значениями колонок
+ */
+static void
+write_record_batch(EEArrowOutput *out, EEFlatBuilder *fb,
+				   EEArrowBody *body, EEArrowColumn *columns, int nrows)
+{
+	Size		bitmap_len = (nrows + 7) / 8;
+	EEFlatRef	batch;
+	int			i;
+
+	body_reset(body);
+
+	for (i = 0; i < EE_ARROW_NCOLUMNS; i++)
+	{
+		EEArrowColumn *col = &columns[i];
+
+		body_add_node(body, nrows, col->null_count);
+
+		/* Битовая карта не нужна, если NULL в колонке нет */
+		body_add_buffer(body, col->validity,
+						col->null_count > 0 ? bitmap_len : 0);
+
+		switch (col->def->type)
+		{
+			case EE_ARROW_INT32:
+			case EE_ARROW_DICTIONARY:
+				body_add_buffer(body, col->values, nrows * sizeof(int32));
+				break;
+			case EE_ARROW_INT64:
+			case EE_ARROW_FLOAT64:
+				body_add_buffer(body, col->values, nrows * sizeof(int64));
+				break;
+			case EE_ARROW_BOOL:
+				body_add_buffer(body, col->values, bitmap_len);
+				break;
+			case EE_ARROW_INT64_LIST:
+				body_add_buffer(body, col->offsets, (nrows + 1) * sizeof(int32));
+				body_add_node(body, col->items.len / sizeof(int64), 0);
+				body_add_buffer(body, NULL, 0);
+				body_add_buffer(body, col->items.data, col->items.len);
+				break;
+		}
+	}
+
+	batch = build_record_batch(fb, nrows, body);
+	write_message(out, fb, ARROW_HEADER_RECORD_BATCH, batch, body);
+}
+
+/*
+ * Хеш-функция и функция сравнения для таблицы номеров строк словаря.
+ * Ключом является указатель на строку, сравнивается же содержимое.
+ */
+static uint32
+dict_hash(const void *key, Size keysize)
+{
+	const char *str = *(char *const *) key;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) str, strlen(str)));
+}
+
+static int
+dict_match(const void *key1, const void *key2, Size keysize)
+{
+	return strcmp(*(char *const *) key1, *(char *const *) key2);
+}
+
+/*
+ * Создание пустого словаря колонки в текущем контексте памяти
+ */
+static void
+init_dictionary(EEArrowColumn *col)
+{
+	HASHCTL		ctl;
+
+	col->dict_size = 64;
+	col->dict = (char **) palloc(col->dict_size * sizeof(char *));
+
+	memset(&ctl, 0, sizeof(HASHCTL));
+	ctl.keysize = sizeof(char *);
+	ctl.entrysize = sizeof(EEArrowDictEntry);
+	ctl.hash = dict_hash;
+	ctl.match = dict_match;
+	ctl.hcxt = CurrentMemoryContext;
+	col->dict_index = hash_create("ee.export_arrow dictionary", 64, &ctl,
+								  HASH_ELEM | HASH_FUNCTION |
+								  HASH_COMPARE | HASH_CONTEXT);
+}
+
+/*
+ * Номер строки str в словаре колонки. Новая строка добавляется в конец
+ * словаря, ее копия размещается в контексте памяти словаря.
+ */
+static int32
+dictionary_index(EEArrowColumn *col, char *str)
+{
+	EEArrowDictEntry *entry;
+	bool		found;
+
+	entry = (EEArrowDictEntry *) hash_search(col->dict_index, &str,
+											 HASH_ENTER, &found);
+
+	if (!found)
+	{
+		MemoryContext dict_ctx = GetMemoryChunkContext(col->dict);
+
+		if (col->ndict == col->dict_size)
+		{
+			col->dict_size *= 2;
+			col->dict = (char **) repalloc(col->dict,
+										   col->dict_size * sizeof(char *));
+		}
+
+		entry->value = MemoryContextStrdup(dict_ctx, str);
+		entry->index = col->ndict;
+		col->dict[col->ndict++] = entry->value;
+	}
+
+	return entry->index;
+}
+
+/*
+ * Добавление значения колонки в пакет строк
+ */
+static void
+append_value(EEArrowColumn *col, int row, Datum value, bool isnull)
+{
+	if (col->def->type == EE_ARROW_INT64_LIST)
+		col->offsets[row + 1] = col->offsets[row];
+
+	if (isnull)
+	{
+		col->null_count++;
+		return;
+	}
+
+	col->validity[row / 8] |= 1 << (row % 8);
+
+	switch (col->def->type)
+	{
+		case EE_ARROW_INT32:
+			((int32 *) col->values)[row] = DatumGetInt32(value);
+			break;
+		case EE_ARROW_INT64:
+			((int64 *) col->values)[row] = DatumGetInt64(value);
+			break;
+		case EE_ARROW_FLOAT64:
+			((float8 *) col->values)[row] = DatumGetFloat8(value);
+			break;
+		case EE_ARROW_BOOL:
+			if (DatumGetBool(value))
+				((uint8 *) col->values)[row / 8] |= 1 << (row % 8);
+			break;
+		case EE_ARROW_DICTIONARY:
+			{
+				char	   *str = TextDatumGetCString(value);
+
+				((int32 *) col->values)[row] = dictionary_index(col, str);
+				pfree(str);
+				break;
+			}
+		case EE_ARROW_INT64_LIST:
+			{
+				ArrayType  *arr = DatumGetArrayTypeP(value);
+				Datum	   *elems;
+				bool	   *elem_nulls;
+				int			nelems;
+				int			i;
+
+				deconstruct_array(arr, INT8OID, sizeof(int64), FLOAT8PASSBYVAL,
+								  TYPALIGN_DOUBLE, &elems, &elem_nulls, &nelems);
+
+				for (i = 0; i < nelems; i++)
+				{
+					int64		item = elem_nulls[i] ? 0 : DatumGetInt64(elems[i]);
+
+					appendBinaryStringInfo(&col->items, &item, sizeof(int64));
+				}
+
+				col->offsets[row + 1] += nelems;
+				break;
+			}
+	}
+}
+
+/*
+ * Запись потока Arrow IPC с путями EXPLAIN запросов query_ids в приемник
+ * out. Возвращает количество выгруженных путей.
+ */
+static int64
+export_paths(Datum query_ids, EEArrowOutput *out)
+{
+	Oid			argtypes[1] = {INT8ARRAYOID};
+	MemoryContext export_ctx;
+	MemoryContext batch_ctx;
+	MemoryContext old_ctx;
+	EEArrowColumn columns[EE_ARROW_NCOLUMNS];
+	EEFlatBuilder fb;
+	EEArrowBody body;
+	StringInfoData sql;
+	Portal		portal;
+	int64		total_rows = 0;
+	int			i;
+
+	export_ctx = AllocSetContextCreate(CurrentMemoryContext,
+									   "ee.export_arrow",
+									   ALLOCSET_DEFAULT_SIZES);
+	batch_ctx = AllocSetContextCreate(export_ctx,
+									  "ee.export_arrow batch",
+									  ALLOCSET_DEFAULT_SIZES);
+	old_ctx = MemoryContextSwitchTo(export_ctx);
+
+	fb_init(&fb);
+	initStringInfo(&body.data);
+	body.buffers = (int64 *) palloc(sizeof(int64) * 2 * 3 * (EE_ARROW_NCOLUMNS + 1));
+	body.nodes = (int64 *) palloc(sizeof(int64) * 2 * (EE_ARROW_NCOLUMNS + 1));
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql, "SELECT ");
+	for (i = 0; i < EE_ARROW_NCOLUMNS; i++)
+	{
+		EEArrowColumn *col = &columns[i];
+
+		memset(col, 0, sizeof(EEArrowColumn));
+		col->def = &arrow_columns[i];
+		col->validity = (uint8 *) palloc((EE_ARROW_BATCH_ROWS + 7) / 8);
+		col->values = (char *) palloc(EE_ARROW_BATCH_ROWS * sizeof(int64));
+		if (col->def->type == EE_ARROW_INT64_LIST)
+		{
+			col->offsets = (int32 *) palloc((EE_ARROW_BATCH_ROWS + 1) * sizeof(int32));
+			initStringInfo(&col->items);
+		}
+		else if (col->def->type == EE_ARROW_DICTIONARY)
+			init_dictionary(col);
+
+		appendStringInfo(&sql, "%s%s", i > 0 ? ", " : "", col->def->name);
+	}
+	appendStringInfoString(&sql,
+						   " FROM " EE_ARROW_SOURCE
+						   " ORDER BY query_id, path_id");
+
+	MemoryContextSwitchTo(old_ctx);
+
+	SPI_connect();
+
+	write_schema(out, &fb);
+
+	portal = SPI_cursor_open_with_args(NULL, sql.data, 1, argtypes, &query_ids,
+									   NULL, true, 0);
+
+	for (;;)
+	{
+		uint64		row;
+
+		SPI_cursor_fetch(portal, true, EE_ARROW_BATCH_ROWS);
+
+		if (SPI_processed == 0)
+			break;
+
+		MemoryContextSwitchTo(batch_ctx);
+
+		for (i = 0; i < EE_ARROW_NCOLUMNS; i++)
+		{
+			EEArrowColumn *col = &columns[i];
+
+			memset(col->validity, 0, (EE_ARROW_BATCH_ROWS + 7) / 8);
+			memset(col->values, 0, EE_ARROW_BATCH_ROWS * sizeof(int64));
+			col->null_count = 0;
+			if (col->def->type == EE_ARROW_INT64_LIST)
+			{
+				col->offsets[0] = 0;
+				resetStringInfo(&col->items);
+			}
+		}
+
+		for (row = 0; row < SPI_processed; row++)
+		{
+			HeapTuple	tuple = SPI_tuptable->vals[row];
+
+			for (i = 0; i < EE_ARROW_NCOLUMNS; i++)
+			{
+				Datum		value;
+				bool		isnull;
+
+				value = SPI_getbinval(tuple, SPI_tuptable->tupdesc, i + 1, &isnull);
+				append_value(&columns[i], row, value, isnull);
+			}
+		}
+
+		MemoryContextSwitchTo(export_ctx);
+
+		/*
+		 * Словари нужны читателю до первого пакета строк, даже пустые;
+		 * приращения записываются, только если в пакете появились новые
+		 * строки.
+		 */
+		for (i = 0; i < EE_ARROW_NCOLUMNS; i++)
+		{
+			EEArrowColumn *col = &columns[i];
+
+			if (col->def->type == EE_ARROW_DICTIONARY &&
+				(total_rows == 0 || col->ndict > col->nwritten))
+				write_dictionary(out, &fb, &body, i, col);
+		}
+
+		write_record_batch(out, &fb, &body, columns, SPI_processed);
+
+		MemoryContextSwitchTo(old_ctx);
+		MemoryContextReset(batch_ctx);
+
+		total_rows += SPI_processed;
+		SPI_freetuptable(SPI_tuptable);
+	}
+
+	SPI_cursor_close(portal);
+
+	/* Признак конца потока */
+	write_uint32(out, ARROW_CONTINUATION);
+	write_uint32(out, 0);
+
+	SPI_finish();
+
+	MemoryContextDelete(export_ctx);
+
+	return total_rows;
+}
+
+/*
+ * Выгрузка путей EXPLAIN запросов в файл в формате Arrow IPC.
+ * Возвращает количество выгруженных путей.
+ */
+PG_FUNCTION_INFO_V1(ee_export_arrow);
+
+Datum
+ee_export_arrow(PG_FUNCTION_ARGS)
+{
+	Datum		query_ids = PG_GETARG_DATUM(0);
+	char	   *path = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	EEArrowOutput out;
+	int64		total_rows;
+
+	/* Запись файлов на сервере разрешена тем же ролям, что и COPY TO */
+	if (!has_privs_of_role(GetUserId(), ROLE_PG_WRITE_SERVER_FILES))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("permission denied to export paths to a file"),
+				 errdetail("Only roles with privileges of the \"%s\" role may write files on the server.",
+						   "pg_write_server_files")));
+
+	if (!is_absolute_path(path))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_NAME),
+				 errmsg("relative path not allowed for ee.export_arrow")));
+
+	out.path = path;
+	out.file = AllocateFile(path, PG_BINARY_W);
+	if (out.file == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\" for writing: %m", path)));
+
+	total_rows = export_paths(query_ids, &out);
+
+	if (FreeFile(out.file) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", path)));
+
+	PG_RETURN_INT64(total_rows);
+}
+
+/*
+ * Поток Arrow IPC с путями EXPLAIN запросов в виде значения bytea -- для
+ * клиентов, читающих его через SQL, без записи файла на сервере
+ */
+PG_FUNCTION_INFO_V1(ee_export_arrow_bytea);
+
+Datum
+ee_export_arrow_bytea(PG_FUNCTION_ARGS)
+{
+	Datum		query_ids = PG_GETARG_DATUM(0);
+	EEArrowOutput out;
+	bytea	   *result;
+
+	out.file = NULL;
+	out.path = NULL;
+	initStringInfo(&out.buf);
+
+	export_paths(query_ids, &out);
+
+	result = (bytea *) palloc(VARHDRSZ + out.buf.len);
+	SET_VARSIZE(result, VARHDRSZ + out.buf.len);
+	memcpy(VARDATA(result), out.buf.data, out.buf.len);
+
+	PG_RETURN_BYTEA_P(result);
+}
@@ -0,0 +1,205 @@
+/*-------------------------------------------------------------------------
+ *
+ * backend_capture.c
+ *    Сбор путей запросов другого обслуживающего процесса
+ *
+ * Функция ee.capture_backend(pid, n) выставляет в разделяемой памяти
+ * счетчик запросов на сбор путей для процесса pid. Процесс проверяет
+ * счетчик в начале каждого планирования (planner_hook) и, если он не
+ * равен нулю, уменьшает его и собирает пути так же, как это делает
+ * EXPLAIN (get_paths). Собранные пути сразу записываются в журнал сборов
+ * (capture_log.c): запись в таблицы расширения выполнялась бы в
+ * транзакциях приложения и от имени его роли.
+ *
+ * Для работы требуется загрузка расширения через shared_preload_libraries.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/backend_capture.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+
+/*
+ * Запрос на сбор путей для одного обслуживающего процесса.
+ *
+ * Слоты индексируются номером PGPROC процесса. Поле pid позволяет не
+ * выполнять запрос, оставшийся от завершившегося процесса, если его слот
+ * занял новый процесс.
+ */
+typedef struct EECaptureRequest
+{
+	int			pid;
+	pg_atomic_uint32 nplannings;
+} EECaptureRequest;
+
+typedef struct EEBackendCaptureShared
+{
+	EECaptureRequest requests[FLEXIBLE_ARRAY_MEMBER];
+} EEBackendCaptureShared;
+
+static EEBackendCaptureShared *ee_shared = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static Size
+ee_shmem_size(void)
+{
+	return add_size(offsetof(EEBackendCaptureShared, requests),
+					mul_size(MaxBackends, sizeof(EECaptureRequest)));
+}
+
+static void
+ee_shmem_request(void)
+{
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	RequestAddinShmemSpace(ee_shmem_size());
+}
+
+static void
+ee_shmem_startup(void)
+{
+	bool		found;
+	int			i;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	ee_shared = ShmemInitStruct("extended_explain", ee_shmem_size(), &found);
+
+	if (!found)
+	{
+		for (i = 0; i < MaxBackends; i++)
+		{
+			ee_shared->requests[i].pid = 0;
+			pg_atomic_init_u32(&ee_shared->requests[i].nplannings, 0);
+		}
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Регистрация хуков разделяемой памяти. Вызывается из _PG_init при загрузке
+ * через shared_preload_libraries.
+ */
+void
+ee_backend_capture_init(void)
+{
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = ee_shmem_request;
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = ee_shmem_startup;
+}
+
+/*
+ * Проверка запроса на сбор путей для текущего процесса.
+ *
+ * Возвращает true и уменьшает счетчик, если следующее планирование
+ * необходимо перехватить. Вызывается при каждом планировании, поэтому в
+ * обычном случае выполняет только одно атомарное чтение.
+ */
+bool
+ee_consume_capture_request(void)
+{
+	EECaptureRequest *request;
+	uint32		nplannings;
+
+	if (ee_shared == NULL || MyProc == NULL)
+		return false;
+
+	request = &ee_shared->requests[MyProcNumber];
+
+	nplannings = pg_atomic_read_u32(&request->nplannings);
+
+	while (nplannings > 0)
+	{
+		pg_read_barrier();
+
+		/* Запрос адресован завершившемуся процессу */
+		if (request->pid != MyProcPid)
+			return false;
+
+		if (pg_atomic_compare_exchange_u32(&request->nplannings,
+										   &nplannings, nplannings - 1))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * ee.capture_backend(pid, n) -- сбор путей следующих n планирований
+ * процесса pid.
+ *
+ * Как и pg_log_backend_memory_contexts, возвращает false с предупреждением,
+ * если процесс не найден.
+ */
+PG_FUNCTION_INFO_V1(ee_capture_backend);
+
+Datum
+ee_capture_backend(PG_FUNCTION_ARGS)
+{
+	int			pid = PG_GETARG_INT32(0);
+	int32		n = PG_GETARG_INT32(1);
+	PGPROC	   *proc;
+	ProcNumber	procNumber;
+	EECaptureRequest *request;
+
+	if (n <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of plannings must be positive")));
+
+	if (ee_shared == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("extended_explain must be loaded via \"shared_preload_libraries\"")));
+
+	proc = BackendPidGetProc(pid);
+
+	if (proc == NULL)
+	{
+		ereport(WARNING,
+				(errmsg("PID %d is not a PostgreSQL server process", pid)));
+		PG_RETURN_BOOL(false);
+	}
+
+	procNumber = GetNumberFromPGProc(proc);
+
+	if (procNumber >= MaxBackends)
+	{
+		ereport(WARNING,
+				(errmsg("PID %d is not a PostgreSQL backend process", pid)));
+		PG_RETURN_BOOL(false);
+	}
+
+	request = &ee_shared->requests[procNumber];
+
+	if (request->pid != pid)
+	{
+		/* Слот процесса еще не использовался или остался от другого процесса */
+		pg_atomic_write_u32(&request->nplannings, 0);
+		request->pid = pid;
+		pg_write_barrier();
+		pg_atomic_write_u32(&request->nplannings, (uint32) n);
+	}
+	else
+		pg_atomic_fetch_add_u32(&request->nplannings, (uint32) n);
+
+	PG_RETURN_BOOL(true);
+}
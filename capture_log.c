@@ -0,0 +1,707 @@
+/*-------------------------------------------------------------------------
+ *
+ * capture_log.c
+ *    Журнал сборов путей в файлах $PGDATA/ee
+ *
+ * При ee.sink = mmap_log собранные пути записываются не в таблицы
+ * расширения, а в журнал: каждый сбор -- одна двоичная запись с длиной в
+ * заголовке, дописываемая в конец текущего сегмента. Запись не проходит
+ * через разделяемые буферы, кучу и WAL и поэтому возможна в транзакции
+ * только для чтения и на реплике. Сегменты не синхронизируются с диском:
+ * при сбое ОС последние записи могут быть потеряны.
+ *
+ * Каждый обслуживающий процесс пишет в собственный сегмент, поэтому запись
+ * не требует блокировок. Имя сегмента -- время его создания (в
+ * шестнадцатеричном виде) и pid процесса, так что порядок имен совпадает с
+ * порядком создания. Сегмент закрывается по достижении
+ * ee.log_segment_size, после чего самые старые сегменты удаляются, пока
+ * общий размер журнала превышает ee.log_max_size.
+ *
+ * Сегмент читается функцией ee.read_log(segment), которая отображает файл
+ * в память (mmap) и разбирает записи на месте. Формат записей зависит от
+ * сборки сервера (NodeTag, выравнивание, порядок байт) и от версии формата
+ * (EE_LOG_VERSION): записи другой версии не читаются.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/capture_log.h"
+#include "include/output_result.h"
+#include "include/path_nodes.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "catalog/pg_authid.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/pg_crc32c.h"
+#include "storage/fd.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+#include "utils/wait_event.h"
+
+/* Каталог журнала относительно $PGDATA */
+#define EE_LOG_DIR "ee"
+
+/* Признак начала записи */
+#define EE_LOG_MAGIC 0x45454C31
+
+/* Версия формата записи, увеличивается при любом изменении формата */
+#define EE_LOG_VERSION 2
+
+/* Флаги пути в записи журнала */
+#define EE_LOG_PARTIAL			0x01
+#define EE_LOG_IN_FINAL_PLAN	0x02
+#define EE_LOG_CHEAPEST_TOTAL	0x04
+
+#define NUM_OF_COLS_READ_LOG 19
+
+/*
+ * Заголовок записи журнала. За ним следуют массив EELogPath (npaths),
+ * идентификаторы дочерних путей (int64, nchildren) и текст запроса с
+ * завершающим нулем. Каждая часть начинается с адреса, выровненного на
+ * MAXALIGN, длина записи также кратна MAXALIGN.
+ */
+typedef struct EELogRecord
+{
+	uint32		magic;
+	uint32		version;		/* EE_LOG_VERSION */
+	uint32		len;			/* длина записи вместе с заголовком */
+	pg_crc32c	crc;			/* CRC-32C записи, начиная с npaths */
+	int32		npaths;
+	TimestampTz captured_at;
+	int64		queryid;
+	int32		nchildren;
+	int32		query_len;		/* длина текста запроса без нуля */
+} EELogRecord;
+
+/*
+ * Путь в записи журнала
+ */
+typedef struct EELogPath
+{
+	int64		subquery_id;
+	int64		rel_id;
+	int64		path_id;
+	int64		displaced_by;	/* 0 -- путь не вытеснен */
+	double		startup_cost;
+	double		total_cost;
+	double		rows;
+	int32		level;
+	int32		disabled_nodes;
+
+	/* Дочерние пути: children[first_child .. first_child + nchildren) */
+	int32		first_child;
+	int32		nchildren;
+
+	int16		pathtype;
+	uint8		add_path_result;
+	uint8		flags;
+} EELogPath;
+
+#define EE_LOG_PATHS_OFFSET	MAXALIGN(sizeof(EELogRecord))
+#define EE_LOG_CRC_OFFSET	offsetof(EELogRecord, npaths)
+
+static const struct config_enum_entry sink_options[] = {
+	{"tables", EE_SINK_TABLES, false},
+	{"mmap_log", EE_SINK_MMAP_LOG, false},
+	{"packed", EE_SINK_PACKED, false},
+	{NULL, 0, false}
+};
+
+int			ee_sink = EE_SINK_TABLES;
+
+/* Размер сегмента и максимальный размер журнала в мегабайтах */
+static int	ee_log_segment_size = 16;
+static int	ee_log_max_size = 1024;
+
+/* Текущий сегмент процесса */
+static File log_file = -1;
+static char log_segment[MAXPGPATH];
+static off_t log_offset = 0;
+
+/*
+ * Определение GUC переменных журнала. Вызывается из _PG_init.
+ */
+void
+ee_capture_log_init(void)
+{
+	DefineCustomEnumVariable(
+		"ee.sink",
+		"Where captured paths are stored: extension tables, capture log or packed ee.query column.",
+		NULL,
+		&ee_sink,
+		EE_SINK_TABLES,
+		sink_options,
+		PGC_SUSET,
+		0,
+		NULL,
+		NULL,
+		NULL);
+
+	DefineCustomIntVariable(
+		"ee.log_segment_size",
+		"Size of a capture log segment.",
+		NULL,
+		&ee_log_segment_size,
+		16,
+		1,
+		1024,
+		PGC_SUSET,
+		GUC_UNIT_MB,
+		NULL,
+		NULL,
+		NULL);
+
+	DefineCustomIntVariable(
+		"ee.log_max_size",
+		"Total size of capture log segments kept in $PGDATA/ee.",
+		NULL,
+		&ee_log_max_size,
+		1024,
+		1,
+		INT_MAX / 2,
+		PGC_SUSET,
+		GUC_UNIT_MB,
+		NULL,
+		NULL,
+		NULL);
+}
+
+/*
+ * Имя сегмента состоит из шестнадцатеричных цифр и символа '_'. Проверка
+ * также исключает выход за пределы каталога журнала.
+ */
+static bool
+is_log_segment_name(const char *name)
+{
+	return name[0] != '\0' &&
+		strspn(name, "0123456789ABCDEF_") == strlen(name);
+}
+
+static int
+segment_name_cmp(const ListCell *a, const ListCell *b)
+{
+	return strcmp((const char *) lfirst(a), (const char *) lfirst(b));
+}
+
+/*
+ * Удаление самых старых сегментов, пока общий размер журнала превышает
+ * ee.log_max_size. Текущий сегмент процесса не удаляется. Сегмент, в который
+ * еще пишет другой процесс, может быть удален: его записи будут потеряны.
+ */
+static void
+remove_old_segments(void)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	List	   *segments = NIL;
+	int64		total_size = 0;
+	int64		max_size = (int64) ee_log_max_size * 1024 * 1024;
+	ListCell   *lc;
+
+	dir = AllocateDir(EE_LOG_DIR);
+
+	while ((de = ReadDir(dir, EE_LOG_DIR)) != NULL)
+	{
+		char		path[MAXPGPATH];
+		struct stat st;
+
+		if (!is_log_segment_name(de->d_name))
+			continue;
+
+		snprintf(path, MAXPGPATH, "%s/%s", EE_LOG_DIR, de->d_name);
+		if (stat(path, &st) < 0)
+			continue;
+
+		total_size += st.st_size;
+		segments = lappend(segments, pstrdup(de->d_name));
+	}
+
+	FreeDir(dir);
+
+	list_sort(segments, segment_name_cmp);
+
+	foreach(lc, segments)
+	{
+		char	   *name = (char *) lfirst(lc);
+		char		path[MAXPGPATH];
+		struct stat st;
+
+		if (total_size <= max_size)
+			break;
+
+		if (strcmp(name, log_segment) == 0)
+			continue;
+
+		snprintf(path, MAXPGPATH, "%s/%s", EE_LOG_DIR, name);
+		if (stat(path, &st) < 0)
+			continue;
+
+		if (unlink(path) < 0)
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("could not remove file \"%s\": %m", path)));
+		else
+			total_size -= st.st_size;
+	}
+
+	list_free_deep(segments);
+}
+
+/*
+ * Открытие нового сегмента
+ */
+static void
+open_log_segment(void)
+{
+	char		path[MAXPGPATH];
+
+	if (log_file >= 0)
+		FileClose(log_file);
+	log_file = -1;
+
+	if (MakePGDirectory(EE_LOG_DIR) < 0 && errno != EEXIST)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m", EE_LOG_DIR)));
+
+	snprintf(log_segment, MAXPGPATH, "%016llX_%d",
+			 (unsigned long long) GetCurrentTimestamp(), MyProcPid);
+	snprintf(path, MAXPGPATH, "%s/%s", EE_LOG_DIR, log_segment);
+
+	log_file = PathNameOpenFile(path, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY);
+	if (log_file < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", path)));
+
+	log_offset = 0;
+
+	remove_old_segments();
+}
+
+/*
+ * Запись собранных путей в журнал
+ */
+void
+ee_log_write_capture(const char *query_string, EEState *ee_state)
+{
+	bool		hide_disabled = ee_state->options.hide_disabled;
+	int32		npaths = 0;
+	int32		nchildren = 0;
+	Size		query_len;
+	Size		children_offset;
+	Size		query_offset;
+	Size		len;
+	char	   *buf;
+	EELogRecord *record;
+	EELogPath  *logpath;
+	int64	   *children;
+	ListCell   *eesq_lc;
+	ListCell   *eer_lc;
+	ListCell   *eep_lc;
+
+	if (query_string == NULL)
+		query_string = "";
+	query_len = strlen(query_string);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+
+		foreach(eer_lc, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(eer_lc);
+
+			foreach(eep_lc, eerel->eepath_list)
+			{
+				EEPath	   *eepath = (EEPath *) lfirst(eep_lc);
+
+				if (eepath->disabled_nodes != 0 && hide_disabled)
+					continue;
+
+				npaths++;
+				nchildren += eepath->nsub;
+			}
+		}
+	}
+
+	children_offset = EE_LOG_PATHS_OFFSET + MAXALIGN(npaths * sizeof(EELogPath));
+	query_offset = children_offset + nchildren * sizeof(int64);
+	len = MAXALIGN(query_offset + query_len + 1);
+
+	buf = palloc0(len);
+
+	record = (EELogRecord *) buf;
+	record->magic = EE_LOG_MAGIC;
+	record->version = EE_LOG_VERSION;
+	record->len = len;
+	record->npaths = npaths;
+	record->captured_at = GetCurrentTimestamp();
+	record->queryid = ee_state->queryid;
+	record->nchildren = nchildren;
+	record->query_len = query_len;
+
+	logpath = (EELogPath *) (buf + EE_LOG_PATHS_OFFSET);
+	children = (int64 *) (buf + children_offset);
+	nchildren = 0;
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+
+		foreach(eer_lc, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(eer_lc);
+
+			foreach(eep_lc, eerel->eepath_list)
+			{
+				EEPath	   *eepath = (EEPath *) lfirst(eep_lc);
+				int			i;
+
+				if (eepath->disabled_nodes != 0 && hide_disabled)
+					continue;
+
+				logpath->subquery_id = eesubquery->id;
+				logpath->rel_id = eerel->id;
+				logpath->path_id = eepath->id;
+				logpath->displaced_by =
+					eepath->add_path_result == APR_DISPLACED ? eepath->displaced_by : 0;
+				logpath->startup_cost = eepath->startup_cost;
+				logpath->total_cost = eepath->total_cost;
+				logpath->rows = eepath->rows;
+				logpath->level = eerel->joined_rel_num;
+				logpath->disabled_nodes = eepath->disabled_nodes;
+				logpath->first_child = nchildren;
+				logpath->nchildren = eepath->nsub;
+				logpath->pathtype = (int16) eepath->pathtype;
+				logpath->add_path_result = (uint8) eepath->add_path_result;
+
+				if (eepath->partial)
+					logpath->flags |= EE_LOG_PARTIAL;
+				if (eepath->in_final_plan)
+					logpath->flags |= EE_LOG_IN_FINAL_PLAN;
+				if (eepath->cheapest_total)
+					logpath->flags |= EE_LOG_CHEAPEST_TOTAL;
+
+				for (i = 0; i < eepath->nsub; i++)
+					children[nchildren++] = eepath->sub_eepaths[i]->id;
+
+				logpath++;
+			}
+		}
+	}
+
+	memcpy(buf + query_offset, query_string, query_len);
+
+	INIT_CRC32C(record->crc);
+	COMP_CRC32C(record->crc, buf + EE_LOG_CRC_OFFSET,
+				len - EE_LOG_CRC_OFFSET);
+	FIN_CRC32C(record->crc);
+
+	/* Сегмент заполнен: запись переносится в новый сегмент */
+	if (log_file < 0 ||
+		(log_offset > 0 &&
+		 log_offset + len > (off_t) ee_log_segment_size * 1024 * 1024))
+		open_log_segment();
+
+	if (FileWrite(log_file, buf, len, log_offset, PG_WAIT_EXTENSION) != (ssize_t) len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s/%s\": %m",
+						EE_LOG_DIR, log_segment)));
+
+	log_offset += len;
+
+	pfree(buf);
+}
+
+/*
+ * Ошибка разбора записи журнала, контрольная сумма которой верна
+ */
+static void
+invalid_log_record(const char *segment, int64 record_offset,
+				   const char *detail)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("invalid record at offset " INT64_FORMAT " of capture log segment \"%s\"",
+					record_offset, segment),
+			 errdetail_internal("%s", detail)));
+}
+
+/*
+ * Вывод путей одной записи журнала.
+ *
+ * Перед разбором проверяется, что массивы путей и дочерних путей и текст
+ * запроса помещаются в запись, а дочерние пути каждого пути -- в массив
+ * дочерних путей.
+ */
+static void
+read_log_record(ReturnSetInfo *rsinfo, const EELogRecord *record,
+				int64 record_offset, const char *segment)
+{
+	const char *buf = (const char *) record;
+	const EELogPath *logpath = (const EELogPath *) (buf + EE_LOG_PATHS_OFFSET);
+	uint64		children_offset;
+	const int64 *children;
+	Datum		query;
+	Datum		values[NUM_OF_COLS_READ_LOG];
+	bool		nulls[NUM_OF_COLS_READ_LOG];
+	int			i;
+
+	if (record->npaths < 0 || record->nchildren < 0 || record->query_len < 0)
+		invalid_log_record(segment, record_offset, "negative array length");
+
+	children_offset = EE_LOG_PATHS_OFFSET +
+		MAXALIGN((uint64) record->npaths * sizeof(EELogPath));
+
+	if (children_offset + (uint64) record->nchildren * sizeof(int64) +
+		(uint64) record->query_len > record->len)
+		invalid_log_record(segment, record_offset,
+						   "paths, children and query text exceed the record length");
+
+	children = (const int64 *) (buf + children_offset);
+
+	query = PointerGetDatum(cstring_to_text_with_len(buf + children_offset +
+													 record->nchildren * sizeof(int64),
+													 record->query_len));
+
+	for (i = 0; i < record->npaths; i++, logpath++)
+	{
+		if (logpath->first_child < 0 || logpath->nchildren < 0 ||
+			(int64) logpath->first_child + logpath->nchildren > record->nchildren)
+			invalid_log_record(segment, record_offset,
+							   psprintf("children of path " INT64_FORMAT " are out of bounds",
+										logpath->path_id));
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[0] = Int64GetDatum(record_offset);
+		values[1] = TimestampTzGetDatum(record->captured_at);
+		values[2] = Int64GetDatum(record->queryid);
+		nulls[2] = (record->queryid == 0);
+		values[3] = query;
+		values[4] = Int64GetDatum(logpath->subquery_id);
+		values[5] = Int64GetDatum(logpath->rel_id);
+		values[6] = Int64GetDatum(logpath->path_id);
+		values[7] = CStringGetTextDatum(plan_type_name((NodeTag) logpath->pathtype));
+
+		if (logpath->nchildren == 0)
+			nulls[8] = true;
+		else
+		{
+			Datum	   *sub_ids;
+			int			j;
+
+			sub_ids = (Datum *) palloc(sizeof(Datum) * logpath->nchildren);
+			for (j = 0; j < logpath->nchildren; j++)
+				sub_ids[j] = Int64GetDatum(children[logpath->first_child + j]);
+
+			values[8] = PointerGetDatum(construct_array(sub_ids, logpath->nchildren,
+														INT8OID, sizeof(int64),
+														FLOAT8PASSBYVAL,
+														TYPALIGN_DOUBLE));
+			pfree(sub_ids);
+		}
+
+		values[9] = Int32GetDatum(logpath->level);
+		values[10] = Float8GetDatum(logpath->startup_cost);
+		values[11] = Float8GetDatum(logpath->total_cost);
+		values[12] = Float8GetDatum(logpath->rows);
+		values[13] = CStringGetTextDatum(add_path_result_to_string((AddPathResult) logpath->add_path_result));
+		values[14] = Int64GetDatum(logpath->displaced_by);
+		nulls[14] = (logpath->displaced_by == 0);
+		values[15] = Int32GetDatum(logpath->disabled_nodes);
+		values[16] = BoolGetDatum((logpath->flags & EE_LOG_PARTIAL) != 0);
+		values[17] = BoolGetDatum((logpath->flags & EE_LOG_IN_FINAL_PLAN) != 0);
+		values[18] = BoolGetDatum((logpath->flags & EE_LOG_CHEAPEST_TOTAL) != 0);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+}
+
+/*
+ * Разбор записей отображенного в память сегмента. Чтение прекращается на
+ * записи, которая еще дописывается (выходит за конец файла), и на
+ * поврежденной записи.
+ */
+static void
+read_log_segment(ReturnSetInfo *rsinfo, const char *map, Size size,
+				 const char *segment)
+{
+	Size		offset = 0;
+
+	while (offset + sizeof(EELogRecord) <= size)
+	{
+		const EELogRecord *record = (const EELogRecord *) (map + offset);
+		pg_crc32c	crc;
+
+		/* Сегменты другой версии формата не разбираются */
+		if (record->magic == EE_LOG_MAGIC && record->version != EE_LOG_VERSION)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("capture log segment \"%s\" has format version %u, expected %u",
+							segment, record->version, EE_LOG_VERSION),
+					 errhint("Remove the segment with ee.remove_log().")));
+
+		if (record->magic != EE_LOG_MAGIC ||
+			record->len < EE_LOG_PATHS_OFFSET ||
+			record->len % MAXIMUM_ALIGNOF != 0)
+		{
+			ereport(WARNING,
+					(errmsg("invalid record at offset %zu of capture log segment \"%s\"",
+							offset, segment)));
+			break;
+		}
+
+		if (offset + record->len > size)
+			break;
+
+		INIT_CRC32C(crc);
+		COMP_CRC32C(crc, map + offset + EE_LOG_CRC_OFFSET,
+					record->len - EE_LOG_CRC_OFFSET);
+		FIN_CRC32C(crc);
+
+		if (!EQ_CRC32C(crc, record->crc))
+		{
+			ereport(WARNING,
+					(errmsg("incorrect checksum of record at offset %zu of capture log segment \"%s\"",
+							offset, segment)));
+			break;
+		}
+
+		read_log_record(rsinfo, record, offset, segment);
+
+		offset += record->len;
+	}
+}
+
+/*
+ * ee.read_log(segment) -- пути, записанные в сегмент журнала сборов
+ */
+PG_FUNCTION_INFO_V1(ee_read_log);
+
+Datum
+ee_read_log(PG_FUNCTION_ARGS)
+{
+	char	   *segment = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	char		path[MAXPGPATH];
+	struct stat st;
+	char	   *volatile map = NULL;
+	Size		size;
+	int			fd;
+
+	/* Чтение файлов на сервере разрешено тем же ролям, что и COPY FROM */
+	if (!has_privs_of_role(GetUserId(), ROLE_PG_READ_SERVER_FILES))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("permission denied to read capture log"),
+				 errdetail("Only roles with privileges of the \"%s\" role may read files on the server.",
+						   "pg_read_server_files")));
+
+	if (!is_log_segment_name(segment))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid capture log segment name \"%s\"", segment)));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	snprintf(path, MAXPGPATH, "%s/%s", EE_LOG_DIR, segment);
+
+	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", path)));
+
+	if (fstat(fd, &st) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not stat file \"%s\": %m", path)));
+
+	size = st.st_size;
+
+	if (size > 0)
+	{
+		map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not map file \"%s\": %m", path)));
+	}
+
+	/* Отображение остается действительным после закрытия файла */
+	CloseTransientFile(fd);
+
+	if (map == NULL)
+		return (Datum) 0;
+
+	PG_TRY();
+	{
+		read_log_segment(rsinfo, map, size, segment);
+	}
+	PG_FINALLY();
+	{
+		munmap(map, size);
+	}
+	PG_END_TRY();
+
+	return (Datum) 0;
+}
+
+/*
+ * ee.remove_log(segment) -- удаление сегмента журнала сборов. Если это
+ * текущий сегмент процесса, он закрывается, и следующий сбор откроет новый.
+ * Возвращает false, если сегмента нет.
+ */
+PG_FUNCTION_INFO_V1(ee_remove_log);
+
+Datum
+ee_remove_log(PG_FUNCTION_ARGS)
+{
+	char	   *segment = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char		path[MAXPGPATH];
+
+	/* Удаление файлов на сервере разрешено тем же ролям, что и их запись */
+	if (!has_privs_of_role(GetUserId(), ROLE_PG_WRITE_SERVER_FILES))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("permission denied to remove capture log"),
+				 errdetail("Only roles with privileges of the \"%s\" role may write files on the server.",
+						   "pg_write_server_files")));
+
+	if (!is_log_segment_name(segment))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid capture log segment name \"%s\"", segment)));
+
+	if (log_file >= 0 && strcmp(segment, log_segment) == 0)
+	{
+		FileClose(log_file);
+		log_file = -1;
+		log_segment[0] = '\0';
+	}
+
+	snprintf(path, MAXPGPATH, "%s/%s", EE_LOG_DIR, segment);
+
+	if (unlink(path) < 0)
+	{
+		if (errno == ENOENT)
+			PG_RETURN_BOOL(false);
+
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", path)));
+	}
+
+	PG_RETURN_BOOL(true);
+}
@@ -21,7 +21,81 @@ CREATE TABLE ee.query
 	execution_ts timestamp,
 
 	/* Текст EXPLAIN запроса */
-	query_text TEXT
+	query_text TEXT,
+
+	/* 
+	 * Идентификатор запроса в терминах pg_stat_statements (queryid).
+	 * NULL, если идентификатор не вычислялся (compute_query_id = off).
+	 */
+	queryid bigint,
+
+	/*
+	 * Статистика plancache для EXPLAIN EXECUTE (для остальных запросов NULL):
+	 * стоимость generic плана и средняя стоимость custom планов в том виде,
+	 * в котором их сравнивает plancache, количество построенных custom планов
+	 * и вид плана (generic/custom), выбранный plancache при исполнении команды.
+	 */
+	plancache_generic_cost double precision,
+	plancache_avg_custom_cost double precision,
+	plancache_custom_plans bigint,
+	plancache_choice text,
+
+	/*
+	 * Состояние сбора путей: completed, planning aborted (планирование
+	 * прервано ошибкой, например отменой запроса или statement_timeout) или
+	 * execution aborted (ошибка произошла после планирования). Пути
+	 * прерванных запросов записываются только с параметром save_aborted.
+	 */
+	status text,
+
+	/* Текст ошибки, прервавшей сбор путей */
+	error_message text,
+
+	/*
+	 * Наибольший объем памяти, выделенной планировщиком с начала сбора путей,
+	 * байт. Память расширения не учитывается.
+	 */
+	planner_mem_bytes bigint,
+
+	/*
+	 * Память планировщика по окончании планирования каждого
+	 * запроса/подзапроса (i-й элемент соответствует subquery_id = i), байт
+	 */
+	subquery_planner_mem_bytes bigint[],
+
+	/* Память, занятая собранными путями, байт */
+	capture_mem_bytes bigint,
+
+	/*
+	 * Сводка по сбору путей. Количество собранных путей, в том числе по
+	 * результату add_path (включая пути, не записанные в ee.paths из-за
+	 * hide_disabled), путей, отброшенных add_path_precheck, отношений,
+	 * подзапросов и наибольший уровень соединения.
+	 */
+	paths bigint,
+	paths_saved bigint,
+	paths_displaced bigint,
+	paths_removed bigint,
+	paths_prechecked bigint,
+	rels int,
+	subqueries int,
+	max_level int,
+
+	/*
+	 * Оверхед расширения и время планирования без него, мс. Время
+	 * планирования известно только при выводе плана командой EXPLAIN.
+	 */
+	overhead_ms double precision,
+	planning_ms double precision,
+
+	/* Стоимость итогового плана запроса */
+	final_plan_cost double precision,
+
+	/*
+	 * Пути, упакованные при ee.sink = packed (см. ee.unpack_paths). Данные
+	 * уже сжаты, поэтому TOAST их повторно не сжимает.
+	 */
+	packed_paths bytea STORAGE EXTERNAL
 );
 
 /*
@@ -110,16 +184,556 @@ CREATE TABLE ee.paths
 	 */
 	disabled_nodes integer,
 
+	/*
+	 * Вид плана, при построении которого рассматривался путь: generic или
+	 * custom. Заполняется только для EXPLAIN EXECUTE, в остальных случаях NULL.
+	 */
+	plan_kind text,
+
+	/*
+	 * Частичный путь (partial_pathlist): результат add_path_result получен
+	 * функцией add_partial_path. Дочерние пути Gather/GatherMerge также
+	 * являются частичными.
+	 */
+	partial bool,
+
+	/* Параметры параллельного исполнения пути */
+	parallel_aware bool,
+	parallel_workers int,
+
+	/*
+	 * Путь выбран функцией set_cheapest наиболее дешевым в своем отношении:
+	 * по полной стоимости, по стартовой стоимости или среди
+	 * параметризованных путей.
+	 */
+	cheapest_total bool,
+	cheapest_startup bool,
+	cheapest_parameterized bool,
+
+	/*
+	 * Путь вошел в итоговый план (запроса или SubPlan) и его глубина в дереве
+	 * плана (0 -- корень плана). Для остальных путей plan_depth -- NULL.
+	 */
+	in_final_plan bool,
+	plan_depth int,
+
+	/*
+	 * Pathkeys пути: строка двумерного массива описывает один pathkey --
+	 * номер класса эквивалентности (в пределах EXPLAIN запроса), oid
+	 * семейства операторов сортировки, направление (1 -- ASC, -1 -- DESC) и
+	 * признак NULLS FIRST (1/0). NULL, если путь не упорядочен.
+	 */
+	pathkeys int[],
+
+	/*
+	 * Индексы отношений (RangeTblEntry), от которых зависит параметризованный
+	 * путь. NULL для непараметризованных путей.
+	 */
+	required_outer smallint[],
+
+	/*
+	 * Для путей агрегации -- стратегия (plain, sorted, hashed, mixed) и
+	 * оценка количества групп
+	 */
+	agg_strategy text,
+	num_groups double precision,
+
+	/*
+	 * Структурный отпечаток пути: хеш типа пути, множества отношений,
+	 * индекса и тех же характеристик дочерних путей. Используется для
+	 * фиксации пути в ee.fixate_paths.
+	 */
+	fingerprint bigint,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/* Поиск путей итогового плана */
+CREATE INDEX paths_final_plan_idx ON ee.paths (query_id, plan_depth)
+	WHERE in_final_plan;
+
+/*
+ * В таблицу ee.rels записывается профиль вызовов функции add_path для каждого
+ * отношения, рассмотренного планировщиком. Позволяет определить, на каких
+ * отношениях (уровнях соединения, базовых отношениях с большим количеством
+ * индексов или pathkeys) планировщик тратит больше всего времени.
+ */
+CREATE TABLE ee.rels
+(
+	/* Однозначный идентификатор EXPLAIN запроса */
+	query_id bigint,
+
+	/* Идентификатор запроса/подзапроса */
+	subquery_id bigint,
+
+	/* Идентификатор отношения (ee.paths.rel_id) */
+	rel_id bigint,
+
+	/* Имя и алиас отношения */
+	rel_name text,
+	rel_alias text,
+
+	/* Количество соединяемых базовых отношений (ee.paths.level) */
+	level int,
+
+	/* Количество вызовов add_path */
+	add_path_calls bigint,
+
+	/* Наибольшая длина pathlist после вызова add_path */
+	max_pathlist_len int,
+
+	/*
+	 * Моменты первого и последнего вызова add_path в миллисекундах от
+	 * начала планирования
+	 */
+	first_add_path_ms double precision,
+	last_add_path_ms double precision,
+
+	/* Суммарное время работы расширения в add_path, мс */
+	add_path_time_ms double precision,
+
+	/* Память планировщика на момент создания отношения, байт */
+	planner_mem_bytes bigint,
+
+	/*
+	 * Количество вызовов add_path_precheck/add_partial_path_precheck и
+	 * количество путей, отброшенных ими (ee.prechecked_paths)
+	 */
+	precheck_calls bigint,
+	prechecked_out int,
+
+	/* Индексы базовых отношений (RangeTblEntry), входящих в отношение */
+	relids smallint[],
+
+	/* Имена базовых отношений в том виде, в котором их выводит EXPLAIN */
+	rel_aliases text[],
+
+	/*
+	 * Стадия верхнего отношения (group_agg, window, distinct, ordered, final
+	 * и т.д.), NULL для отношений сканирования и соединения
+	 */
+	upper_stage text,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/*
+ * В таблицу ee.join_levels записывается статистика перебора соединений
+ * (standard_join_search) по уровням. Позволяет оценить, как параметры
+ * join_collapse_limit и from_collapse_limit влияют на размер пространства
+ * перебора и время планирования. При использовании GEQO не заполняется.
+ */
+CREATE TABLE ee.join_levels
+(
+	query_id bigint,
+	subquery_id bigint,
+
+	/* Количество соединяемых базовых отношений */
+	level int,
+
+	/* Количество отношений соединения, построенных на уровне */
+	joinrels int,
+
+	/* Количество рассмотренных пар соединяемых отношений */
+	join_pairs int,
+
+	/* Из них пар без условий соединения (декартово произведение) */
+	cartesian_pairs int,
+
+	/* Время построения уровня без оверхеда расширения, мс */
+	time_ms double precision,
+
+	/* Память планировщика после построения уровня, байт */
+	planner_mem_bytes bigint,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/*
+ * В таблицу ee.join_pairs записываются пары отношений, соединение которых
+ * рассматривалось при построении отношения соединения. Пара записывается,
+ * если хотя бы один путь их соединения был проверен add_path_precheck.
+ */
+CREATE TABLE ee.join_pairs
+(
+	query_id bigint,
+	subquery_id bigint,
+	level int,
+
+	/* Отношение соединения (ee.paths.rel_id) */
+	joinrel_id bigint,
+
+	/* Соединяемые отношения (rel1_id < rel2_id) */
+	rel1_id bigint,
+	rel2_id bigint,
+
+	/* Между отношениями нет условий соединения */
+	cartesian boolean,
+
+	/*
+	 * Все пути соединения пары отброшены add_path_precheck, то есть
+	 * отношение соединения построено только из других пар
+	 */
+	pruned boolean,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/*
+ * В таблицу ee.partition_groups в режиме collapse_partitions записываются
+ * группы дочерних отношений (секций) секционированных отношений и их
+ * соединений. Пути записываются только для одного представителя группы,
+ * остальные секции учитываются количеством и распределением стоимостей.
+ */
+CREATE TABLE ee.partition_groups
+(
+	query_id bigint,
+	subquery_id bigint,
+
+	/* Секционированное отношение (ee.paths.rel_id) */
+	parent_rel_id bigint,
+
+	/* Секция-представитель, пути которой записаны в ee.paths */
+	representative_rel_id bigint,
+
+	level int,
+
+	/* Количество секций, для которых рассматривались пути */
+	partitions int,
+
+	/* Количество секций, отсеченных при планировании */
+	pruned int,
+
+	/* Распределение наименьших стоимостей путей секций */
+	min_cost double precision,
+	median_cost double precision,
+	max_cost double precision,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/*
+ * В таблицу ee.prechecked_paths записываются пути соединения, отброшенные
+ * функциями add_path_precheck и add_partial_path_precheck по предварительной
+ * оценке стоимости. Такие пути не создаются и в add_path не попадают, поэтому
+ * в ee.paths их нет. Записываются отношение соединения, тип узла и тип
+ * соединения, внешнее и внутреннее отношения, оценки стоимости и путь,
+ * доминирующий над отброшенным. Дочерние пути не связываются.
+ */
+CREATE TABLE ee.prechecked_paths
+(
+	query_id bigint,
+	subquery_id bigint,
+	rel_id bigint,
+	level int,
+
+	/* Путь отброшен add_partial_path_precheck */
+	partial bool,
+
+	/* Для частичных путей стартовая стоимость не оценивается (NULL) */
+	startup_cost double precision,
+	total_cost double precision,
+	disabled_nodes int,
+
+	/* Количество pathkeys пути */
+	pathkeys int,
+
+	parameterized bool,
+
+	/* Доминирующий путь (ee.paths.path_id) */
+	dominated_by bigint,
+
+	/* Тип узла (NestLoop, MergeJoin, HashJoin) и тип соединения */
+	path_type text,
+	join_type text,
+
+	/* Внешнее и внутреннее отношения (ee.rels.rel_id) */
+	outer_rel_id bigint,
+	inner_rel_id bigint,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/*
+ * Таблицы ee.join_graph_rels, ee.join_clauses и ee.eclasses описывают граф
+ * соединений подзапроса: базовые отношения, условия соединения с оценками
+ * их селективности и классы эквивалентности. Условия, выведенные из классов
+ * эквивалентности (например, a = b), в ee.join_clauses не попадают, их
+ * следует искать в ee.eclasses.
+ */
+CREATE TABLE ee.join_graph_rels
+(
+	query_id bigint,
+	subquery_id bigint,
+
+	/* Индекс RangeTblEntry отношения */
+	rtindex smallint,
+
+	/* Отношение в ee.rels, NULL если пути отношения не записывались */
+	rel_id bigint,
+
+	name text,
+	alias text,
+
+	/* Оценка количества строк после применения условий и размер таблицы */
+	rows double precision,
+	tuples double precision,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+CREATE TABLE ee.join_clauses
+(
+	query_id bigint,
+	subquery_id bigint,
+	clause_id int,
+	clause text,
+
+	/* Отношения условия и его левой и правой частей (для операторов) */
+	relids smallint[],
+	left_relids smallint[],
+	right_relids smallint[],
+
+	/*
+	 * Селективность условия для внутреннего соединения и для внешнего
+	 * соединения, NULL если планировщик ее не оценивал
+	 */
+	selectivity double precision,
+	outer_selectivity double precision,
+
+	pushed_down bool,
+
+	/* Условие может использоваться в хеш-соединении и соединении слиянием */
+	hashable bool,
+	mergeable bool,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+CREATE TABLE ee.eclasses
+(
+	query_id bigint,
+	subquery_id bigint,
+
+	/*
+	 * Позиция класса в PlannerInfo.eq_classes подзапроса, совпадающая с
+	 * номером в ee.paths.pathkeys
+	 */
+	eclass_id int,
+
+	members text[],
+	relids smallint[],
+
+	/* Класс содержит константу */
+	has_const bool,
+
+	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
+);
+
+/*
+ * В таблицу ee.race_results записываются результаты исполнения наилучших
+ * планов запроса функцией ee.race.
+ */
+CREATE TABLE ee.race_results
+(
+	/* Идентификатор записи о запросе в ee.query */
+	query_id bigint,
+
+	/* Место плана в порядке возрастания стоимости */
+	rank integer,
+
+	/* Корневой путь плана (ee.paths.path_id) и его тип */
+	path_id bigint,
+	path_type text,
+
+	/* Стоимость плана по оценке планировщика */
+	estimated_cost float,
+
+	/*
+	 * Результаты EXPLAIN ANALYZE запроса с зафиксированным планом: стоимость
+	 * всего плана, время планирования и исполнения в миллисекундах и
+	 * количество строк. NULL, если исполнение было прервано по таймауту.
+	 */
+	planned_cost float,
+	planning_time float,
+	execution_time float,
+	actual_rows float,
+
+	/* Исполнение прервано по таймауту */
+	timed_out boolean,
+
+	/* Компактное текстовое представление плана */
+	plan text,
+
+	/*
+	 * Исполненный план имеет форму навязанного: те же типы соединений и
+	 * сканирований, те же таблицы и порядок внешних и внутренних отношений.
+	 * false -- fixate_paths не смог навязать план, результаты относятся к
+	 * другому плану. NULL при прерывании по таймауту.
+	 */
+	plan_matched boolean,
+
 	FOREIGN KEY (query_id) REFERENCES  ee.query(id)
 );
 
 /* 
- * Функция очистки таблиц ee.query и ee.paths
+ * Функция очистки таблиц расширения
  */
 CREATE FUNCTION ee.clear()
 RETURNS boolean AS $$
 BEGIN
-    TRUNCATE TABLE ee.query CASCADE;
+    TRUNCATE TABLE ee.query, ee.rels, ee.join_levels, ee.join_pairs,
+		ee.partition_groups, ee.prechecked_paths, ee.join_graph_rels,
+		ee.join_clauses, ee.eclasses, ee.race_results CASCADE;
 	RETURN true;
 END;
-$$ LANGUAGE plpgsql;
\ No newline at end of file
+$$ LANGUAGE plpgsql;
+
+/*
+ * Функция сбора путей generic планов для n самых тяжелых (по суммарному 
+ * времени исполнения) запросов из pg_stat_statements. Запросы не исполняются.
+ *
+ * Возвращает queryid запроса и идентификатор соответствующей записи в ee.query.
+ */
+CREATE FUNCTION ee.capture_top_statements(n integer DEFAULT 10)
+RETURNS TABLE (queryid bigint, query_id bigint)
+AS 'MODULE_PATHNAME', 'ee_capture_top_statements'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Функция ранжирования записанных путей EXPLAIN запроса query_id.
+ *
+ * Для каждого запроса/подзапроса рассматриваются итоговое отношение и
+ * отношение, соединяющее все базовые отношения подзапроса. Для каждого из
+ * них выводятся K самых дешевых записанных путей отношения (каждый вместе
+ * со всеми потомками),
+ * отношение их стоимости к стоимости выбранного плана (пути, вошедшего в
+ * итоговый план), размер и глубина
+ * дерева плана, компактное текстовое представление плана и отличия от
+ * выбранного плана: узлы вида "+HashJoin[rel 3](t1, t2)" есть только в данном
+ * плане, узлы вида "-MergeJoin[rel 3](t1, t2)" -- только в выбранном.
+ *
+ * Это не K наилучших планов запроса: комбинации путей дочерних отношений,
+ * не построенные планировщиком, не перебираются, а пути, вытесненные из
+ * pathlist, ранжируются наравне с сохраненными. Планом считается только
+ * записанный путь отношения с теми дочерними путями, с которыми он был
+ * создан.
+ */
+CREATE FUNCTION ee.top_plans(query_id bigint, k integer DEFAULT 10)
+RETURNS TABLE (subquery_id bigint, rel_id bigint, rank integer, path_id bigint,
+			   path_type text, startup_cost float, total_cost float,
+			   cost_ratio float, chosen boolean, plan_nodes integer,
+			   plan_depth integer, plan text, differences text[])
+AS 'MODULE_PATHNAME', 'ee_top_plans'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * Функция выгрузки графа путей EXPLAIN запроса query_id в формате
+ * Graphviz DOT (format = 'dot') или GraphML (format = 'graphml'). Документ
+ * возвращается построчно. Вершины -- пути, ребра -- связи с дочерними
+ * путями и с путями, вытеснившими их (displaced_by); в DOT вершины
+ * сгруппированы в кластеры по уровню соединения. filter ограничивает граф:
+ * all -- все пути, final -- пути итогового плана, near_final -- пути
+ * итогового плана и все пути их отношений.
+ */
+CREATE FUNCTION ee.export_graph(query_id bigint, format text DEFAULT 'dot',
+								filter text DEFAULT 'all')
+RETURNS SETOF text
+AS 'MODULE_PATHNAME', 'ee_export_graph'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * Функция выгрузки путей EXPLAIN запросов query_ids из ee.paths в файл path
+ * на сервере в потоковом формате Apache Arrow IPC. Названия путей и
+ * отношений, результаты add_path и сравнения путей кодируются словарями.
+ * Возвращает количество выгруженных путей. Требует прав роли
+ * pg_write_server_files.
+ */
+CREATE FUNCTION ee.export_arrow(query_ids bigint[], path text)
+RETURNS bigint
+AS 'MODULE_PATHNAME', 'ee_export_arrow'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Тот же поток Arrow IPC в виде значения bytea, без записи файла
+ */
+CREATE FUNCTION ee.export_arrow(query_ids bigint[])
+RETURNS bytea
+AS 'MODULE_PATHNAME', 'ee_export_arrow_bytea'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * Функция чтения сегмента журнала сборов ($PGDATA/ee/segment), в который
+ * пути записываются при ee.sink = mmap_log. Возвращает по строке на путь;
+ * record_offset -- смещение записи сбора в сегменте. Требует прав роли
+ * pg_read_server_files.
+ */
+CREATE FUNCTION ee.read_log(segment text)
+RETURNS TABLE (record_offset bigint, captured_at timestamptz, queryid bigint,
+			   query text, subquery_id bigint, rel_id bigint, path_id bigint,
+			   path_type text, child_paths bigint[], level integer,
+			   startup_cost float, total_cost float, rows float,
+			   add_path_result text, displaced_by bigint,
+			   disabled_nodes integer, partial boolean,
+			   in_final_plan boolean, cheapest_total boolean)
+AS 'MODULE_PATHNAME', 'ee_read_log'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Функция удаления сегмента журнала сборов. Возвращает false, если сегмента
+ * нет. Требует прав роли pg_write_server_files.
+ */
+CREATE FUNCTION ee.remove_log(segment text)
+RETURNS boolean
+AS 'MODULE_PATHNAME', 'ee_remove_log'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Функция распаковки путей EXPLAIN запроса query_id, сохраненных при
+ * ee.sink = packed в колонку ee.query.packed_paths. Возвращает строки в
+ * формате ee.paths; для запросов, пути которых записаны в ee.paths, не
+ * возвращает ничего.
+ */
+CREATE FUNCTION ee.unpack_paths(query_id bigint)
+RETURNS SETOF ee.paths
+AS 'MODULE_PATHNAME', 'ee_unpack_paths'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * Функция исполнения K самых дешевых записанных планов запроса.
+ *
+ * Собирает пути запроса query (как ee.capture_top_statements, запись
+ * появляется в ee.query), выбирает K самых дешевых планов отношения,
+ * соединяющего все базовые отношения запроса (см. ee.top_plans), и по
+ * очереди исполняет запрос с каждым из них с помощью EXPLAIN ANALYZE,
+ * фиксируя план механизмом fixate_paths в пределах его подзапроса
+ * (ee.fixate_subquery). Каждый план исполняется в подтранзакции, которая
+ * затем откатывается. Исполнение плана дольше timeout миллисекунд
+ * прерывается (0 -- без ограничения). plan_matched показывает, был ли
+ * исполнен именно навязанный план.
+ *
+ * Результаты записываются в таблицу ee.race_results.
+ */
+CREATE FUNCTION ee.race(query text, k integer DEFAULT 3, timeout integer DEFAULT 0)
+RETURNS TABLE (query_id bigint, rank integer, path_id bigint, path_type text,
+			   estimated_cost float, planned_cost float, planning_time float,
+			   execution_time float, actual_rows float, timed_out boolean,
+			   plan text, plan_matched boolean)
+AS 'MODULE_PATHNAME', 'ee_race'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Функция сбора путей следующих n планирований обслуживающего процесса pid.
+ *
+ * Процесс собирает пути так же, как при EXPLAIN (get_paths), и сразу
+ * записывает их в журнал сборов (см. ee.read_log), вне своих транзакций.
+ * Требует загрузки расширения через shared_preload_libraries. Как и
+ * pg_log_backend_memory_contexts, по умолчанию доступна только
+ * суперпользователю.
+ */
+CREATE FUNCTION ee.capture_backend(pid integer, n integer DEFAULT 1)
+RETURNS boolean
+AS 'MODULE_PATHNAME', 'ee_capture_backend'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION ee.capture_backend(integer, integer) FROM PUBLIC;
@@ -11,6 +11,12 @@
 
 #include "include/extended_explain.h"
 #include "include/output_result.h"
+#include "include/backend_capture.h"
+#include "include/path_nodes.h"
+#include "include/path_keys.h"
+#include "include/join_graph.h"
+#include "include/plan_alternatives.h"
+#include "include/capture_log.h"
 #include "miscadmin.h"
 #include "utils/varlena.h"
 #include "commands/explain_format.h"
@@ -21,6 +27,23 @@
 #include "utils/guc.h"
 #include "commands/defrem.h"
 #include "utils/builtins.h"
+#include "access/xact.h"
+#include "commands/extension.h"
+#include "executor/spi.h"
+#include "funcapi.h"
+#include "parser/analyze.h"
+#include "tcop/tcopprot.h"
+#include "commands/prepare.h"
+#include "executor/executor.h"
+#include "nodes/nodeFuncs.h"
+#include "parser/parse_coerce.h"
+#include "parser/parse_collate.h"
+#include "parser/parse_expr.h"
+#include "utils/plancache.h"
+#include "access/xlog.h"
+#include "optimizer/geqo.h"
+#include "optimizer/joininfo.h"
+#include "optimizer/optimizer.h"
 
 #if (PG_VERSION_NUM >= 180000)
 #include "commands/explain_state.h"
@@ -38,6 +61,12 @@ static void ee_hide_disabled_handler(ExplainState *es, DefElem *opt,
 									 ParseState *pstate);
 static void ee_fixate_paths_handler(ExplainState *es, DefElem *opt,
 									ParseState *pstate);
+static void ee_save_aborted_handler(ExplainState *es, DefElem *opt,
+									ParseState *pstate);
+static void ee_collapse_partitions_handler(ExplainState *es, DefElem *opt,
+										   ParseState *pstate);
+static void ee_alternatives_handler(ExplainState *es, DefElem *opt,
+									ParseState *pstate);
 
 /*
  * Идентификатор расширения, необходим для реализации EXPLAIN-параметров.  
@@ -48,27 +77,77 @@ static int	ee_extension_id;
 static bool get_paths;
 static bool hide_disabled;
 static bool enable_fixate_paths;
+static bool save_aborted;
+static bool collapse_partitions;
 #endif
 
-/* Обертка для хранения пары (path_id, rel_id) */ 
-typedef struct RelPathIdPair 
+/*
+ * Путь, зафиксированный ee.fixate_paths: уровень и структурный отпечаток
+ * пути (get_path_fingerprint)
+ */
+typedef struct FixatedPathKey
+{
+	int64		level;
+	int64		fingerprint;
+} FixatedPathKey;
+
+typedef struct FixatedPathEntry
+{
+	FixatedPathKey key;
+
+	/*
+	 * Наименьшая и наибольшая полные стоимости (в сотых долях) путей с этим
+	 * отпечатком; используются при ee.fixate_cost_tolerance >= 0
+	 */
+	int64		min_total_cost;
+	int64		max_total_cost;
+} FixatedPathEntry;
+
+/*
+ * Тройка ee.fixate_paths в прежнем формате: уровень, стоимость запуска и
+ * полная стоимость пути в сотых долях
+ */
+typedef struct FixatedCostKey
 {
-    int64 level_id;
-	int64 startup_cost;
-	int64 total_cost;
-} RelPathIdPair;
+	int64		level;
+	int64		startup_cost;
+	int64		total_cost;
+} FixatedCostKey;
+
+static char *my_guc_string = NULL;
+
+/*
+ * Разобранное значение ee.fixate_paths: зафиксированные пути, те же тройки
+ * в прежнем формате и уровни, на которых пути зафиксированы. NULL, если
+ * пути не зафиксированы.
+ */
+static MemoryContext fixated_ctx = NULL;
+static HTAB *fixated_paths = NULL;
+static HTAB *fixated_costs = NULL;
+static HTAB *fixated_levels = NULL;
+
+static double fixate_cost_tolerance = -1.0;
 
-static char *my_guc_string = NULL;   
-static List *my_guc_list = NIL;      
+/* Подзапрос, в котором действует ee.fixate_paths (0 -- во всех) */
+static int	fixate_subquery = 0;
 
 /*
  * Хуки для перехвата путей
  */
 static ExplainOneQuery_hook_type prev_ExplainOneQuery_hook = NULL;
 static add_path_hook_type prev_add_path_hook = NULL;
+static add_partial_path_hook_type prev_add_partial_path_hook = NULL;
+static set_cheapest_hook_type prev_set_cheapest_hook = NULL;
+static join_path_precheck_hook_type prev_join_path_precheck_hook = NULL;
 static set_rel_pathlist_hook_type prev_set_rel_pathlist_hook = NULL;
 static create_upper_paths_hook_type prev_create_upper_paths_hook = NULL;
 static explain_per_plan_hook_type prev_explain_per_plan_hook = NULL;
+#if (PG_VERSION_NUM >= 180000)
+static explain_per_node_hook_type prev_explain_per_node_hook = NULL;
+#endif
+static ProcessUtility_hook_type prev_ProcessUtility_hook = NULL;
+static planner_hook_type prev_planner_hook = NULL;
+static join_search_hook_type prev_join_search_hook = NULL;
 
 /*
  * global_ee_state сохраняет переменные расширения,
@@ -77,7 +156,28 @@ static explain_per_plan_hook_type prev_explain_per_plan_hook = NULL;
  * Инициализируется каждый раз при вызове EXPLAIN.
  */
 static EEState    		*global_ee_state = NULL;
-static MemoryContext 	ee_ctx;
+static MemoryContext 	ee_ctx = NULL;
+
+/*
+ * Пути прерванных сборов EXPLAIN (get_paths, save_aborted), ожидающие
+ * записи в таблицы расширения. Каждый элемент хранится в собственном
+ * контексте памяти сбора (ee_ctx на момент сбора).
+ */
+typedef struct EEQueuedCapture
+{
+	MemoryContext ctx;
+	EEState	   *ee_state;
+	char	   *query_string;
+
+	/* Значение ee.sink на момент сбора */
+	int			sink;
+} EEQueuedCapture;
+
+static List *ee_capture_queue = NIL;
+
+static int64 store_capture(const char *queryString, EEState *ee_state,
+						   int sink);
+static void ee_log_backend_capture(const char *query_string);
 
 static PathCostComparison	compare_path_costs_fuzzily(Path *path1, 
 													   Path *path2, 
@@ -93,8 +193,39 @@ static void	mark_old_path_displaced(EEPath *old_eepath, EEPath *new_eepath,
 									PathParallelSafeComparison parallel_safe_cmp);
 static void	mark_new_path_removed(EEPath *new_eepath);
 static void record_projection_paths(EERel *eerel);
+static void record_join_pair(PlannerInfo *root, RelOptInfo *joinrel,
+							 RelOptInfo *outer_rel, RelOptInfo *inner_rel,
+							 bool accepted);
+static void record_join_levels(EEJoinSearch *search, int last_level);
+static void track_join_level(PlannerInfo *root);
+static RelOptInfo *call_join_search(PlannerInfo *root, int levels_needed,
+									List *initial_rels);
+static Size ee_planner_mem(void);
+static bool collapse_partition_child(RelOptInfo *rel, Path *new_path);
+static EERel *get_current_eerel(RelOptInfo *parent_rel);
+static EERel *get_sub_eerel(RelOptInfo *roi);
+static PathCostComparison compare_partial_path_costs(Path *path1, Path *path2,
+													 double fuzz_factor);
+static bool is_collapsed_partition(RelOptInfo *roi);
+static bool is_partition_child(RelOptInfo *rel);
+static void ee_mark_final_plan(PlannedStmt *plannedstmt);
+static Path *top_final_path(RelOptInfo *final_rel, int cursor_options);
+static EEPath *search_final_eepath(RelOptInfo *final_rel, Path *path,
+								   Plan *plan, bool use_cheapest);
+static void mark_final_eepath(EEPath *eepath, int depth);
+static bool eepath_path_freed(EEPath *eepath);
+static EEPath *search_rel_eepath(Path *path, EERel *eerel);
+static EEPartitionGroup *search_partition_group(RelOptInfo *parent);
+static void finish_partition_groups(EESubQuery *eesubquery);
+static void record_prechecked_path(RelOptInfo *joinrel, NodeTag pathtype,
+								   JoinType jointype, Path *outer_path,
+								   Path *inner_path,
+								   JoinCostWorkspace *workspace,
+								   List *pathkeys, bool parameterized,
+								   bool partial, Path *dominating_path);
 static bool check_my_guc_list(char **newval, void **extra, GucSource source);
 static void assign_my_guc_list(const char *newval, void *extra);
+static bool path_is_fixated(Path *path, int64 level, int64 fingerprint);
 
 void
 _PG_init(void)
@@ -116,6 +247,9 @@ _PG_init(void)
 	RegisterExtensionExplainOption("get_paths", ee_get_paths_handler);
 	RegisterExtensionExplainOption("hide_disabled", ee_hide_disabled_handler);
 	RegisterExtensionExplainOption("fixate_paths", ee_fixate_paths_handler);
+	RegisterExtensionExplainOption("save_aborted", ee_save_aborted_handler);
+	RegisterExtensionExplainOption("collapse_partitions", ee_collapse_partitions_handler);
+	RegisterExtensionExplainOption("alternatives", ee_alternatives_handler);
 
 	#else 
 
@@ -160,6 +294,36 @@ _PG_init(void)
         false,
         PGC_USERSET,
         GUC_NOT_IN_SAMPLE,
+        NULL,
+		NULL,
+		NULL);    
+
+	/*
+	 * Определяем GUC переменную save_aborted 
+	 */
+    DefineCustomBoolVariable(
+        "ee.save_aborted",
+        "Save paths captured before an error",
+        NULL,
+        &save_aborted,
+        false,
+        PGC_USERSET,
+        GUC_NOT_IN_SAMPLE,
+        NULL,
+		NULL,
+		NULL);    
+
+	/*
+	 * Определяем GUC переменную collapse_partitions 
+	 */
+    DefineCustomBoolVariable(
+        "ee.collapse_partitions",
+        "Save one representative per group of partition child relations",
+        NULL,
+        &collapse_partitions,
+        false,
+        PGC_USERSET,
+        GUC_NOT_IN_SAMPLE,
         NULL,
 		NULL,
 		NULL);    
@@ -177,6 +341,36 @@ _PG_init(void)
 		assign_my_guc_list,
 		NULL);
 
+	DefineCustomRealVariable(
+		"ee.fixate_cost_tolerance",
+		"Relative total cost deviation allowed for fixated paths",
+		"-1 matches fixated paths by fingerprint only.",
+		&fixate_cost_tolerance,
+		-1.0,
+		-1.0,
+		1000.0,
+		PGC_USERSET,
+		0,
+		NULL,
+		NULL,
+		NULL);
+
+	DefineCustomIntVariable(
+		"ee.fixate_subquery",
+		"Subquery in which ee.fixate_paths is applied",
+		"0 applies fixated paths in every subquery.",
+		&fixate_subquery,
+		0,
+		0,
+		INT_MAX,
+		PGC_USERSET,
+		0,
+		NULL,
+		NULL,
+		NULL);
+
+	ee_capture_log_init();
+
 	MarkGUCPrefixReserved("ee");
 
 	prev_ExplainOneQuery_hook = ExplainOneQuery_hook;
@@ -185,6 +379,15 @@ _PG_init(void)
 	prev_add_path_hook = add_path_hook;
 	add_path_hook = ee_add_path_hook;
 
+	prev_add_partial_path_hook = add_partial_path_hook;
+	add_partial_path_hook = ee_add_partial_path_hook;
+
+	prev_set_cheapest_hook = set_cheapest_hook;
+	set_cheapest_hook = ee_set_cheapest_hook;
+
+	prev_join_path_precheck_hook = join_path_precheck_hook;
+	join_path_precheck_hook = ee_join_path_precheck_hook;
+
 	prev_set_rel_pathlist_hook = set_rel_pathlist_hook;
 	set_rel_pathlist_hook = ee_remember_rel_pathlist;
 
@@ -193,6 +396,30 @@ _PG_init(void)
 
 	prev_explain_per_plan_hook = explain_per_plan_hook;
 	explain_per_plan_hook = ee_explain_per_plan_hook;
+
+#if (PG_VERSION_NUM >= 180000)
+	prev_explain_per_node_hook = explain_per_node_hook;
+	explain_per_node_hook = ee_explain_per_node_hook;
+#endif
+
+	prev_ProcessUtility_hook = ProcessUtility_hook;
+	ProcessUtility_hook = ee_process_utility;
+
+	prev_planner_hook = planner_hook;
+	planner_hook = ee_planner;
+
+	prev_join_search_hook = join_search_hook;
+	join_search_hook = ee_join_search;
+
+	RegisterXactCallback(ee_xact_callback, NULL);
+
+	/*
+	 * Сбор путей другого процесса (ee.capture_backend) использует
+	 * разделяемую память и доступен только при загрузке расширения через
+	 * shared_preload_libraries.
+	 */
+	if (process_shared_preload_libraries_in_progress)
+		ee_backend_capture_init();
 }
 
 #if (PG_VERSION_NUM >= 180000)
@@ -249,6 +476,60 @@ ee_fixate_paths_handler(ExplainState *es, DefElem *opt,
 
 	options->fixate_paths = defGetBoolean(opt);
 }
+
+/*
+ * Функция-обработчик параметра save_aborted для EXPLAIN
+ */
+static void 
+ee_save_aborted_handler(ExplainState *es, DefElem *opt,
+						ParseState *pstate)
+{
+	extended_explain_options *options = GetExplainExtensionState(es, ee_extension_id);
+
+	if (options == NULL)
+	{
+		options = palloc0(sizeof(extended_explain_options));
+		SetExplainExtensionState(es, ee_extension_id, options);
+	}
+
+	options->save_aborted = defGetBoolean(opt);
+}
+
+/*
+ * Функция-обработчик параметра collapse_partitions для EXPLAIN
+ */
+static void 
+ee_collapse_partitions_handler(ExplainState *es, DefElem *opt,
+							   ParseState *pstate)
+{
+	extended_explain_options *options = GetExplainExtensionState(es, ee_extension_id);
+
+	if (options == NULL)
+	{
+		options = palloc0(sizeof(extended_explain_options));
+		SetExplainExtensionState(es, ee_extension_id, options);
+	}
+
+	options->collapse_partitions = defGetBoolean(opt);
+}
+
+/*
+ * Функция-обработчик параметра alternatives для EXPLAIN
+ */
+static void 
+ee_alternatives_handler(ExplainState *es, DefElem *opt,
+						ParseState *pstate)
+{
+	extended_explain_options *options = GetExplainExtensionState(es, ee_extension_id);
+
+	if (options == NULL)
+	{
+		options = palloc0(sizeof(extended_explain_options));
+		SetExplainExtensionState(es, ee_extension_id, options);
+	}
+
+	options->alternatives = defGetBoolean(opt);
+}
 #endif
 
 /*
@@ -302,6 +583,95 @@ get_fixate_paths_setting(struct ExplainState *es)
 #endif
 }
 
+/*
+ * Функция получения значения параметра save_aborted.
+ */
+static bool
+get_save_aborted_setting(struct ExplainState *es)
+{
+#if (PG_VERSION_NUM >= 180000)
+	extended_explain_options *options;
+
+	options = GetExplainExtensionState(es, ee_extension_id);
+
+	return !(options == NULL || !options->save_aborted);
+#else
+	return save_aborted;
+#endif
+}
+
+/*
+ * Функция получения значения параметра collapse_partitions.
+ */
+static bool
+get_collapse_partitions_setting(struct ExplainState *es)
+{
+#if (PG_VERSION_NUM >= 180000)
+	extended_explain_options *options;
+
+	options = GetExplainExtensionState(es, ee_extension_id);
+
+	return !(options == NULL || !options->collapse_partitions);
+#else
+	return collapse_partitions;
+#endif
+}
+
+/*
+ * Функция получения значения параметра alternatives. Параметр использует
+ * explain_per_node_hook и доступен только начиная с PostgreSQL 18.
+ */
+static bool
+get_alternatives_setting(struct ExplainState *es)
+{
+#if (PG_VERSION_NUM >= 180000)
+	extended_explain_options *options;
+
+	options = GetExplainExtensionState(es, ee_extension_id);
+
+	return !(options == NULL || !options->alternatives);
+#else
+	return false;
+#endif
+}
+
+/*
+ * Получение значений параметров расширения из списка опций команды EXPLAIN.
+ *
+ * Используется там, где ExplainState еще не создан (ProcessUtility_hook).
+ */
+static void
+get_explain_stmt_settings(List *options, extended_explain_options *ee_options)
+{
+#if (PG_VERSION_NUM >= 180000)
+	ListCell   *lc;
+
+	foreach(lc, options)
+	{
+		DefElem    *opt = lfirst_node(DefElem, lc);
+
+		if (strcmp(opt->defname, "get_paths") == 0)
+			ee_options->get_paths = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "hide_disabled") == 0)
+			ee_options->hide_disabled = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "fixate_paths") == 0)
+			ee_options->fixate_paths = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "save_aborted") == 0)
+			ee_options->save_aborted = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "collapse_partitions") == 0)
+			ee_options->collapse_partitions = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "alternatives") == 0)
+			ee_options->alternatives = defGetBoolean(opt);
+	}
+#else
+	ee_options->get_paths = get_paths;
+	ee_options->hide_disabled = hide_disabled;
+	ee_options->fixate_paths = enable_fixate_paths;
+	ee_options->save_aborted = save_aborted;
+	ee_options->collapse_partitions = collapse_partitions;
+#endif
+}
+
 static bool
 check_my_guc_list(char **newvalue, void **extra, GucSource source)
 {
@@ -358,66 +728,154 @@ check_my_guc_list(char **newvalue, void **extra, GucSource source)
     return true;
 }
 
+/*
+ * Разбор ee.fixate_paths -- списка троек (уровень, отпечаток пути, полная
+ * стоимость в сотых долях). Пути группируются в хеш-таблице по уровню и
+ * отпечатку, что позволяет проверять каждый новый путь за O(1).
+ */
 static void
 assign_my_guc_list(const char *newvalue, void *extra)
 {
 	MemoryContext old_ctx;
-	ListCell		*lc1;
-	ListCell		*lc2;
-	ListCell		*lc3;
-	RelPathIdPair	*item;
-	List			*parsed_list = NIL;
-	char			*rawstring;
-	List			*elemlist = NIL;
-
-    rawstring = pstrdup(newvalue);
+	ListCell   *lc;
+	char	   *rawstring;
+	List	   *elemlist = NIL;
+	HASHCTL		hash_ctl;
 
-    SplitIdentifierString(rawstring, ',', &elemlist);
+	if (fixated_ctx != NULL)
+	{
+		MemoryContextDelete(fixated_ctx);
+		fixated_ctx = NULL;
+		fixated_paths = NULL;
+		fixated_costs = NULL;
+		fixated_levels = NULL;
+	}
 
-	old_ctx = MemoryContextSwitchTo(TopMemoryContext);
+	rawstring = pstrdup(newvalue);
 
-	if (elemlist == NIL)
+	if (!SplitIdentifierString(rawstring, ',', &elemlist) || elemlist == NIL)
 	{
-		if (my_guc_list != NIL)
-        	list_free_deep(my_guc_list);
-			my_guc_list = NIL;
+		pfree(rawstring);
+		list_free(elemlist);
 		return;
 	}
 
-	lc1 = list_head(elemlist);	
-	lc2 = lnext(elemlist, lc1);
-	lc3 = lnext(elemlist, lc2);
-	while (lc1 != NULL && lc2 != NULL && lc3 != NULL)
-	{
-        char   *endptr;
-        char   *tok1 = (char *) lfirst(lc1);
-        char   *tok2 = (char *) lfirst(lc2);
-        char   *tok3 = (char *) lfirst(lc3);
-		item = (RelPathIdPair *) palloc(sizeof(RelPathIdPair));
+	fixated_ctx = AllocSetContextCreate(TopMemoryContext,
+										"ee fixate_paths",
+										ALLOCSET_SMALL_SIZES);
+	old_ctx = MemoryContextSwitchTo(fixated_ctx);
+
+	memset(&hash_ctl, 0, sizeof(HASHCTL));
+	hash_ctl.keysize = sizeof(FixatedPathKey);
+	hash_ctl.entrysize = sizeof(FixatedPathEntry);
+	hash_ctl.hcxt = fixated_ctx;
+	fixated_paths = hash_create("ee fixated paths", list_length(elemlist) / 3,
+								&hash_ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	memset(&hash_ctl, 0, sizeof(HASHCTL));
+	hash_ctl.keysize = sizeof(FixatedCostKey);
+	hash_ctl.entrysize = sizeof(FixatedCostKey);
+	hash_ctl.hcxt = fixated_ctx;
+	fixated_costs = hash_create("ee fixated costs", list_length(elemlist) / 3,
+								&hash_ctl,
+								HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	memset(&hash_ctl, 0, sizeof(HASHCTL));
+	hash_ctl.keysize = sizeof(int64);
+	hash_ctl.entrysize = sizeof(int64);
+	hash_ctl.hcxt = fixated_ctx;
+	fixated_levels = hash_create("ee fixated levels", 16, &hash_ctl,
+								 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	MemoryContextSwitchTo(old_ctx);
 
-		item->level_id = strtoll(tok1, &endptr, 10);
-		item->startup_cost = strtoll(tok2, &endptr, 10);
-		item->total_cost = strtoll(tok3, &endptr, 10);
+	/* Количество элементов кратно трем (check_my_guc_list) */
+	for (lc = list_head(elemlist); lc != NULL; lc = lnext(elemlist, lc))
+	{
+		FixatedPathKey key;
+		FixatedPathEntry *entry;
+		FixatedCostKey cost_key;
+		int64		total_cost;
+		bool		found;
+
+		key.level = strtoll((char *) lfirst(lc), NULL, 10);
+		lc = lnext(elemlist, lc);
+		key.fingerprint = strtoll((char *) lfirst(lc), NULL, 10);
+		lc = lnext(elemlist, lc);
+		total_cost = strtoll((char *) lfirst(lc), NULL, 10);
+
+		entry = (FixatedPathEntry *) hash_search(fixated_paths, &key,
+												 HASH_ENTER, &found);
+		if (!found)
+		{
+			entry->min_total_cost = total_cost;
+			entry->max_total_cost = total_cost;
+		}
+		else
+		{
+			entry->min_total_cost = Min(entry->min_total_cost, total_cost);
+			entry->max_total_cost = Max(entry->max_total_cost, total_cost);
+		}
 
-        parsed_list = lappend(parsed_list, item);
+		/*
+		 * Формат тройки по значению не определить: отпечаток, как и
+		 * стоимость, -- неотрицательное целое. Поэтому каждая тройка
+		 * запоминается и как тройка прежнего формата.
+		 */
+		cost_key.level = key.level;
+		cost_key.startup_cost = key.fingerprint;
+		cost_key.total_cost = total_cost;
+		hash_search(fixated_costs, &cost_key, HASH_ENTER, NULL);
 
-		lc1 = lnext(elemlist, lc3);	
-		lc2 = lnext(elemlist, lc1);
-		lc3 = lnext(elemlist, lc2);
+		hash_search(fixated_levels, &key.level, HASH_ENTER, NULL);
 	}
 
-    if (my_guc_list != NIL)
+	pfree(rawstring);
+	list_free(elemlist);
+}
+
+/*
+ * Путь path зафиксирован ee.fixate_paths.
+ *
+ * Путь должен совпадать с одним из зафиксированных путей уровня по
+ * отпечатку, а при ee.fixate_cost_tolerance >= 0 еще и по полной стоимости
+ * с указанным относительным отклонением. Тройки прежнего формата (уровень,
+ * стоимость запуска, полная стоимость) по-прежнему принимаются: путь без
+ * совпадающего отпечатка зафиксирован, если обе его стоимости, округленные
+ * до сотых, совпадают с указанными.
+ */
+static bool
+path_is_fixated(Path *path, int64 level, int64 fingerprint)
+{
+	FixatedPathKey key;
+	FixatedPathEntry *entry;
+	double		total_cost;
+
+	key.level = level;
+	key.fingerprint = fingerprint;
+
+	entry = (FixatedPathEntry *) hash_search(fixated_paths, &key, HASH_FIND, NULL);
+
+	if (entry == NULL)
 	{
-        list_free_deep(my_guc_list);
-		my_guc_list = NIL;
+		FixatedCostKey cost_key;
+
+		cost_key.level = level;
+		cost_key.startup_cost = (int64) floor(100.0 * path->startup_cost + 0.5);
+		cost_key.total_cost = (int64) floor(100.0 * path->total_cost + 0.5);
+
+		return hash_search(fixated_costs, &cost_key, HASH_FIND, NULL) != NULL;
 	}
-    
-	my_guc_list = parsed_list;  /* extra содержит отсортированный список */
 
-	MemoryContextSwitchTo(old_ctx);
+	if (fixate_cost_tolerance < 0)
+		return true;
 
-    pfree(rawstring);
-    list_free(elemlist);
+	total_cost = 100.0 * path->total_cost;
+
+	/* 0.5 -- погрешность округления стоимости в ee.fixate_paths */
+	return total_cost >= entry->min_total_cost * (1.0 - fixate_cost_tolerance) - 0.5 &&
+		total_cost <= entry->max_total_cost * (1.0 + fixate_cost_tolerance) + 0.5;
 }
 
 /* ----------------------------------------------------------------
@@ -445,6 +903,12 @@ create_ee_state(void)
 	ee_state->eerel_counter = 1;
 	ee_state->eesubquery_counter = 1;
 
+	ee_state->current_plan_kind = EE_PLAN_DEFAULT;
+	ee_state->plancache_generic_cost = -1;
+	ee_state->plancache_avg_custom_cost = -1;
+	ee_state->plancache_custom_plans = 0;
+	ee_state->plancache_choice = EE_PLAN_DEFAULT;
+
 	memset(&ctl, 0, sizeof(HASHCTL));
 	ctl.keysize = sizeof(uintptr_t);
 	ctl.entrysize = sizeof(EERelHashEntry);
@@ -457,78 +921,310 @@ create_ee_state(void)
 	ctl.hcxt = ee_ctx;
 	ee_state->eepath_by_path = hash_create("EEPath by path*", 32, &ctl, HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
 
+	memset(&ctl, 0, sizeof(HASHCTL));
+	ctl.keysize = sizeof(uintptr_t);
+	ctl.entrysize = sizeof(EECollapsedRel);
+	ctl.hcxt = ee_ctx;
+	ee_state->collapsed_by_roi = hash_create("EECollapsedRel by RelOptInfo*", 32, &ctl, HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+
+	ee_init_interning(ee_state);
+
 	MemoryContextSwitchTo(old_ctx);
 
 	return ee_state;
 }
 
-/* ----------------------------------------------------------------
- *				Функции-обработчики хуков
- * ----------------------------------------------------------------
- */
-
 /*
- * Функция-обработчик хука add_path_hook
+ * Начало сбора путей.
  *
- * В данном обработчике сохранена логика функции add_path, 
- * а также добавлен механизм сохранения путей.
+ * Создает контекст памяти расширения и global_ee_state. Все последующие
+ * вызовы планировщика вплоть до ee_end_capture() будут перехватываться.
  */
-void
-ee_add_path_hook(RelOptInfo *parent_rel,
-				 Path *new_path)
+EEState *
+ee_begin_capture(extended_explain_options *options)
 {
-	bool		accept_new = true;	/* unless we find a superior old path */
-	List	   *new_path_pathkeys;
-	ListCell   *p1;
+	ee_ctx = AllocSetContextCreate(TopMemoryContext,
+								   "extended explain context",
+								   ALLOCSET_DEFAULT_SIZES);
 
-	EERel	   *eerel;
-	EEPath	   *new_eepath;
-	EEPath 	   *old_eepath;
-	MemoryContext old_ctx;
+	global_ee_state = create_ee_state();
+	global_ee_state->options = *options;
 
-	instr_time	start;
-	instr_time	duration;
+	global_ee_state->planner_mem_ctx = CurrentMemoryContext;
+	global_ee_state->planner_mem_base = MemoryContextMemAllocated(CurrentMemoryContext, true);
 
-	if (global_ee_state != NULL)
-	{
-		INSTR_TIME_SET_CURRENT(start);
+	init_eesubquery();
 
-		old_ctx = MemoryContextSwitchTo(ee_ctx);
+	INSTR_TIME_SET_CURRENT(global_ee_state->start_time);
 
-		if (global_ee_state->cached_current_rel == parent_rel)
-		{
-			/*
-			* Нужное EERel отношение сохранилось в кэше.
-			*/
-			eerel = global_ee_state->cached_current_eerel;
-		}
-		else
-		{
-			/*
-			* Нужного EERel отношения не оказалось в кэше, значит ищем его 
-			* в списке отношений текущего подзапроса.
-			*/
-			eerel = search_eerel(parent_rel);
-			if (eerel == NULL)
-			{
-				/*
-				* Если отношение не было найдено, его необходимо создать 
-				*/
-				eerel = create_eerel(parent_rel);
-			}
+	return global_ee_state;
+}
 
-			/* Обновляем кэш */
-			global_ee_state->cached_current_rel = parent_rel;
-			global_ee_state->cached_current_eerel = eerel;
-		}
+/*
+ * Запись собранных путей в таблицы ee.query и ee.paths.
+ * При ee.sink = packed пути упаковываются в ee.query.packed_paths.
+ *
+ * Возвращает идентификатор записи в таблице ee.query.
+ */
+int64
+ee_store_capture(const char *queryString)
+{
+	global_ee_state->capture_mem = MemoryContextMemAllocated(ee_ctx, true);
 
-		/*
-		* Создаем eepath по new_path. 
-		* 
-		* По умолчанию путь считается сохраненным в pathlist (add_path_result = APR_SAVED), 
-		* однако в процессе работы функции add_path данное состояние может измениться.
-		*/
-		new_eepath = record_eepath(eerel, new_path);
+	return store_capture(queryString, global_ee_state, ee_sink);
+}
+
+/*
+ * Запись путей ee_state в таблицы расширения. sink -- значение ee.sink на
+ * момент сбора: пути из очереди записываются позже, когда параметр может
+ * быть уже изменен.
+ */
+static int64
+store_capture(const char *queryString, EEState *ee_state, int sink)
+{
+	int64		query_id;
+
+	query_id = insert_query_info_into_eequery(queryString, ee_state,
+											  sink == EE_SINK_PACKED);
+	if (sink != EE_SINK_PACKED)
+		insert_paths_into_eepaths(query_id, ee_state,
+								  ee_state->options.hide_disabled);
+	insert_rels_into_eerels(query_id, ee_state);
+	insert_join_search_into_eetables(query_id, ee_state);
+	insert_partition_groups_into_eepartgroups(query_id, ee_state);
+	insert_prechecked_paths_into_eeprechecked(query_id, ee_state);
+	insert_join_graph_into_eetables(query_id, ee_state);
+
+	return query_id;
+}
+
+/*
+ * Запись путей, собранных при выполнении EXPLAIN, в соответствии с ee.sink:
+ * в таблицы расширения или в журнал сборов.
+ */
+static void
+ee_save_capture(const char *queryString)
+{
+	if (ee_sink == EE_SINK_MMAP_LOG)
+		ee_log_write_capture(queryString, global_ee_state);
+	else
+		ee_store_capture(queryString);
+}
+
+/*
+ * Завершение сбора путей: освобождает память расширения и сбрасывает
+ * global_ee_state.
+ */
+void
+ee_end_capture(void)
+{
+	if (ee_ctx != NULL)
+		MemoryContextDelete(ee_ctx);
+
+	ee_ctx = NULL;
+	global_ee_state = NULL;
+}
+
+/*
+ * Постановка собранных путей в очередь на запись.
+ *
+ * Контекст памяти сбора не освобождается, а передается в очередь вместе с
+ * global_ee_state. Пути записываются при фиксации транзакции
+ * (ee_xact_callback), поскольку сам запрос может исполняться в транзакции
+ * только для чтения или завершиться ошибкой.
+ */
+static void
+ee_queue_capture(const char *query_string)
+{
+	EEQueuedCapture *entry;
+	MemoryContext old_ctx;
+
+	/* Журнал сборов не требует транзакции: пути записываются сразу */
+	if (ee_sink == EE_SINK_MMAP_LOG)
+	{
+		ee_log_write_capture(query_string, global_ee_state);
+		ee_end_capture();
+		return;
+	}
+
+	global_ee_state->capture_mem = MemoryContextMemAllocated(ee_ctx, true);
+
+	entry = (EEQueuedCapture *) MemoryContextAlloc(ee_ctx, sizeof(EEQueuedCapture));
+	entry->ctx = ee_ctx;
+	entry->ee_state = global_ee_state;
+	entry->query_string = MemoryContextStrdup(ee_ctx,
+											  query_string ? query_string : "");
+	entry->sink = ee_sink;
+
+	old_ctx = MemoryContextSwitchTo(TopMemoryContext);
+	ee_capture_queue = lappend(ee_capture_queue, entry);
+	MemoryContextSwitchTo(old_ctx);
+
+	/* Контекст памяти теперь принадлежит очереди */
+	ee_ctx = NULL;
+	global_ee_state = NULL;
+}
+
+/*
+ * Запись путей из очереди в таблицы ee.query и ee.paths.
+ *
+ * Каждая запись выполняется в подтранзакции: ошибка записи не должна
+ * приводить к откату транзакции, в которой выполняется запись.
+ */
+static void
+ee_flush_capture_queue(void)
+{
+	MemoryContext fn_ctx = CurrentMemoryContext;
+	ResourceOwner fn_owner = CurrentResourceOwner;
+
+	/* Расширение не установлено в текущей базе данных */
+	if (!OidIsValid(get_extension_oid("extended_explain", true)))
+		return;
+
+	while (ee_capture_queue != NIL)
+	{
+		EEQueuedCapture *entry = (EEQueuedCapture *) linitial(ee_capture_queue);
+
+		ee_capture_queue = list_delete_first(ee_capture_queue);
+
+		BeginInternalSubTransaction(NULL);
+		MemoryContextSwitchTo(fn_ctx);
+
+		PG_TRY();
+		{
+			store_capture(entry->query_string, entry->ee_state, entry->sink);
+
+			ReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(fn_ctx);
+			CurrentResourceOwner = fn_owner;
+		}
+		PG_CATCH();
+		{
+			ErrorData  *edata;
+
+			MemoryContextSwitchTo(fn_ctx);
+			edata = CopyErrorData();
+			FlushErrorState();
+
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(fn_ctx);
+			CurrentResourceOwner = fn_owner;
+
+			ereport(WARNING,
+					(errmsg("could not store captured paths"),
+					 errdetail("%s", edata->message)));
+
+			FreeErrorData(edata);
+		}
+		PG_END_TRY();
+
+		MemoryContextDelete(entry->ctx);
+	}
+}
+
+/*
+ * Завершение сбора путей при ошибке. Вызывается из блока PG_CATCH.
+ *
+ * Если задан параметр save_aborted, пути, собранные до ошибки, ставятся в
+ * очередь на запись вместе с текстом ошибки. Текущая транзакция будет
+ * отменена, поэтому пути запишутся при фиксации следующей транзакции.
+ * Иначе собранные пути просто освобождаются.
+ */
+void
+ee_abort_capture(const char *queryString)
+{
+	if (global_ee_state != NULL &&
+		global_ee_state->options.get_paths &&
+		global_ee_state->options.save_aborted)
+	{
+		MemoryContext old_ctx;
+		ErrorData  *edata;
+
+		old_ctx = MemoryContextSwitchTo(ee_ctx);
+
+		edata = CopyErrorData();
+
+		global_ee_state->aborted = true;
+		global_ee_state->error_message = edata->message;
+
+		MemoryContextSwitchTo(old_ctx);
+
+		ee_queue_capture(queryString);
+	}
+
+	ee_end_capture();
+}
+
+/*
+ * Идет ли в данный момент сбор путей
+ */
+bool
+ee_capture_in_progress(void)
+{
+	return global_ee_state != NULL;
+}
+
+/* ----------------------------------------------------------------
+ *				Функции-обработчики хуков
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * Функция-обработчик хука add_path_hook
+ *
+ * В данном обработчике сохранена логика функции add_path, 
+ * а также добавлен механизм сохранения путей.
+ */
+void
+ee_add_path_hook(RelOptInfo *parent_rel,
+				 Path *new_path)
+{
+	bool		accept_new = true;	/* unless we find a superior old path */
+	List	   *new_path_pathkeys;
+	ListCell   *p1;
+
+	EERel	   *eerel;
+	EEPath	   *new_eepath;
+	EEPath 	   *old_eepath;
+	MemoryContext old_ctx;
+
+	instr_time	start;
+	instr_time	duration;
+	int			pathlist_len;
+
+	/*
+	 * В режиме collapse_partitions пути секций, не являющихся представителями
+	 * своей группы, не записываются.
+	 */
+	if (global_ee_state != NULL &&
+		global_ee_state->options.collapse_partitions &&
+		collapse_partition_child(parent_rel, new_path))
+	{
+		/* Путь учтен в распределении стоимостей группы */
+	}
+	else if (global_ee_state != NULL)
+	{
+		INSTR_TIME_SET_CURRENT(start);
+
+		old_ctx = MemoryContextSwitchTo(ee_ctx);
+
+		eerel = get_current_eerel(parent_rel);
+
+		/*
+		* Создаем eepath по new_path. 
+		* 
+		* По умолчанию путь считается сохраненным в pathlist (add_path_result = APR_SAVED), 
+		* однако в процессе работы функции add_path данное состояние может измениться.
+		*/
+		new_eepath = record_eepath(eerel, new_path, false);
+
+		/* Профиль вызовов add_path для отношения */
+		if (eerel->add_path_calls == 0)
+			eerel->first_add_path = start;
+		eerel->last_add_path = start;
+		eerel->add_path_calls++;
+
+		pathlist_len = list_length(parent_rel->pathlist);
 
 		new_path_pathkeys = new_path->param_info ? NIL : new_path->pathkeys;
 
@@ -665,7 +1361,9 @@ ee_add_path_hook(RelOptInfo *parent_rel,
 			*/
 			if (remove_old)
 			{
-				old_eepath = search_eepath(old_path);
+				pathlist_len--;
+
+				old_eepath = search_rel_eepath(old_path, eerel);
 
 				/*
 				* Добавляем в old_eepath информацию о вытеснении.
@@ -686,12 +1384,18 @@ ee_add_path_hook(RelOptInfo *parent_rel,
 			*/
 			mark_new_path_removed(new_eepath);
 		}
+		else
+			pathlist_len++;
+
+		/* Длина pathlist после завершения add_path */
+		eerel->max_pathlist_len = Max(eerel->max_pathlist_len, pathlist_len);
 
 		MemoryContextSwitchTo(old_ctx);
 
 		INSTR_TIME_SET_CURRENT(duration);
 		INSTR_TIME_SUBTRACT(duration, start);
 		INSTR_TIME_ADD(global_ee_state->ee_time, duration);
+		INSTR_TIME_ADD(eerel->add_path_time, duration);
 	}
 
 	/* Pass call to previous hook. */
@@ -700,100 +1404,180 @@ ee_add_path_hook(RelOptInfo *parent_rel,
 }
 
 /*
- * Функция-обработчик хука ExplainOneQuery_hook
+ * Функция-обработчик хука add_partial_path_hook
+ *
+ * Повторяет логику функции add_partial_path: частичные пути сравниваются
+ * только по количеству отключенных узлов, полной стоимости и pathkeys.
+ * Записанные пути помечаются как частичные.
  */
 void
-ee_explain(Query *query, int cursorOptions,
-		   IntoClause *into, struct ExplainState *es,
-		   const char *queryString, ParamListInfo params,
-		   QueryEnvironment *queryEnv)
+ee_add_partial_path_hook(RelOptInfo *parent_rel,
+						 Path *new_path)
 {
-	bool get_paths_setting = get_get_paths_setting(es);
-	bool hide_disabled_setting = get_hide_disabled_setting(es);
-	bool fixate_paths_setting = get_fixate_paths_setting(es);
-
-	if (hide_disabled_setting && !get_paths_setting)
+	if (global_ee_state != NULL && !is_collapsed_partition(parent_rel))
 	{
-		ereport(ERROR,
-				(errcode(ERRCODE_SYNTAX_ERROR),
-				 errmsg("EXPLAIN option hide_disable requires option get_paths")));
-	}
+		bool		accept_new = true;	/* unless we find a superior old path */
+		ListCell   *p1;
+		EERel	   *eerel;
+		EEPath	   *new_eepath;
+		MemoryContext old_ctx;
+		instr_time	start;
+		instr_time	duration;
 
-	if (get_paths_setting || 
-		fixate_paths_setting)	
-	{
-		int64		query_id;
+		INSTR_TIME_SET_CURRENT(start);
 
-		ee_ctx = AllocSetContextCreate(TopMemoryContext,
-									   "extended explain context",
-									   ALLOCSET_DEFAULT_SIZES);
+		old_ctx = MemoryContextSwitchTo(ee_ctx);
 
-		global_ee_state = create_ee_state();
-		global_ee_state->options.get_paths = get_paths_setting;
-		global_ee_state->options.hide_disabled = hide_disabled_setting;
-		global_ee_state->options.fixate_paths = fixate_paths_setting;
+		eerel = get_current_eerel(parent_rel);
+		new_eepath = record_eepath(eerel, new_path, true);
 
-		init_eesubquery();
+		foreach(p1, parent_rel->partial_pathlist)
+		{
+			Path	   *old_path = (Path *) lfirst(p1);
+			bool		remove_old = false; /* unless new proves superior */
+			double		fuzz_factor = STD_FUZZ_FACTOR;
+			PathKeysComparison keyscmp;
 
-		INSTR_TIME_SET_CURRENT(global_ee_state->start_time);
+			/* Compare pathkeys. */
+			keyscmp = compare_pathkeys(new_path->pathkeys, old_path->pathkeys);
 
-		standard_ExplainOneQuery(query, cursorOptions, into, es,
-								queryString, params, queryEnv);
+			/* Unless pathkeys are incompatible, keep just one of the two paths. */
+			if (keyscmp != PATHKEYS_DIFFERENT)
+			{
+				if (unlikely(new_path->disabled_nodes != old_path->disabled_nodes))
+				{
+					if (new_path->disabled_nodes > old_path->disabled_nodes)
+						accept_new = false;
+					else
+						remove_old = true;
+				}
+				else if (new_path->total_cost > old_path->total_cost
+						 * STD_FUZZ_FACTOR)
+				{
+					/* New path costs more; keep it only if pathkeys are better. */
+					if (keyscmp != PATHKEYS_BETTER1)
+						accept_new = false;
+				}
+				else if (old_path->total_cost > new_path->total_cost
+						 * STD_FUZZ_FACTOR)
+				{
+					/* Old path costs more; keep it only if pathkeys are better. */
+					if (keyscmp != PATHKEYS_BETTER2)
+						remove_old = true;
+				}
+				else if (keyscmp == PATHKEYS_BETTER1)
+				{
+					/* Costs are about the same, new path has better pathkeys. */
+					remove_old = true;
+				}
+				else if (keyscmp == PATHKEYS_BETTER2)
+				{
+					/* Costs are about the same, old path has better pathkeys. */
+					accept_new = false;
+				}
+				else
+				{
+					fuzz_factor = 1.0000000001;
 
-		if (get_paths_setting)
-		{
-			query_id = insert_query_info_into_eequery(queryString);
-			insert_paths_into_eepaths(query_id, global_ee_state, get_hide_disabled_setting(es));
+					if (old_path->total_cost > new_path->total_cost * fuzz_factor)
+					{
+						/* Pathkeys are the same, and the old path costs more. */
+						remove_old = true;
+					}
+					else
+					{
+						/*
+						 * Pathkeys are the same, and new path isn't materially
+						 * cheaper.
+						 */
+						accept_new = false;
+					}
+				}
+			}
+
+			/*
+			 * Вытесненный путь будет удален функцией add_partial_path,
+			 * поэтому информация о вытеснении записывается сейчас.
+			 */
+			if (remove_old)
+			{
+				EEPath	   *old_eepath = search_rel_eepath(old_path, eerel);
+
+				if (old_eepath != NULL)
+					mark_old_path_displaced(old_eepath, new_eepath,
+											compare_partial_path_costs(new_path, old_path, fuzz_factor),
+											fuzz_factor, keyscmp, BMS_EQUAL,
+											compare_rows(new_path->rows, old_path->rows),
+											compare_parallel_safe(new_path->parallel_safe, old_path->parallel_safe));
+			}
+
+			if (!accept_new)
+				break;
 		}
 
-		MemoryContextReset(ee_ctx);
+		if (!accept_new)
+			mark_new_path_removed(new_eepath);
 
-		global_ee_state = NULL;
-	}
-	else
-	{
-		standard_ExplainOneQuery(query, cursorOptions, into, es,
-								queryString, params, queryEnv);
+		MemoryContextSwitchTo(old_ctx);
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		INSTR_TIME_ADD(global_ee_state->ee_time, duration);
+		INSTR_TIME_ADD(eerel->add_path_time, duration);
 	}
+
+	/* Pass call to previous hook. */
+	if (prev_add_partial_path_hook)
+		(*prev_add_partial_path_hook) (parent_rel, new_path);
 }
 
 /*
- * Функция для обработки хука set_rel_pathlist_hook
+ * Функция-обработчик хука set_cheapest_hook
  *
- * Вызывается при окончании заполнения списка путей базового отношения,
- * необходима для получения названия отношения (например таблица или результат соединения).
- *
- * Во время сохранения путей название отношения не получить, поскольку из функции add_path()
- * невозможно выудить RangeTblEntry.
+ * Отмечает пути, выбранные set_cheapest наиболее дешевыми. Для одного
+ * отношения set_cheapest может вызываться несколько раз (например, после
+ * apply_scanjoin_target_to_paths), поэтому прежние отметки сбрасываются.
  */
 void
-ee_remember_rel_pathlist(PlannerInfo *root,
-						 RelOptInfo *rel,
-						 Index rti,
-						 RangeTblEntry *rte)
+ee_set_cheapest_hook(RelOptInfo *parent_rel)
 {
-	MemoryContext old_ctx;
 	EERel	   *eerel;
-	instr_time	start;
-	instr_time	duration;
 
-	if (global_ee_state != NULL)
+	if (global_ee_state != NULL &&
+		!is_collapsed_partition(parent_rel) &&
+		(eerel = search_eerel(parent_rel)) != NULL)
 	{
+		EEPath	   *eepath;
+		instr_time	start;
+		instr_time	duration;
+		ListCell   *lc;
+
 		INSTR_TIME_SET_CURRENT(start);
 
-		old_ctx = MemoryContextSwitchTo(ee_ctx);
+		foreach(lc, eerel->eepath_list)
+		{
+			eepath = (EEPath *) lfirst(lc);
 
-		if (global_ee_state->cached_current_rel == rel)
-			eerel = global_ee_state->cached_current_eerel; 
-		else
-			eerel = search_eerel(rel);
+			eepath->cheapest_total = false;
+			eepath->cheapest_startup = false;
+			eepath->cheapest_parameterized = false;
+		}
 
-		eerel->name = get_rel_name(rte->relid);
+		if (parent_rel->cheapest_total_path != NULL &&
+			(eepath = search_eepath(parent_rel->cheapest_total_path)) != NULL)
+			eepath->cheapest_total = true;
 
-		if (rte->alias != NULL)
-			eerel->alias = pstrdup(rte->alias->aliasname);
+		if (parent_rel->cheapest_startup_path != NULL &&
+			(eepath = search_eepath(parent_rel->cheapest_startup_path)) != NULL)
+			eepath->cheapest_startup = true;
 
-		MemoryContextSwitchTo(old_ctx);
+		foreach(lc, parent_rel->cheapest_parameterized_paths)
+		{
+			eepath = search_eepath((Path *) lfirst(lc));
+
+			if (eepath != NULL)
+				eepath->cheapest_parameterized = true;
+		}
 
 		INSTR_TIME_SET_CURRENT(duration);
 		INSTR_TIME_SUBTRACT(duration, start);
@@ -801,317 +1585,1643 @@ ee_remember_rel_pathlist(PlannerInfo *root,
 	}
 
 	/* Pass call to previous hook. */
-	if (prev_set_rel_pathlist_hook)
-		(*prev_set_rel_pathlist_hook) (root, rel, rti, rte);
+	if (prev_set_cheapest_hook)
+		(*prev_set_cheapest_hook) (parent_rel);
 }
 
 /*
- * Функция для обработки хука create_upper_paths_hook
+ * Функция-обработчик хука join_path_precheck_hook
+ *
+ * Вызывается из try_*_path после предварительной проверки стоимости пути
+ * соединения. Записывает пару соединяемых отношений, а если путь отброшен,
+ * то и сам путь вместе с типом соединения, внешним и внутренним
+ * отношениями и доминирующим путем. Здесь же определяются границы уровней
+ * перебора соединений.
  */
 void
-ee_process_upper_paths(PlannerInfo *root,
-					   UpperRelationKind stage,
-					   RelOptInfo *input_rel,
-					   RelOptInfo *output_rel,
-					   void *extra)
+ee_join_path_precheck_hook(PlannerInfo *root, RelOptInfo *joinrel,
+						   NodeTag pathtype, JoinType jointype,
+						   Path *outer_path, Path *inner_path,
+						   JoinCostWorkspace *workspace, List *pathkeys,
+						   Relids required_outer, bool partial,
+						   bool accepted, Path *dominating_path)
 {
-
-	if (global_ee_state != NULL && stage == UPPERREL_FINAL)
+	if (global_ee_state != NULL && !is_collapsed_partition(joinrel))
 	{
-		/* Указываем query_level для текущего eesubquery */
-		global_ee_state->current_eesubquery->subquery_level = root->query_level;
+		instr_time	start;
+		instr_time	duration;
 
-		/* Инициализируем следующий eesubquery */
-		init_eesubquery();
+		INSTR_TIME_SET_CURRENT(start);
+
+		track_join_level(root);
+		record_join_pair(root, joinrel, outer_path->parent,
+						 inner_path->parent, accepted);
+		record_prechecked_path(joinrel, pathtype, jointype, outer_path,
+							   inner_path, workspace, pathkeys,
+							   required_outer != NULL, partial,
+							   accepted ? NULL : dominating_path);
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		INSTR_TIME_ADD(global_ee_state->ee_time, duration);
 	}
 
 	/* Pass call to previous hook. */
-	if (prev_create_upper_paths_hook)
-		(*prev_create_upper_paths_hook) (root, stage, input_rel, output_rel, extra);
+	if (prev_join_path_precheck_hook)
+		(*prev_join_path_precheck_hook) (root, joinrel, pathtype, jointype,
+										 outer_path, inner_path, workspace,
+										 pathkeys, required_outer, partial,
+										 accepted, dominating_path);
 }
 
 /*
- * Функция-обработчик хука explain_per_plan_hook
+ * Функция-обработчик хука ExplainOneQuery_hook
  */
 void
-ee_explain_per_plan_hook(PlannedStmt *plannedstmt,
-						 IntoClause *into,
-						 ExplainState *es,
-						 const char *queryString,
-						 ParamListInfo params,
-						 QueryEnvironment *queryEnv)
+ee_explain(Query *query, int cursorOptions,
+		   IntoClause *into, struct ExplainState *es,
+		   const char *queryString, ParamListInfo params,
+		   QueryEnvironment *queryEnv)
 {
-	if (prev_explain_per_plan_hook)
-		(*prev_explain_per_plan_hook) (plannedstmt, into, es, queryString,
-									   params, queryEnv);
+	bool get_paths_setting = get_get_paths_setting(es);
+	bool hide_disabled_setting = get_hide_disabled_setting(es);
+	bool fixate_paths_setting = get_fixate_paths_setting(es);
+	bool save_aborted_setting = get_save_aborted_setting(es);
+	bool collapse_partitions_setting = get_collapse_partitions_setting(es);
+	bool alternatives_setting = get_alternatives_setting(es);
 
-	if (global_ee_state)
+	if (hide_disabled_setting && !get_paths_setting)
 	{
-		double plantime;
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("EXPLAIN option hide_disable requires option get_paths")));
+	}
 
-		INSTR_TIME_SET_CURRENT(global_ee_state->planning_time);
-		INSTR_TIME_SUBTRACT(global_ee_state->planning_time, global_ee_state->start_time);
-		INSTR_TIME_SUBTRACT(global_ee_state->planning_time, global_ee_state->ee_time);
+	if (save_aborted_setting && !get_paths_setting)
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("EXPLAIN option save_aborted requires option get_paths")));
+	}
 
-		plantime = INSTR_TIME_GET_DOUBLE(global_ee_state->planning_time);
+	if (collapse_partitions_setting && !get_paths_setting)
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("EXPLAIN option collapse_partitions requires option get_paths")));
+	}
 
-		ExplainOpenGroup("Extended explain", "Extended explain", false, es);
+	if (get_paths_setting || 
+		fixate_paths_setting ||
+		alternatives_setting)	
+	{
+		extended_explain_options options;
 
-		ExplainPropertyFloat("Planning time without overhead", "ms", 1000.0 * plantime, 3, es);
+		memset(&options, 0, sizeof(extended_explain_options));
+		options.get_paths = get_paths_setting;
+		options.hide_disabled = hide_disabled_setting;
+		options.fixate_paths = fixate_paths_setting;
+		options.save_aborted = save_aborted_setting;
+		options.collapse_partitions = collapse_partitions_setting;
+		options.alternatives = alternatives_setting;
 
-		ExplainCloseGroup("Extended explain", "Extended explain", false, es);
+		ee_begin_capture(&options);
+
+		/*
+		 * При ошибке (например, отмене запроса или statement_timeout во время
+		 * долгого планирования) сбор путей необходимо завершить, иначе
+		 * global_ee_state останется установленным для следующих запросов.
+		 */
+		PG_TRY();
+		{
+			/* Идентификатор запроса в терминах pg_stat_statements */
+			global_ee_state->queryid = (int64) query->queryId;
+
+			standard_ExplainOneQuery(query, cursorOptions, into, es,
+									queryString, params, queryEnv);
+
+			if (get_paths_setting)
+				ee_save_capture(queryString);
+		}
+		PG_CATCH();
+		{
+			ee_abort_capture(queryString);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		ee_end_capture();
+	}
+	else
+	{
+		standard_ExplainOneQuery(query, cursorOptions, into, es,
+								queryString, params, queryEnv);
 	}
 }
 
-/* ----------------------------------------------------------------
- *				Функции для работы с eepath
- * ----------------------------------------------------------------
+/*
+ * Вычисление значений параметров команды EXECUTE.
+ *
+ * Повторяет статическую функцию EvaluateParams из commands/prepare.c.
+ */
+static ParamListInfo
+ee_evaluate_params(ParseState *pstate, PreparedStatement *pstmt,
+				   List *params, EState *estate)
+{
+	Oid		   *param_types = pstmt->plansource->param_types;
+	int			num_params = pstmt->plansource->num_params;
+	List	   *exprstates;
+	ParamListInfo paramLI;
+	ListCell   *l;
+	int			i;
+
+	if (list_length(params) != num_params)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("wrong number of parameters for prepared statement \"%s\"",
+						pstmt->stmt_name),
+				 errdetail("Expected %d parameters but got %d.",
+						   num_params, list_length(params))));
+
+	if (num_params == 0)
+		return NULL;
+
+	params = copyObject(params);
+
+	i = 0;
+	foreach(l, params)
+	{
+		Node	   *expr = lfirst(l);
+		Oid			expected_type_id = param_types[i];
+		Oid			given_type_id;
+
+		expr = transformExpr(pstate, expr, EXPR_KIND_EXECUTE_PARAMETER);
+
+		given_type_id = exprType(expr);
+
+		expr = coerce_to_target_type(pstate, expr, given_type_id,
+									 expected_type_id, -1,
+									 COERCION_ASSIGNMENT,
+									 COERCE_IMPLICIT_CAST,
+									 -1);
+
+		if (expr == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATATYPE_MISMATCH),
+					 errmsg("parameter $%d of type %s cannot be coerced to the expected type %s",
+							i + 1,
+							format_type_be(given_type_id),
+							format_type_be(expected_type_id))));
+
+		assign_expr_collations(pstate, expr);
+
+		lfirst(l) = expr;
+		i++;
+	}
+
+	exprstates = ExecPrepareExprList(params, estate);
+
+	paramLI = makeParamList(num_params);
+
+	i = 0;
+	foreach(l, exprstates)
+	{
+		ExprState  *n = (ExprState *) lfirst(l);
+		ParamExternData *prm = &paramLI->params[i];
+
+		prm->ptype = param_types[i];
+		prm->pflags = PARAM_FLAG_CONST;
+		prm->value = ExecEvalExprSwitchContext(n,
+											   GetPerTupleExprContext(estate),
+											   &prm->isnull);
+		i++;
+	}
+
+	return paramLI;
+}
+
+/*
+ * Планирование всех запросов подготовленного оператора с записью путей.
+ */
+static void
+ee_plan_prepared(CachedPlanSource *plansource, ParamListInfo boundParams,
+				 EEPlanKind plan_kind)
+{
+	ListCell   *lc;
+
+	ee_set_plan_kind(plan_kind);
+
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = lfirst_node(Query, lc);
+
+		if (query->commandType == CMD_UTILITY)
+			continue;
+
+		if (global_ee_state->queryid == 0)
+			global_ee_state->queryid = (int64) query->queryId;
+
+		/*
+		 * Ошибка в следующем проходе относится к планированию, даже если
+		 * предыдущий проход уже завершился.
+		 */
+		global_ee_state->planning_finished = false;
+
+		ee_mark_final_plan(pg_plan_query(copyObject(query),
+										 plansource->query_string,
+										 plansource->cursor_options,
+										 boundParams));
+
+		global_ee_state->planning_finished = true;
+	}
+
+	ee_set_plan_kind(EE_PLAN_DEFAULT);
+}
+
+/*
+ * Обработка команды EXPLAIN (get_paths) EXECUTE.
+ *
+ * Хук ExplainOneQuery_hook для EXECUTE не вызывается, а plancache может
+ * вообще не планировать запрос, если у него есть подходящий generic план.
+ * Поэтому расширение самостоятельно планирует подготовленный запрос дважды:
+ * как generic план (без значений параметров) и как custom план (со
+ * значениями параметров команды EXECUTE). Пути обоих планирований попадают в
+ * одну запись ee.query и различаются по столбцу ee.paths.plan_kind.
+ *
+ * Сама команда EXPLAIN выполняется штатно (без сбора путей), после чего
+ * сохраняются стоимости, по которым plancache выбирает вид плана.
+ */
+static void
+ee_explain_execute(ExecuteStmt *execstmt, extended_explain_options *options,
+				   PlannedStmt *pstmt, const char *queryString,
+				   bool readOnlyTree,
+				   ProcessUtilityContext context,
+				   ParamListInfo params,
+				   QueryEnvironment *queryEnv,
+				   DestReceiver *dest, QueryCompletion *qc)
+{
+	PreparedStatement *entry;
+	CachedPlanSource *plansource;
+	EEState    *ee_state;
+
+	entry = FetchPreparedStatement(execstmt->name, true);
+	plansource = entry->plansource;
+
+	ee_state = ee_begin_capture(options);
+
+	PG_TRY();
+	{
+		ParseState *pstate;
+		EState	   *estate;
+		ParamListInfo paramLI;
+		int64		custom_plans_before;
+
+		estate = CreateExecutorState();
+
+		pstate = make_parsestate(NULL);
+		pstate->p_sourcetext = queryString;
+
+		paramLI = ee_evaluate_params(pstate, entry, execstmt->params, estate);
+
+		/* Перепроверяем query_list на случай инвалидации plancache */
+		(void) CachedPlanGetTargetList(plansource, queryEnv);
+
+		ee_plan_prepared(plansource, NULL, EE_PLAN_GENERIC);
+
+		if (paramLI != NULL)
+			ee_plan_prepared(plansource, paramLI, EE_PLAN_CUSTOM);
+
+		FreeExecutorState(estate);
+
+		/*
+		 * Штатное выполнение EXPLAIN EXECUTE. Сбор путей на это время
+		 * отключается, чтобы не записывать одно и то же планирование дважды.
+		 */
+		custom_plans_before = plansource->num_custom_plans;
+
+		global_ee_state = NULL;
+
+		if (prev_ProcessUtility_hook)
+			(*prev_ProcessUtility_hook) (pstmt, queryString, readOnlyTree,
+										 context, params, queryEnv,
+										 dest, qc);
+		else
+			standard_ProcessUtility(pstmt, queryString, readOnlyTree,
+									context, params, queryEnv,
+									dest, qc);
+
+		global_ee_state = ee_state;
+
+		ee_state->plancache_generic_cost = plansource->generic_cost;
+		ee_state->plancache_custom_plans = plansource->num_custom_plans;
+
+		if (plansource->num_custom_plans > 0)
+			ee_state->plancache_avg_custom_cost =
+				plansource->total_custom_cost / plansource->num_custom_plans;
+
+		if (plansource->num_custom_plans > custom_plans_before)
+			ee_state->plancache_choice = EE_PLAN_CUSTOM;
+		else
+			ee_state->plancache_choice = EE_PLAN_GENERIC;
+
+		ee_save_capture(queryString);
+	}
+	PG_CATCH();
+	{
+		/* На время исполнения EXPLAIN global_ee_state сбрасывается */
+		global_ee_state = ee_state;
+
+		ee_abort_capture(queryString);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	ee_end_capture();
+}
+
+/*
+ * Функция-обработчик хука ProcessUtility_hook
+ *
+ * Перехватывает только команду EXPLAIN (get_paths) EXECUTE.
+ */
+void
+ee_process_utility(PlannedStmt *pstmt, const char *queryString,
+				   bool readOnlyTree,
+				   ProcessUtilityContext context,
+				   ParamListInfo params,
+				   QueryEnvironment *queryEnv,
+				   DestReceiver *dest, QueryCompletion *qc)
+{
+	Node	   *parsetree = pstmt->utilityStmt;
+
+	if (global_ee_state == NULL &&
+		IsA(parsetree, ExplainStmt) &&
+		IsA(((ExplainStmt *) parsetree)->query, ExecuteStmt))
+	{
+		ExplainStmt *stmt = (ExplainStmt *) parsetree;
+		extended_explain_options options;
+
+		memset(&options, 0, sizeof(extended_explain_options));
+		get_explain_stmt_settings(stmt->options, &options);
+
+		if (options.get_paths)
+		{
+			ee_explain_execute((ExecuteStmt *) stmt->query, &options,
+							   pstmt, queryString, readOnlyTree, context,
+							   params, queryEnv, dest, qc);
+			return;
+		}
+	}
+
+	if (prev_ProcessUtility_hook)
+		(*prev_ProcessUtility_hook) (pstmt, queryString, readOnlyTree,
+									 context, params, queryEnv,
+									 dest, qc);
+	else
+		standard_ProcessUtility(pstmt, queryString, readOnlyTree,
+								context, params, queryEnv,
+								dest, qc);
+}
+
+/*
+ * Функция-обработчик хука planner_hook
+ *
+ * Перехватывает планирование, если для текущего процесса была вызвана
+ * функция ee.capture_backend(). Собранные пути, в том числе пути
+ * прерванного планирования, сразу записываются в журнал сборов.
+ */
+PlannedStmt *
+ee_planner(Query *parse, const char *query_string, int cursorOptions,
+		   ParamListInfo boundParams)
+{
+	PlannedStmt *result;
+
+	if (global_ee_state == NULL && ee_consume_capture_request())
+	{
+		MemoryContext planner_ctx = CurrentMemoryContext;
+		extended_explain_options options;
+
+		memset(&options, 0, sizeof(extended_explain_options));
+		options.get_paths = true;
+
+		/* Прерванное планирование -- именно то, что нужно диагностировать */
+		options.save_aborted = true;
+
+		ee_begin_capture(&options);
+
+		PG_TRY();
+		{
+			global_ee_state->queryid = (int64) parse->queryId;
+			global_ee_state->cursor_options = cursorOptions;
+
+			if (prev_planner_hook)
+				result = (*prev_planner_hook) (parse, query_string,
+											   cursorOptions, boundParams);
+			else
+				result = standard_planner(parse, query_string,
+										  cursorOptions, boundParams);
+
+			global_ee_state->planning_finished = true;
+
+			ee_mark_final_plan(result);
+		}
+		PG_CATCH();
+		{
+			ErrorData  *edata;
+
+			/*
+			 * Ошибка перехватывается, чтобы записать пути до ее передачи
+			 * дальше: ошибка записи в журнал не должна заменить исходную.
+			 */
+			MemoryContextSwitchTo(planner_ctx);
+			edata = CopyErrorData();
+			FlushErrorState();
+
+			global_ee_state->aborted = true;
+			global_ee_state->error_message = MemoryContextStrdup(ee_ctx,
+																 edata->message);
+
+			ee_log_backend_capture(query_string);
+			ee_end_capture();
+
+			ReThrowError(edata);
+		}
+		PG_END_TRY();
+
+		ee_log_backend_capture(query_string);
+		ee_end_capture();
+
+		return result;
+	}
+
+	if (global_ee_state != NULL)
+		global_ee_state->cursor_options = cursorOptions;
+
+	if (prev_planner_hook)
+		result = (*prev_planner_hook) (parse, query_string, cursorOptions,
+									   boundParams);
+	else
+		result = standard_planner(parse, query_string, cursorOptions,
+								  boundParams);
+
+	/* Планирование завершено, дальнейшая ошибка относится к исполнению */
+	if (global_ee_state != NULL)
+	{
+		global_ee_state->planning_finished = true;
+
+		/*
+		 * Узлы плана выводятся раньше вызова explain_per_plan_hook, поэтому
+		 * для параметра alternatives пути плана отмечаются сразу.
+		 */
+		if (global_ee_state->options.alternatives)
+			ee_mark_final_plan(result);
+	}
+
+	return result;
+}
+
+/*
+ * Запись путей, собранных по запросу ee.capture_backend(), в журнал сборов.
+ *
+ * Пути записываются в файл сразу и вне транзакций процесса: процесс не
+ * вставляет строки в таблицы расширения от имени роли приложения, а сборы
+ * не теряются при завершении сеанса и в сеансах, выполняющих только
+ * читающие транзакции. Ошибка записи не должна прерывать запрос
+ * приложения, поэтому она сообщается только в журнал сервера.
+ */
+static void
+ee_log_backend_capture(const char *query_string)
+{
+	MemoryContext fn_ctx = CurrentMemoryContext;
+
+	PG_TRY();
+	{
+		ee_log_write_capture(query_string ? query_string : "",
+							 global_ee_state);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(fn_ctx);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		ereport(LOG,
+				(errmsg("could not write paths captured by ee.capture_backend"),
+				 errdetail("%s", edata->message)));
+
+		FreeErrorData(edata);
+	}
+	PG_END_TRY();
+}
+
+/*
+ * Функция-обработчик событий транзакции
+ *
+ * При фиксации транзакции записывает пути прерванных сборов EXPLAIN
+ * (get_paths, save_aborted). Если запись невозможна (транзакция только для
+ * чтения, реплика), пути остаются в очереди до следующей фиксации.
+ */
+void
+ee_xact_callback(XactEvent event, void *arg)
+{
+	if (event != XACT_EVENT_PRE_COMMIT || ee_capture_queue == NIL)
+		return;
+
+	if (IsInParallelMode() || RecoveryInProgress() || XactReadOnly)
+		return;
+
+	ee_flush_capture_queue();
+}
+
+/*
+ * Запись статистики уровней перебора соединений от search->level до
+ * last_level.
+ *
+ * Время с начала построения текущего уровня (без оверхеда расширения)
+ * относится к уровню search->level. Следующие уровни, на которых не
+ * проверялось ни одного пути соединения, записываются с нулевым временем.
  */
+static void
+record_join_levels(EEJoinSearch *search, int last_level)
+{
+	MemoryContext old_ctx;
+	instr_time	now;
+	int			lev;
+
+	INSTR_TIME_SET_CURRENT(now);
+
+	old_ctx = MemoryContextSwitchTo(ee_ctx);
+
+	for (lev = search->level; lev <= last_level; lev++)
+	{
+		EEJoinLevel *join_level;
+
+		join_level = (EEJoinLevel *) palloc0(sizeof(EEJoinLevel));
+		join_level->level = lev;
+		join_level->nrels = list_length(search->join_rel_level[lev]);
+		join_level->planner_mem = ee_planner_mem();
+
+		if (lev == search->level)
+		{
+			join_level->time = now;
+			INSTR_TIME_SUBTRACT(join_level->time, search->start);
+			INSTR_TIME_SUBTRACT(join_level->time, global_ee_state->ee_time);
+			INSTR_TIME_ADD(join_level->time, search->ee_time);
+		}
+
+		global_ee_state->current_eesubquery->join_levels =
+			lappend(global_ee_state->current_eesubquery->join_levels, join_level);
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+
+	search->start = now;
+	search->ee_time = global_ee_state->ee_time;
+}
+
+/*
+ * Учет перехода перебора соединений к следующему уровню.
+ *
+ * Вызывается при проверке пути соединения (join_path_precheck_hook).
+ * join_search_one_level устанавливает root->join_cur_level в начале
+ * построения уровня, поэтому первый путь соединения нового уровня
+ * завершает предыдущие.
+ */
+static void
+track_join_level(PlannerInfo *root)
+{
+	EEJoinSearch *search = &global_ee_state->join_search;
+
+	/* GEQO и перебор других запросов не измеряются */
+	if (root != search->root || root->join_rel_level == NULL ||
+		root->join_cur_level <= search->level)
+		return;
+
+	search->join_rel_level = root->join_rel_level;
+
+	/* Уровень 2 строится с начала перебора */
+	if (search->level == 0)
+		search->level = 2;
+
+	if (root->join_cur_level > search->level)
+		record_join_levels(search, root->join_cur_level - 1);
+
+	search->level = root->join_cur_level;
+}
+
+/*
+ * Перебор соединений так же, как это делает make_rel_from_joinlist
+ */
+static RelOptInfo *
+call_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	if (prev_join_search_hook)
+		return (*prev_join_search_hook) (root, levels_needed, initial_rels);
+
+	if (enable_geqo && levels_needed >= geqo_threshold)
+		return geqo(root, levels_needed, initial_rels);
+
+	return standard_join_search(root, levels_needed, initial_rels);
+}
+
+/*
+ * Функция-обработчик хука join_search_hook
+ *
+ * Соединения перебирает standard_join_search (GEQO или предыдущий хук).
+ * Во время сбора путей для каждого уровня перебора измеряется время
+ * построения (без оверхеда расширения) и количество построенных отношений
+ * соединения. Границы уровней определяет track_join_level.
+ */
+RelOptInfo *
+ee_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	EEJoinSearch prev_search;
+	EEJoinSearch *search;
+	RelOptInfo *rel;
+
+	if (global_ee_state == NULL)
+		return call_join_search(root, levels_needed, initial_rels);
+
+	search = &global_ee_state->join_search;
+	prev_search = *search;
+
+	memset(search, 0, sizeof(EEJoinSearch));
+	search->root = root;
+	INSTR_TIME_SET_CURRENT(search->start);
+	search->ee_time = global_ee_state->ee_time;
+
+	rel = call_join_search(root, levels_needed, initial_rels);
+
+	/*
+	 * standard_join_search обнуляет root->join_rel_level, но сам массив
+	 * остается доступен через search->join_rel_level.
+	 */
+	if (search->level > 0)
+		record_join_levels(search, levels_needed);
+
+	*search = prev_search;
+
+	return rel;
+}
+
+/*
+ * Функция для обработки хука set_rel_pathlist_hook
+ *
+ * Вызывается при окончании заполнения списка путей базового отношения,
+ * необходима для получения названия отношения (например таблица или результат соединения).
+ *
+ * Во время сохранения путей название отношения не получить, поскольку из функции add_path()
+ * невозможно выудить RangeTblEntry.
+ */
+void
+ee_remember_rel_pathlist(PlannerInfo *root,
+						 RelOptInfo *rel,
+						 Index rti,
+						 RangeTblEntry *rte)
+{
+	MemoryContext old_ctx;
+	EERel	   *eerel;
+	instr_time	start;
+	instr_time	duration;
+
+	if (global_ee_state != NULL)
+	{
+		INSTR_TIME_SET_CURRENT(start);
+
+		old_ctx = MemoryContextSwitchTo(ee_ctx);
+
+		if (global_ee_state->cached_current_rel == rel)
+			eerel = global_ee_state->cached_current_eerel; 
+		else
+			eerel = search_eerel(rel);
+
+		eerel->name = get_rel_name(rte->relid);
+
+		if (rte->alias != NULL)
+			eerel->alias = pstrdup(rte->alias->aliasname);
+
+		MemoryContextSwitchTo(old_ctx);
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+		INSTR_TIME_ADD(global_ee_state->ee_time, duration);
+	}
+
+	/* Pass call to previous hook. */
+	if (prev_set_rel_pathlist_hook)
+		(*prev_set_rel_pathlist_hook) (root, rel, rti, rte);
+}
+
+/*
+ * Функция для обработки хука create_upper_paths_hook
+ */
+void
+ee_process_upper_paths(PlannerInfo *root,
+					   UpperRelationKind stage,
+					   RelOptInfo *input_rel,
+					   RelOptInfo *output_rel,
+					   void *extra)
+{
+
+	if (global_ee_state != NULL)
+	{
+		EERel	   *eerel = search_eerel(output_rel);
+
+		/* Пути верхнего отношения к этому моменту уже добавлены */
+		if (eerel != NULL)
+		{
+			eerel->is_upper = true;
+			eerel->upper_stage = stage;
+		}
+	}
+
+	if (global_ee_state != NULL && stage == UPPERREL_FINAL)
+	{
+		/* Указываем query_level для текущего eesubquery */
+		global_ee_state->current_eesubquery->subquery_level = root->query_level;
+
+		/* Память, затраченная планировщиком к окончанию планирования подзапроса */
+		global_ee_state->current_eesubquery->planner_mem = ee_planner_mem();
+
+		/* Путь итогового отношения, вошедший в план, определяется позже */
+		global_ee_state->current_eesubquery->final_rel = output_rel;
+		global_ee_state->current_eesubquery->root = root;
+
+		/* Граф соединений подзапроса */
+		ee_record_join_graph(global_ee_state,
+							 global_ee_state->current_eesubquery, root);
+
+		finish_partition_groups(global_ee_state->current_eesubquery);
+
+		/* Инициализируем следующий eesubquery */
+		init_eesubquery();
+	}
+
+	/* Pass call to previous hook. */
+	if (prev_create_upper_paths_hook)
+		(*prev_create_upper_paths_hook) (root, stage, input_rel, output_rel, extra);
+}
+
+/*
+ * Функция-обработчик хука explain_per_plan_hook
+ */
+void
+ee_explain_per_plan_hook(PlannedStmt *plannedstmt,
+						 IntoClause *into,
+						 ExplainState *es,
+						 const char *queryString,
+						 ParamListInfo params,
+						 QueryEnvironment *queryEnv)
+{
+	if (prev_explain_per_plan_hook)
+		(*prev_explain_per_plan_hook) (plannedstmt, into, es, queryString,
+									   params, queryEnv);
+
+	if (global_ee_state)
+	{
+		double plantime;
+
+		INSTR_TIME_SET_CURRENT(global_ee_state->planning_time);
+		INSTR_TIME_SUBTRACT(global_ee_state->planning_time, global_ee_state->start_time);
+		INSTR_TIME_SUBTRACT(global_ee_state->planning_time, global_ee_state->ee_time);
+
+		plantime = INSTR_TIME_GET_DOUBLE(global_ee_state->planning_time);
+
+		ee_mark_final_plan(plannedstmt);
+
+		ExplainOpenGroup("Extended explain", "Extended explain", false, es);
+
+		ExplainPropertyFloat("Planning time without overhead", "ms", 1000.0 * plantime, 3, es);
+
+		/* Как и Planning Memory, память выводится только с параметром SUMMARY */
+		if (es->summary)
+		{
+			ExplainPropertyInteger("Planner memory peak", "kB",
+								   (int64) (global_ee_state->planner_mem_peak / 1024), es);
+			ExplainPropertyInteger("Capture memory", "kB",
+								   (int64) (MemoryContextMemAllocated(ee_ctx, true) / 1024), es);
+		}
+
+		ExplainCloseGroup("Extended explain", "Extended explain", false, es);
+	}
+}
+
+#if (PG_VERSION_NUM >= 180000)
+/*
+ * Функция-обработчик хука explain_per_node_hook
+ *
+ * С параметром alternatives дополняет узел плана сведениями о путях его
+ * отношения.
+ */
+void
+ee_explain_per_node_hook(PlanState *planstate, List *ancestors,
+						 const char *relationship, const char *plan_name,
+						 ExplainState *es)
+{
+	if (prev_explain_per_node_hook)
+		(*prev_explain_per_node_hook) (planstate, ancestors, relationship,
+									   plan_name, es);
+
+	if (global_ee_state != NULL && global_ee_state->options.alternatives)
+		ee_explain_alternatives(global_ee_state, planstate->plan, es);
+}
+#endif
+
+/* ----------------------------------------------------------------
+ *				Функции для работы с eepath
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * Функция создания eepath пути
+ */
+EEPath *
+create_eepath(Path *path, EERel *eerel)
+{
+	EEPathHashEntry *entry;
+	EEPathHashKey 	key;
+	bool			found;
+
+	EEPath	   		*eepath = (EEPath *) palloc0(sizeof(EEPath));
+
+	ListCell   		*lc;
+
+	eepath->id = global_ee_state->eepath_counter++;
+
+	eepath->fingerprint = get_path_fingerprint(global_ee_state, path);
+
+	/*
+	 * На одном уровне может быть зафиксировано несколько путей (например,
+	 * сканирования разных базовых отношений одного плана), поэтому путь
+	 * отключается, только если он не совпадает ни с одним из них. Уровни
+	 * нумеруются в каждом подзапросе заново, поэтому при заданном
+	 * ee.fixate_subquery пути остальных подзапросов не трогаются.
+	 */
+	if (fixated_paths != NULL && global_ee_state->options.fixate_paths &&
+		(fixate_subquery == 0 ||
+		 global_ee_state->current_eesubquery->id == fixate_subquery))
+	{
+		int64		level = eerel->joined_rel_num;
+
+		if (hash_search(fixated_levels, &level, HASH_FIND, NULL) != NULL &&
+			!path_is_fixated(path, level, eepath->fingerprint))
+		{
+			path->disabled_nodes++;
+			path->pathkeys = NULL;
+
+			/*
+			 * ParamPathInfo разделяется путями отношения с той же
+			 * параметризацией, поэтому изменяется его копия: иначе
+			 * зафиксированный путь, созданный позже, потерял бы
+			 * параметризацию и вместе с ней совпадение отпечатка.
+			 */
+			if (path->param_info)
+			{
+				ParamPathInfo *ppi;
+
+				ppi = (ParamPathInfo *) MemoryContextAlloc(GetMemoryChunkContext(path),
+														   sizeof(ParamPathInfo));
+				memcpy(ppi, path->param_info, sizeof(ParamPathInfo));
+				ppi->ppi_req_outer = NULL;
+				path->param_info = ppi;
+			}
+
+			path->rows = DBL_MAX;	
+			path->parallel_safe = false;
+		}
+	}
+
+	eepath->path_pointer = path;
+	eepath->pathtype = path->pathtype;
+
+	eepath->nsub = 0;
+	eepath->sub_eepaths = NULL;
+
+	eepath->rows = path->rows;
+	eepath->startup_cost = path->startup_cost;
+	eepath->total_cost = path->total_cost;
+	eepath->disabled_nodes = path->disabled_nodes;
+
+	eepath->parallel_aware = path->parallel_aware;
+	eepath->parallel_workers = path->parallel_workers;
+
+	eepath->plan_depth = -1;
+
+	eepath->pathkeys = ee_intern_pathkeys(global_ee_state, path->pathkeys);
+	eepath->required_outer = ee_intern_relids(global_ee_state, PATH_REQ_OUTER(path));
+	
+	eepath->add_path_result = APR_SAVED;
+
+	if (path->type == T_IndexPath)
+		eepath->indexoid = ((IndexPath *) path)->indexinfo->indexoid;
+	else
+		eepath->indexoid = 0;
+
+	eepath->num_groups = -1;
+
+	if (IsA(path, AggPath))
+	{
+		eepath->aggstrategy = ((AggPath *) path)->aggstrategy;
+		eepath->num_groups = ((AggPath *) path)->numGroups;
+	}
+	else if (IsA(path, GroupingSetsPath))
+	{
+		eepath->aggstrategy = ((GroupingSetsPath *) path)->aggstrategy;
+		eepath->num_groups = 0;
+
+		foreach(lc, ((GroupingSetsPath *) path)->rollups)
+			eepath->num_groups += ((RollupData *) lfirst(lc))->numGroups;
+	}
+
+	eerel->eepath_list = lappend(eerel->eepath_list, eepath);
+
+    key.path_ptr = path;
+    entry = (EEPathHashEntry *) hash_search(global_ee_state->eepath_by_path,
+										   &key,
+        								   HASH_ENTER,
+        								   &found);
+
+	/*
+	 * Тот же Path уже записан: новая запись присоединяется к кольцу его
+	 * записей. Если же прежний путь был освобожден, память переиспользована
+	 * другим путем, и прежние записи к нему не относятся.
+	 */
+	if (found && !eepath_path_freed(entry->eepath))
+	{
+		EEPath	   *prev = entry->eepath;
+
+		eepath->same_path = prev->same_path != NULL ? prev->same_path : prev;
+		prev->same_path = eepath;
+	}
+
+	entry->eepath = eepath;
+	return eepath;
+}
+
+/*
+ * Был ли исходный путь записи eepath освобожден: add_path освобождает
+ * вытесненные и отвергнутые пути, кроме IndexPath, add_partial_path --
+ * все такие пути.
+ */
+static bool
+eepath_path_freed(EEPath *eepath)
+{
+	EEPath	   *same = eepath;
+
+	do
+	{
+		if (same->add_path_result != APR_SAVED &&
+			(same->partial ||
+			 (same->pathtype != T_IndexScan && same->pathtype != T_IndexOnlyScan)))
+			return true;
+
+		same = same->same_path;
+	} while (same != NULL && same != eepath);
+
+	return false;
+}
+
+/*
+ * Функция поиска пути eepath, соответствующего исходному пути path.
+ * Если Path записан несколько раз, возвращается последняя запись.
+ *
+ * Если функция не нашла путь (или путь по этому адресу был освобожден),
+ * то она вернет NULL.
+ */
+EEPath *
+search_eepath(Path *path)
+{
+	EEPathHashEntry *entry;
+	EEPathHashKey 	key;
+
+    key.path_ptr = path;
+
+	entry = (EEPathHashEntry *) hash_search(global_ee_state->eepath_by_path,
+										   &key,
+										   HASH_FIND,
+										   NULL);
+	
+	if (entry && !eepath_path_freed(entry->eepath))
+		return entry->eepath;
+	else
+		return NULL;
+}
+
+/*
+ * Запись пути path в отношении eerel. Нужна при вытеснении пути: тот же
+ * Path может быть записан и в других отношениях.
+ */
+static EEPath *
+search_rel_eepath(Path *path, EERel *eerel)
+{
+	EEPath	   *eepath = search_eepath(path);
+	EEPath	   *same = eepath;
+
+	if (eepath == NULL || eepath->same_path == NULL)
+		return eepath;
+
+	for (;;)
+	{
+		if (list_member_ptr(eerel->eepath_list, same))
+			return same;
+
+		same = same->same_path;
+
+		if (same == eepath)
+			break;
+	}
+
+	return eepath;
+}
+
+/*
+ * Отметка путей, вошедших в итоговый план.
+ *
+ * Путь итогового отношения запроса верхнего уровня выбирается так же, как
+ * в standard_planner (get_cheapest_fractional_path), пути подпланов берутся
+ * из glob->subpaths. Стоимость узла плана используется, только если
+ * выбранный путь не записан. Пути подзапросов в FROM отмечаются при обходе
+ * плана внешнего запроса (SubqueryScanPath).
+ *
+ * Вызывается сразу после планирования, пока RelOptInfo и пути
+ * планировщика еще существуют.
+ */
+static void
+ee_mark_final_plan(PlannedStmt *plannedstmt)
+{
+	EESubQuery *top_eesubquery = NULL;
+	ListCell   *lc1;
+
+	/* Запрос верхнего уровня планируется последним */
+	foreach(lc1, global_ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(lc1);
+
+		if (eesubquery->final_rel != NULL && !eesubquery->final_marked &&
+			eesubquery->subquery_level == 1)
+			top_eesubquery = eesubquery;
+	}
+
+	if (top_eesubquery != NULL)
+		mark_final_eepath(search_final_eepath(top_eesubquery->final_rel,
+											  top_final_path(top_eesubquery->final_rel,
+															 global_ee_state->cursor_options),
+											  plannedstmt->planTree, true), 0);
+
+	foreach(lc1, global_ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(lc1);
+		PlannerGlobal *glob;
+		ListCell   *lc2;
+		ListCell   *lc3;
+		ListCell   *lc4;
+
+		if (eesubquery->final_rel == NULL || eesubquery->final_marked)
+			continue;
+
+		eesubquery->final_marked = true;
+
+		if (eesubquery == top_eesubquery)
+			continue;
+
+		/*
+		 * Подплан подзапроса (SubLink, CTE) и путь, по которому он построен,
+		 * находятся на той же позиции в списках glob->subroots и
+		 * glob->subpaths, что и сам подплан в plannedstmt->subplans.
+		 * Подзапросы в FROM подпланов не имеют: их пути отмечаются как
+		 * дочерние пути SubqueryScan.
+		 */
+		glob = eesubquery->root->glob;
+
+		forthree(lc2, glob->subroots, lc3, glob->subpaths,
+				 lc4, plannedstmt->subplans)
+		{
+			Plan	   *subplan = (Plan *) lfirst(lc4);
+
+			if ((PlannerInfo *) lfirst(lc2) != eesubquery->root)
+				continue;
+
+			/* Неиспользуемые подпланы заменяются на NULL */
+			if (subplan != NULL)
+				mark_final_eepath(search_final_eepath(eesubquery->final_rel,
+													  (Path *) lfirst(lc3),
+													  subplan, false), 0);
+			break;
+		}
+	}
+}
+
+/*
+ * Путь итогового отношения запроса верхнего уровня, по которому строится
+ * план. Выбирается так же, как в standard_planner.
+ */
+static Path *
+top_final_path(RelOptInfo *final_rel, int cursor_options)
+{
+	double		tuple_fraction;
+
+	if (final_rel->pathlist == NIL)
+		return NULL;
+
+	if (cursor_options & CURSOR_OPT_FAST_PLAN)
+	{
+		tuple_fraction = cursor_tuple_fraction;
+
+		if (tuple_fraction >= 1.0)
+			tuple_fraction = 0.0;
+		else if (tuple_fraction <= 0.0)
+			tuple_fraction = 1e-10;
+	}
+	else
+		tuple_fraction = 0.0;
+
+	return get_cheapest_fractional_path(final_rel, tuple_fraction);
+}
+
+/*
+ * Поиск eepath пути итогового отношения, по которому построен план plan.
+ *
+ * Путь определяется по указателю path на выбранный планировщиком Path.
+ * Если такой путь не записан (например, план построил другой
+ * planner_hook), путь ищется по стоимости узла plan, а если и такого нет и
+ * задан use_cheapest, возвращается наиболее дешевый путь отношения.
+ */
+static EEPath *
+search_final_eepath(RelOptInfo *final_rel, Path *path, Plan *plan,
+					bool use_cheapest)
+{
+	EEPath	   *eepath;
+	ListCell   *lc;
+
+	if (path != NULL && (eepath = search_eepath(path)) != NULL)
+		return eepath;
+
+	if (plan == NULL)
+		return NULL;
+
+	foreach(lc, final_rel->pathlist)
+	{
+		Path	   *final_path = (Path *) lfirst(lc);
+
+		if (final_path->startup_cost == plan->startup_cost &&
+			final_path->total_cost == plan->total_cost)
+			return search_eepath(final_path);
+	}
+
+	if (use_cheapest && final_rel->cheapest_total_path != NULL)
+		return search_eepath(final_rel->cheapest_total_path);
+
+	return NULL;
+}
+
+/*
+ * Отметка пути и всех его дочерних путей как вошедших в план. Отмечаются
+ * все записи того же Path (кольцо same_path), в каких бы отношениях он ни
+ * был записан.
+ */
+static void
+mark_final_eepath(EEPath *eepath, int depth)
+{
+	EEPath	   *same = eepath;
+	int			i;
+
+	if (eepath == NULL || eepath->in_final_plan)
+		return;
+
+	do
+	{
+		same->in_final_plan = true;
+		same->plan_depth = depth;
+		same = same->same_path;
+	} while (same != NULL && same != eepath);
+
+	same = eepath;
+	do
+	{
+		for (i = 0; i < same->nsub; i++)
+			mark_final_eepath(same->sub_eepaths[i], depth + 1);
+
+		same = same->same_path;
+	} while (same != NULL && same != eepath);
+}
+
+/*
+ * record_eepath -- функция сохранения пути Path в путь EEPath
+ *
+ * Для создания необходим исходный путь из планировщика и EERel -- отношение со списком eepath путей.
+ * partial -- путь исполняется в параллельных процессах (частичный путь).
+ */
+EEPath *
+record_eepath(EERel * eerel, Path *new_path, bool partial)
+{
+	EEPath	   *eepath;
+	bool		partial_subpaths;
+
+	/*
+	 * Инициализируем и заполняем eepath характеристиками пути
+	 * new_path
+	 */
+	eepath = create_eepath(new_path, eerel);
+	eepath->partial = partial;
+
+	/*
+	 * Дочерние пути частичного пути, а также Gather и GatherMerge, являются
+	 * частичными.
+	 */
+	partial_subpaths = partial ||
+		new_path->pathtype == T_Gather ||
+		new_path->pathtype == T_GatherMerge;
+
+	/*
+	 * Получаем количество возможных дочерних путей
+	 */
+	eepath->nsub = get_subpath_num(new_path);
+
+	/*
+	 * Связываем eepath с дочерними путями, если они есть
+	 */
+	if (eepath->nsub > 0)
+	{
+		int			nsub = 0;
+		int			i;
+
+		eepath->sub_eepaths = (EEPath **) palloc(sizeof(EEPath *) * eepath->nsub);
+
+		for (i = 0; i < eepath->nsub; i++)
+		{
+			Path	   *sub_path = get_subpath(new_path, i);
+			EEPath	   *sub_eepath;
+
+			/*
+			 * Секции, не являющиеся представителями своей группы, в режиме
+			 * collapse_partitions не записываются.
+			 */
+			if (is_collapsed_partition(sub_path->parent))
+				continue;
+
+			sub_eepath = search_eepath(sub_path);
+
+			/*
+			 * Если мы не находим дочерний узел в списке, 
+			 * значит он не был обработан функцией add_path, 
+			 * а значит и хуком ee_add_path_hook.  
+			 * 
+			 * В таком случае создаем дочерний путь отдельно.
+			 */
+			if (sub_eepath == NULL)
+				sub_eepath = record_eepath(get_sub_eerel(sub_path->parent), sub_path,
+										   partial_subpaths);
+
+			eepath->sub_eepaths[nsub++] = sub_eepath;
+		}
+
+		eepath->nsub = nsub;
+	}
+
+	return eepath;
+}
+
+/*
+ * Поиск eerel отношения, в которое добавляется путь.
+ *
+ * Последнее найденное отношение кэшируется, поскольку пути одного отношения,
+ * как правило, добавляются подряд.
+ */
+static EERel *
+get_current_eerel(RelOptInfo *parent_rel)
+{
+	EERel	   *eerel;
+
+	if (global_ee_state->cached_current_rel == parent_rel)
+	{
+		/*
+		* Нужное EERel отношение сохранилось в кэше.
+		*/
+		return global_ee_state->cached_current_eerel;
+	}
+
+	/*
+	* Нужного EERel отношения не оказалось в кэше, значит ищем его 
+	* в списке отношений текущего подзапроса.
+	*/
+	eerel = search_eerel(parent_rel);
+	if (eerel == NULL)
+	{
+		/*
+		* Если отношение не было найдено, его необходимо создать 
+		*/
+		eerel = create_eerel(parent_rel);
+	}
+
+	/* Обновляем кэш */
+	global_ee_state->cached_current_rel = parent_rel;
+	global_ee_state->cached_current_eerel = eerel;
+
+	return eerel;
+}
+
+/*
+ * Поиск eerel отношения дочернего пути.
+ *
+ * Отношение может отсутствовать, если add_path для него не вызывался
+ * (например, секция, пути которой не записывались в режиме
+ * collapse_partitions). В таком случае отношение создается.
+ */
+static EERel *
+get_sub_eerel(RelOptInfo *roi)
+{
+	EERel	   *eerel = search_eerel(roi);
+
+	if (eerel == NULL)
+		eerel = create_eerel(roi);
+
+	return eerel;
+}
+
+/*
+ * Учет вызова add_path_precheck/add_partial_path_precheck для пути
+ * соединения.
+ *
+ * Если найден доминирующий путь (dominating_path), проверяемый путь будет
+ * отброшен и записывается как EEPrecheckedPath.
+ */
+static void
+record_prechecked_path(RelOptInfo *joinrel, NodeTag pathtype,
+					   JoinType jointype, Path *outer_path, Path *inner_path,
+					   JoinCostWorkspace *workspace,
+					   List *pathkeys, bool parameterized,
+					   bool partial, Path *dominating_path)
+{
+	MemoryContext old_ctx;
+	EERel	   *eerel;
+	EEPrecheckedPath *prechecked;
+
+	old_ctx = MemoryContextSwitchTo(ee_ctx);
+
+	eerel = get_sub_eerel(joinrel);
+	eerel->precheck_calls++;
+
+	if (dominating_path != NULL)
+	{
+		prechecked = (EEPrecheckedPath *) palloc(sizeof(EEPrecheckedPath));
+		prechecked->pathtype = pathtype;
+		prechecked->jointype = jointype;
+		prechecked->startup_cost = partial ? -1 : workspace->startup_cost;
+		prechecked->total_cost = workspace->total_cost;
+		prechecked->disabled_nodes = workspace->disabled_nodes;
+		prechecked->npathkeys = list_length(pathkeys);
+		prechecked->parameterized = parameterized;
+		prechecked->partial = partial;
+		prechecked->outer_rel = get_sub_eerel(outer_path->parent);
+		prechecked->inner_rel = get_sub_eerel(inner_path->parent);
+		prechecked->dominated_by = search_eepath(dominating_path);
+
+		eerel->prechecked_paths = lappend(eerel->prechecked_paths, prechecked);
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+}
 
 /*
- * Функция создания eepath пути
+ * Является ли отношение секцией, пути которой не записываются
+ * (режим collapse_partitions).
  */
-EEPath *
-create_eepath(Path *path, EERel *eerel)
+static bool
+is_collapsed_partition(RelOptInfo *roi)
 {
-	EEPathHashEntry *entry;
-	EEPathHashKey 	key;
+	EECollapsedRel *child;
+	EEPartitionGroup *group;
 
-	EEPath	   		*eepath = (EEPath *) palloc0(sizeof(EEPath));
-
-	ListCell   		*lc;
+	if (!global_ee_state->options.collapse_partitions ||
+		!is_partition_child(roi))
+		return false;
 
-	Path 			*sub_path;
-	EEPath 			*sub_eepath;
-	EERel			*sub_eerel;
+	child = (EECollapsedRel *) hash_search(global_ee_state->collapsed_by_roi,
+										   (void *) &roi,
+										   HASH_FIND,
+										   NULL);
 
-	bool 			skip_disable;
+	if (child != NULL)
+		return !child->representative;
 
-	eepath->id = global_ee_state->eepath_counter++;
+	/*
+	 * Секция еще не встречалась в add_path (например, при вызове
+	 * add_path_precheck). Она станет представителем, только если у ее группы
+	 * представителя еще нет.
+	 */
+	group = search_partition_group(roi->parent);
 
-	if (my_guc_list != NIL && global_ee_state->options.fixate_paths)
-	{
-		foreach(lc, my_guc_list)
-		{
-			RelPathIdPair *pair = (RelPathIdPair *) lfirst(lc);
+	return group != NULL && group->representative != NULL;
+}
 
-			skip_disable = false;
-			/* Объединить по join rel num*/
-			if (get_subpath_num(path) == 1 && eerel->joined_rel_num == pair->level_id)
-			{
-				sub_path = GET_SUB_PATH(path);
-				while (bms_num_members(sub_path->parent->relids) == pair->level_id)
-				{
-					sub_eepath = search_eepath(sub_path);
-					if (sub_eepath == NULL)
-					{
-						sub_eerel = search_eerel(sub_path->parent);
-						sub_eepath = record_eepath(sub_eerel, sub_path);
-					}
+/*
+ * Объем памяти, выделенной планировщиком с начала сбора путей.
+ *
+ * Учитывается память контекста, в котором был начат сбор, вместе с
+ * дочерними контекстами (в том числе контекстами GEQO и EXPLAIN (MEMORY)).
+ * Заодно обновляет наибольшее измеренное значение.
+ */
+static Size
+ee_planner_mem(void)
+{
+	Size		allocated;
+	Size		mem = 0;
 
-					if ((int64) floor(100.0 * path->startup_cost + 0.5) == pair->startup_cost && 
-						(int64) floor(100.0 * path->total_cost + 0.5) == pair->total_cost)
-					{
-						skip_disable = true;
-						break;
-					}
-					
-					if (get_subpath_num(sub_path) != 1)
-						break;
-					
-					sub_path = GET_SUB_PATH(sub_path);
-				}
-			}
-		
-			if (((int64) floor(100.0 * path->startup_cost + 0.5) != pair->startup_cost || 
-				(int64) floor(100.0 * path->total_cost + 0.5) != pair->total_cost) &&
-				eerel->joined_rel_num == pair->level_id &&
-				!skip_disable)
-			{
-				path->disabled_nodes++;
-				path->pathkeys = NULL;
+	allocated = MemoryContextMemAllocated(global_ee_state->planner_mem_ctx, true);
 
-				if (path->param_info)
-					path->param_info->ppi_req_outer = NULL;
+	if (allocated > global_ee_state->planner_mem_base)
+		mem = allocated - global_ee_state->planner_mem_base;
 
-				path->rows = DBL_MAX;	
-				path->parallel_safe = false;
-			}
-		}		
-	}
+	if (mem > global_ee_state->planner_mem_peak)
+		global_ee_state->planner_mem_peak = mem;
 
-	eepath->path_pointer = path;
-	eepath->pathtype = path->pathtype;
+	return mem;
+}
 
-	eepath->sub_eepath_1 = NULL;
-	eepath->sub_eepath_2 = NULL;
+/*
+ * Является ли отношение секцией (дочерним отношением секционированного
+ * отношения или соединения секционированных отношений). Дочерние отношения
+ * наследования и UNION ALL различаются между собой и секциями не считаются.
+ */
+static bool
+is_partition_child(RelOptInfo *rel)
+{
+	return (rel->reloptkind == RELOPT_OTHER_MEMBER_REL ||
+			rel->reloptkind == RELOPT_OTHER_JOINREL) &&
+		rel->parent != NULL &&
+		rel->parent->part_scheme != NULL;
+}
 
-	eepath->rows = path->rows;
-	eepath->startup_cost = path->startup_cost;
-	eepath->total_cost = path->total_cost;
-	eepath->disabled_nodes = path->disabled_nodes;
-	
-	eepath->add_path_result = APR_SAVED;
+/*
+ * Поиск группы секций текущего подзапроса по секционированному отношению
+ */
+static EEPartitionGroup *
+search_partition_group(RelOptInfo *parent)
+{
+	ListCell   *lc;
 
-	if (path->type == T_IndexPath)
-		eepath->indexoid = ((IndexPath *) path)->indexinfo->indexoid;
-	else
-		eepath->indexoid = 0;
+	foreach(lc, global_ee_state->current_eesubquery->partition_groups)
+	{
+		EEPartitionGroup *group = (EEPartitionGroup *) lfirst(lc);
 
-	eerel->eepath_list = lappend(eerel->eepath_list, eepath);
+		if (group->parent_roi == parent)
+			return group;
+	}
 
-    key.path_ptr = path;
-	key.startup_cost = path->startup_cost;
-	key.total_cost = path->total_cost;
-    entry = (EEPathHashEntry *) hash_search(global_ee_state->eepath_by_path,
-										   &key,
-        								   HASH_ENTER,
-        								   NULL);
-	
-	entry->eepath = eepath;
-	return eepath;
+	return NULL;
 }
 
 /*
- * Функция поиска пути eepath, соответствующего исходному пути path.
- *
- * Если функция не нашла путь, то она вернет NULL.
+ * Подсчет отсеченных секций групп подзапроса eesubquery.
  *
- * TODO:
- *	Требуется более надежная идентификация путей.
+ * Для соединений секционированных отношений (partitionwise join) live_parts
+ * заполняется по мере построения соединений секций, поэтому количество
+ * отсеченных секций известно только по окончании планирования подзапроса.
  */
-EEPath *
-search_eepath(Path *path)
+static void
+finish_partition_groups(EESubQuery *eesubquery)
 {
-	EEPathHashEntry *entry;
-	EEPathHashKey 	key;
+	ListCell   *lc;
 
-    key.path_ptr = path;
-	key.startup_cost = path->startup_cost;
-	key.total_cost = path->total_cost;
+	foreach(lc, eesubquery->partition_groups)
+	{
+		EEPartitionGroup *group = (EEPartitionGroup *) lfirst(lc);
+		RelOptInfo *parent = group->parent_roi;
 
-	entry = (EEPathHashEntry *) hash_search(global_ee_state->eepath_by_path,
-										   &key,
-										   HASH_FIND,
-										   NULL);
-	
-	if (entry)
-		return entry->eepath;
-	else
-		return NULL;
+		if (parent->nparts > 0)
+			group->pruned = parent->nparts - bms_num_members(parent->live_parts);
+	}
 }
 
 /*
- * Функция получения количества возможных дочерних путей у указанного пути.
+ * Учет пути секции в режиме collapse_partitions.
+ *
+ * Дочерние отношения (RELOPT_OTHER_MEMBER_REL, RELOPT_OTHER_JOINREL) одного
+ * секционированного отношения объединяются в группу. Первое из них
+ * становится представителем группы, его пути записываются как обычно. Для
+ * остальных запоминается лишь наименьшая стоимость путей.
+ *
+ * Возвращает true, если путь new_path записывать не нужно.
  */
-int
-get_subpath_num(Path *path)
+static bool
+collapse_partition_child(RelOptInfo *rel, Path *new_path)
 {
-	int			subpath_num;
+	EECollapsedRel *child;
+	MemoryContext old_ctx;
+	instr_time	start;
+	instr_time	duration;
+	bool		found;
+
+	if (!is_partition_child(rel))
+		return false;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	old_ctx = MemoryContextSwitchTo(ee_ctx);
+
+	child = (EECollapsedRel *) hash_search(global_ee_state->collapsed_by_roi,
+										   (void *) &rel,
+										   HASH_ENTER,
+										   &found);
 
-	switch (nodeTag(path))
+	if (!found)
 	{
-		case T_IndexPath:
-		case T_Path:
-		case T_BitmapHeapPath:
-		case T_AppendPath: /* ????? */
-			/* Путь не имеет дочерних путей */
-			subpath_num = 0;
-			break;
-		case T_SubqueryScanPath:
-		case T_ProjectionPath:
-		case T_LimitPath:
-		case T_MaterialPath:
-		case T_AggPath:
-		case T_GatherPath:
-		case T_SortPath:
-		case T_GatherMergePath:
-		case T_UpperUniquePath:
-		case T_WindowAggPath:
-		case T_IncrementalSortPath:
-			/* Путь имеет один дочерний путь */
-			subpath_num = 1;
-			break;
-		case T_NestPath:
-		case T_MergePath:
-		case T_HashPath:
-			/* Путь имеет два дочерних пути */
-			subpath_num = 2;
-			break;
-		default:
-			Assert(false);
-			subpath_num = -1;
-			break;
+		EESubQuery *eesubquery = global_ee_state->current_eesubquery;
+		EEPartitionGroup *group = search_partition_group(rel->parent);
+
+		if (group == NULL)
+		{
+			RelOptInfo *parent = rel->parent;
+
+			group = (EEPartitionGroup *) palloc0(sizeof(EEPartitionGroup));
+			group->parent_roi = parent;
+			group->parent_eerel = get_sub_eerel(parent);
+
+			/* Вычисляется по окончании планирования подзапроса */
+			group->pruned = -1;
+
+			eesubquery->partition_groups = lappend(eesubquery->partition_groups, group);
+		}
+
+		child->group = group;
+		child->min_total_cost = new_path->total_cost;
+		child->representative = (group->representative == NULL);
+
+		if (child->representative)
+			group->representative = get_sub_eerel(rel);
+
+		group->children = lappend(group->children, child);
 	}
+	else if (new_path->total_cost < child->min_total_cost)
+		child->min_total_cost = new_path->total_cost;
+
+	MemoryContextSwitchTo(old_ctx);
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	INSTR_TIME_ADD(global_ee_state->ee_time, duration);
 
-	return subpath_num;
+	return !child->representative;
 }
 
 /*
- * record_eepath -- функция сохранения пути Path в путь EEPath
+ * Запись пары отношений, соединение которых рассматривается при построении
+ * отношения joinrel.
  *
- * Для создания необходим исходный путь из планировщика и EERel -- отношение со списком eepath путей
+ * Пара записывается при первой проверке пути ее соединения
+ * (add_path_precheck), поэтому учитываются и пары, все пути которых были
+ * отброшены еще до создания структуры Path (pruned).
  */
-EEPath *
-record_eepath(EERel * eerel, Path *new_path)
+static void
+record_join_pair(PlannerInfo *root, RelOptInfo *joinrel,
+				 RelOptInfo *outer_rel, RelOptInfo *inner_rel, bool accepted)
 {
-	EEPath	   *eepath;
+	MemoryContext old_ctx;
+	EERel	   *eerel;
+	EERel	   *outer_eerel;
+	EERel	   *inner_eerel;
+	EEJoinPair *pair;
+	ListCell   *lc;
 
-	/*
-	 * Инициализируем и заполняем eepath характеристиками пути
-	 * new_path
-	 */
-	eepath = create_eepath(new_path, eerel);
+	old_ctx = MemoryContextSwitchTo(ee_ctx);
 
-	/*
-	 * Получаем количество возможных дочерних путей
-	 */
-	eepath->nsub = get_subpath_num(new_path);
+	eerel = get_sub_eerel(joinrel);
+	outer_eerel = get_sub_eerel(outer_rel);
+	inner_eerel = get_sub_eerel(inner_rel);
 
-	/*
-	 * Связываем eepath с дочерними путями, если они есть
-	 */
-	if (eepath->nsub == 1)		/* Дочерний путь один */
+	if (outer_eerel->id > inner_eerel->id)
 	{
-		EERel *sub_eerel;
-
-		sub_eerel = search_eerel(GET_SUB_PATH(new_path)->parent);
+		EERel	   *tmp = outer_eerel;
 
-		/* Связываем eepath с дочерним путем */
-		eepath->sub_eepath_1 = search_eepath(GET_SUB_PATH(new_path));
-
-		/*
-		 * Если мы не находим дочерний узел в списке, 
-		 * значит он не был обработан функцией add_path, 
-		 * а значит и хуком ee_add_path_hook.  
-		 * 
-		 * В таком случае создаем дочерний путь отдельно.
-		 */
-		if (eepath->sub_eepath_1 == NULL)
-			eepath->sub_eepath_1 = record_eepath(sub_eerel, GET_SUB_PATH(new_path));
+		outer_eerel = inner_eerel;
+		inner_eerel = tmp;
 	}
-	else if (eepath->nsub == 2)	/* Два дочерних пути */
+
+	foreach(lc, eerel->join_pairs)
 	{
-		EERel *outer_eerel;
-		EERel *inner_eerel;
+		pair = (EEJoinPair *) lfirst(lc);
 
-		outer_eerel = search_eerel(GET_OUTER_PATH(new_path)->parent);
+		if (pair->rel1 == outer_eerel && pair->rel2 == inner_eerel)
+		{
+			if (accepted)
+				pair->pruned = false;
 
-		inner_eerel = search_eerel(GET_INNER_PATH(new_path)->parent);
+			MemoryContextSwitchTo(old_ctx);
+			return;
+		}
+	}
 
-		/* 
-		 *Связываем eepath с дочернии путями 
-		 */
-		eepath->sub_eepath_1 = search_eepath(GET_OUTER_PATH(new_path));
-		if (eepath->sub_eepath_1 == NULL)
-			eepath->sub_eepath_1 = record_eepath(outer_eerel, GET_OUTER_PATH(new_path));
+	pair = (EEJoinPair *) palloc0(sizeof(EEJoinPair));
+	pair->rel1 = outer_eerel;
+	pair->rel2 = inner_eerel;
+	pair->cartesian = !have_relevant_joinclause(root, outer_rel, inner_rel);
+	pair->pruned = !accepted;
 
-		eepath->sub_eepath_2 = search_eepath(GET_INNER_PATH(new_path));
-		if (eepath->sub_eepath_2 == NULL)
-			eepath->sub_eepath_2 = record_eepath(inner_eerel, GET_INNER_PATH(new_path));
-	}
+	eerel->join_pairs = lappend(eerel->join_pairs, pair);
 
-	return eepath;
+	MemoryContextSwitchTo(old_ctx);
 }
 
 /*
@@ -1128,7 +3238,7 @@ record_projection_paths(EERel *eerel)
 
 		if (path->type == T_ProjectionPath)
 		{
-			record_eepath(eerel, path);
+			record_eepath(eerel, path, false);
 		}
 	}
 }
@@ -1156,6 +3266,9 @@ create_eerel(RelOptInfo *roi)
 	eerel->name = NULL;
 	eerel->alias = NULL;
 
+	eerel->planner_mem = ee_planner_mem();
+	eerel->relids = ee_intern_relids(global_ee_state, roi->relids);
+
 	global_ee_state->current_eesubquery->eerel_list = lappend(global_ee_state->current_eesubquery->eerel_list, eerel);
 
     entry = (EERelHashEntry *) hash_search(global_ee_state->eerel_by_roi,
@@ -1213,10 +3326,248 @@ init_eesubquery(void)
 
 	eesubquery->eerel_list = NIL;
 	eesubquery->id = global_ee_state->eesubquery_counter++;
+	eesubquery->plan_kind = global_ee_state->current_plan_kind;
 
 	MemoryContextSwitchTo(old_ctx);
 }
 
+/*
+ * Установка вида плана (generic/custom) для последующих планирований.
+ *
+ * Текущий eesubquery на момент вызова еще не содержит отношений (он создается
+ * заранее, по окончании планирования предыдущего запроса), поэтому вид плана
+ * устанавливается и для него.
+ */
+void
+ee_set_plan_kind(EEPlanKind plan_kind)
+{
+	global_ee_state->current_plan_kind = plan_kind;
+	global_ee_state->current_eesubquery->plan_kind = plan_kind;
+}
+
+/* ----------------------------------------------------------------
+ *				SQL-функции расширения
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * Запрос из pg_stat_statements, для которого требуется собрать пути
+ */
+typedef struct EETopStatement
+{
+	int64		queryid;
+	char	   *query;
+} EETopStatement;
+
+/*
+ * Планирование текста запроса в виде generic плана с записью всех путей.
+ *
+ * Запрос не исполняется. Параметры вида $n остаются несвязанными, поэтому
+ * планировщик строит generic план, как это делает plancache.
+ */
+int64
+ee_capture_generic_plan(const char *query_string, int64 queryid)
+{
+	List	   *raw_parsetree_list;
+	RawStmt    *parsetree;
+	Query	   *query;
+	List	   *querytree_list;
+	Oid		   *param_types = NULL;
+	int			num_params = 0;
+	int64		query_id = 0;
+	extended_explain_options options;
+	ListCell   *lc;
+
+	raw_parsetree_list = pg_parse_query(query_string);
+
+	if (list_length(raw_parsetree_list) != 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("query must contain a single statement")));
+
+	parsetree = linitial_node(RawStmt, raw_parsetree_list);
+
+	query = parse_analyze_varparams(parsetree, query_string,
+									&param_types, &num_params, NULL);
+
+	if (query->commandType == CMD_UTILITY)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("utility statements cannot be captured")));
+
+	querytree_list = pg_rewrite_query(query);
+
+	memset(&options, 0, sizeof(extended_explain_options));
+	options.get_paths = true;
+
+	ee_begin_capture(&options);
+
+	PG_TRY();
+	{
+		global_ee_state->queryid = queryid != 0 ? queryid : (int64) query->queryId;
+
+		foreach(lc, querytree_list)
+		{
+			Query	   *querytree = lfirst_node(Query, lc);
+
+			if (querytree->commandType == CMD_UTILITY)
+				continue;
+
+			ee_mark_final_plan(pg_plan_query(querytree, query_string,
+											 CURSOR_OPT_PARALLEL_OK, NULL));
+		}
+
+		query_id = ee_store_capture(query_string);
+	}
+	PG_FINALLY();
+	{
+		ee_end_capture();
+	}
+	PG_END_TRY();
+
+	return query_id;
+}
+
+/*
+ * ee.capture_top_statements(n) -- сбор путей generic планов для n самых
+ * тяжелых (по total_exec_time) запросов из pg_stat_statements.
+ *
+ * Каждый запрос планируется в отдельной подтранзакции, поэтому ошибка
+ * планирования одного запроса (например, невозможность определить тип
+ * параметра) не мешает обработке остальных.
+ */
+PG_FUNCTION_INFO_V1(ee_capture_top_statements);
+
+Datum
+ee_capture_top_statements(PG_FUNCTION_ARGS)
+{
+	int32		n = PG_GETARG_INT32(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemoryContext fn_ctx = CurrentMemoryContext;
+	ResourceOwner fn_owner = CurrentResourceOwner;
+	Oid			pgss_oid;
+	StringInfoData sql;
+	List	   *statements = NIL;
+	ListCell   *lc;
+	uint64		i;
+
+	if (n <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of statements must be positive")));
+
+	if (global_ee_state != NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("path capture is already in progress")));
+
+	pgss_oid = get_extension_oid("pg_stat_statements", true);
+	if (!OidIsValid(pgss_oid))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("extension \"pg_stat_statements\" is not installed")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "SELECT queryid, query FROM %s.pg_stat_statements "
+					 "WHERE dbid = %u AND toplevel AND queryid IS NOT NULL "
+					 "ORDER BY total_exec_time DESC LIMIT %d",
+					 quote_identifier(get_namespace_name(get_extension_schema(pgss_oid))),
+					 MyDatabaseId, n);
+
+	/*
+	 * Копируем тексты запросов в память функции: планирование выполняется
+	 * уже после отключения от SPI.
+	 */
+	SPI_connect();
+
+	if (SPI_execute(sql.data, true, 0) != SPI_OK_SELECT)
+		elog(ERROR, "could not read pg_stat_statements");
+
+	for (i = 0; i < SPI_processed; i++)
+	{
+		HeapTuple	tuple = SPI_tuptable->vals[i];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+		EETopStatement *stmt;
+		MemoryContext old_ctx;
+		Datum		query;
+		bool		isnull;
+
+		query = SPI_getbinval(tuple, tupdesc, 2, &isnull);
+		if (isnull)
+			continue;
+
+		old_ctx = MemoryContextSwitchTo(fn_ctx);
+
+		stmt = (EETopStatement *) palloc(sizeof(EETopStatement));
+		stmt->queryid = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+		stmt->query = TextDatumGetCString(query);
+
+		statements = lappend(statements, stmt);
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	SPI_finish();
+
+	foreach(lc, statements)
+	{
+		EETopStatement *stmt = (EETopStatement *) lfirst(lc);
+		volatile int64 query_id = 0;
+		volatile bool captured = false;
+
+		BeginInternalSubTransaction(NULL);
+		MemoryContextSwitchTo(fn_ctx);
+
+		PG_TRY();
+		{
+			query_id = ee_capture_generic_plan(stmt->query, stmt->queryid);
+
+			ReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(fn_ctx);
+			CurrentResourceOwner = fn_owner;
+
+			captured = true;
+		}
+		PG_CATCH();
+		{
+			ErrorData  *edata;
+
+			MemoryContextSwitchTo(fn_ctx);
+			edata = CopyErrorData();
+			FlushErrorState();
+
+			RollbackAndReleaseCurrentSubTransaction();
+			MemoryContextSwitchTo(fn_ctx);
+			CurrentResourceOwner = fn_owner;
+
+			ereport(WARNING,
+					(errmsg("could not capture paths of statement " INT64_FORMAT,
+							stmt->queryid),
+					 errdetail("%s", edata->message)));
+
+			FreeErrorData(edata);
+		}
+		PG_END_TRY();
+
+		if (captured)
+		{
+			Datum		values[2];
+			bool		nulls[2] = {false, false};
+
+			values[0] = Int64GetDatum(stmt->queryid);
+			values[1] = Int64GetDatum(query_id);
+
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+								 values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
 /* ----------------------------------------------------------------
  *				 Остальные функции
  * ----------------------------------------------------------------
@@ -1313,6 +3664,32 @@ compare_parallel_safe(bool a, bool b)
 		return PARALLEL_SAFE_EQUAL;
 }
 
+/*
+ * Сравнение стоимостей частичных путей.
+ *
+ * В отличие от compare_path_costs_fuzzily, стартовая стоимость частичных
+ * путей не учитывается (см. add_partial_path), поэтому при различии полных
+ * стоимостей возвращается TOTAL_AND_STARTUP_BETTER1/2.
+ */
+static PathCostComparison
+compare_partial_path_costs(Path *path1, Path *path2, double fuzz_factor)
+{
+	if (unlikely(path1->disabled_nodes != path2->disabled_nodes))
+	{
+		if (path1->disabled_nodes < path2->disabled_nodes)
+			return DISABLED_NODES_BETTER1;
+		else
+			return DISABLED_NODES_BETTER2;
+	}
+
+	if (path1->total_cost > path2->total_cost * fuzz_factor)
+		return TOTAL_AND_STARTUP_BETTER2;
+	if (path2->total_cost > path1->total_cost * fuzz_factor)
+		return TOTAL_AND_STARTUP_BETTER1;
+
+	return COSTS_EQUAL;
+}
+
 /*
  * Отметить старый путь как замещенный
  */
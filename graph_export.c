@@ -0,0 +1,407 @@
+/*-------------------------------------------------------------------------
+ *
+ * graph_export.c
+ *    Выгрузка графа путей в форматах Graphviz DOT и GraphML
+ *
+ * Пути EXPLAIN запроса из ee.paths выводятся как вершины графа, ребра --
+ * связи путей с дочерними путями и с путями, вытеснившими их из pathlist
+ * (displaced_by). В формате DOT вершины группируются в кластеры по
+ * количеству соединенных базовых отношений (ee.paths.level).
+ *
+ * Документ возвращается построчно, поэтому его можно выгрузить в файл без
+ * сборки одной большой строки:
+ *
+ *     COPY (SELECT * FROM ee.export_graph(1, 'dot')) TO '/tmp/paths.dot';
+ *
+ * Для больших сборов граф можно ограничить путями итогового плана
+ * (filter = 'final') или путями итогового плана вместе с альтернативами из
+ * тех же отношений (filter = 'near_final').
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/top_plans.h"
+
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+
+typedef enum EEGraphFormat
+{
+	EE_GRAPH_DOT,
+	EE_GRAPH_GRAPHML,
+} EEGraphFormat;
+
+typedef enum EEGraphFilter
+{
+	EE_GRAPH_ALL,
+	EE_GRAPH_FINAL,
+	EE_GRAPH_NEAR_FINAL,
+} EEGraphFilter;
+
+typedef struct EEGraphNodeHashEntry
+{
+	int64		path_id;
+	EEPlanNode *node;
+} EEGraphNodeHashEntry;
+
+typedef struct EEGraphRelHashEntry
+{
+	int64		rel_id;
+} EEGraphRelHashEntry;
+
+/*
+ * Вывод одной строки документа
+ */
+static void
+emit_line(ReturnSetInfo *rsinfo, StringInfo buf)
+{
+	Datum		value = CStringGetTextDatum(buf->data);
+	bool		isnull = false;
+
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, &value, &isnull);
+	pfree(DatumGetPointer(value));
+	resetStringInfo(buf);
+}
+
+/*
+ * Экранирование строки для DOT (в кавычках) и XML
+ */
+static void
+append_escaped(StringInfo buf, const char *str, EEGraphFormat format)
+{
+	for (; *str; str++)
+	{
+		if (format == EE_GRAPH_DOT)
+		{
+			if (*str == '"' || *str == '\\')
+				appendStringInfoChar(buf, '\\');
+			appendStringInfoChar(buf, *str);
+		}
+		else
+		{
+			switch (*str)
+			{
+				case '&':
+					appendStringInfoString(buf, "&amp;");
+					break;
+				case '<':
+					appendStringInfoString(buf, "&lt;");
+					break;
+				case '>':
+					appendStringInfoString(buf, "&gt;");
+					break;
+				case '"':
+					appendStringInfoString(buf, "&quot;");
+					break;
+				default:
+					appendStringInfoChar(buf, *str);
+			}
+		}
+	}
+}
+
+/*
+ * Отбор путей по фильтру. Возвращает пути в порядке path_id.
+ *
+ * Для near_final в граф также попадают альтернативы, из которых выбирал
+ * планировщик: все пути отношений, содержащих пути итогового плана, и пути,
+ * построенные над путями итогового плана (например, другие способы
+ * соединения тех же входов).
+ */
+static List *
+filter_nodes(List *nodes, EEGraphFilter filter)
+{
+	List	   *result = NIL;
+	HTAB	   *final_rels = NULL;
+	ListCell   *lc;
+
+	if (filter == EE_GRAPH_ALL)
+		return nodes;
+
+	if (filter == EE_GRAPH_NEAR_FINAL)
+	{
+		HASHCTL		hash_ctl;
+
+		memset(&hash_ctl, 0, sizeof(HASHCTL));
+		hash_ctl.keysize = sizeof(int64);
+		hash_ctl.entrysize = sizeof(EEGraphRelHashEntry);
+		hash_ctl.hcxt = CurrentMemoryContext;
+		final_rels = hash_create("final plan rels", 64, &hash_ctl,
+								 HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+
+		foreach(lc, nodes)
+		{
+			EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+
+			if (node->in_final_plan)
+				hash_search(final_rels, &node->rel_id, HASH_ENTER, NULL);
+		}
+	}
+
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+		bool		include = node->in_final_plan;
+		int			i;
+
+		if (final_rels != NULL && !include)
+		{
+			include = hash_search(final_rels, &node->rel_id, HASH_FIND, NULL) != NULL;
+
+			for (i = 0; i < node->nchild && !include; i++)
+				include = node->children[i]->in_final_plan;
+		}
+
+		if (include)
+			result = lappend(result, node);
+	}
+
+	return result;
+}
+
+/*
+ * Вершина графа
+ */
+static void
+emit_node(ReturnSetInfo *rsinfo, StringInfo buf, EEPlanNode *node,
+		  EEGraphFormat format)
+{
+	if (format == EE_GRAPH_DOT)
+	{
+		appendStringInfo(buf, "    p" INT64_FORMAT " [label=\"" INT64_FORMAT ": ",
+						 node->path_id, node->path_id);
+		append_escaped(buf, node->path_type ? node->path_type : "?", format);
+		appendStringInfoString(buf, "\\n");
+		append_escaped(buf, node->rel_label, format);
+		appendStringInfo(buf, "\\ncost %.2f\"", node->total_cost);
+
+		if (node->in_final_plan)
+			appendStringInfoString(buf, ", style=bold");
+		else if (!node->saved)
+			appendStringInfoString(buf, ", style=dashed");
+
+		appendStringInfoString(buf, "];");
+		emit_line(rsinfo, buf);
+		return;
+	}
+
+	appendStringInfo(buf, "    <node id=\"p" INT64_FORMAT "\">", node->path_id);
+	appendStringInfoString(buf, "<data key=\"type\">");
+	append_escaped(buf, node->path_type ? node->path_type : "?", format);
+	appendStringInfoString(buf, "</data><data key=\"rel\">");
+	append_escaped(buf, node->rel_label, format);
+	appendStringInfo(buf, "</data><data key=\"level\">%d</data>", node->level);
+	appendStringInfo(buf, "<data key=\"cost\">%.2f</data>", node->total_cost);
+	appendStringInfoString(buf, "<data key=\"result\">");
+	append_escaped(buf, node->add_path_result ? node->add_path_result : "", format);
+	appendStringInfo(buf, "</data><data key=\"final\">%s</data></node>",
+					 node->in_final_plan ? "true" : "false");
+	emit_line(rsinfo, buf);
+}
+
+/*
+ * Ребро графа. kind -- child или displaced_by.
+ */
+static void
+emit_edge(ReturnSetInfo *rsinfo, StringInfo buf, int64 source, int64 target,
+		  const char *kind, bool final, EEGraphFormat format)
+{
+	if (format == EE_GRAPH_DOT)
+	{
+		appendStringInfo(buf, "  p" INT64_FORMAT " -> p" INT64_FORMAT,
+						 source, target);
+
+		if (strcmp(kind, "displaced_by") == 0)
+			appendStringInfoString(buf, " [style=dashed, color=gray, constraint=false]");
+		else if (final)
+			appendStringInfoString(buf, " [style=bold]");
+
+		appendStringInfoChar(buf, ';');
+		emit_line(rsinfo, buf);
+		return;
+	}
+
+	appendStringInfo(buf, "    <edge source=\"p" INT64_FORMAT "\" target=\"p" INT64_FORMAT "\">"
+					 "<data key=\"kind\">%s</data></edge>",
+					 source, target, kind);
+	emit_line(rsinfo, buf);
+}
+
+/*
+ * ee.export_graph(query_id, format, filter) -- граф путей EXPLAIN запроса
+ * query_id в формате DOT или GraphML, по строке документа на строку
+ * результата.
+ */
+PG_FUNCTION_INFO_V1(ee_export_graph);
+
+Datum
+ee_export_graph(PG_FUNCTION_ARGS)
+{
+	int64		query_id = PG_GETARG_INT64(0);
+	char	   *format_name = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	char	   *filter_name = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	EEGraphFormat format;
+	EEGraphFilter filter;
+	List	   *nodes;
+	List	  **levels;
+	int			max_level = 0;
+	HASHCTL		hash_ctl;
+	HTAB	   *included;
+	StringInfoData buf;
+	ListCell   *lc;
+	int			level;
+
+	if (pg_strcasecmp(format_name, "dot") == 0)
+		format = EE_GRAPH_DOT;
+	else if (pg_strcasecmp(format_name, "graphml") == 0)
+		format = EE_GRAPH_GRAPHML;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unrecognized graph format \"%s\"", format_name),
+				 errhint("Valid formats are \"dot\" and \"graphml\".")));
+
+	if (pg_strcasecmp(filter_name, "all") == 0)
+		filter = EE_GRAPH_ALL;
+	else if (pg_strcasecmp(filter_name, "final") == 0)
+		filter = EE_GRAPH_FINAL;
+	else if (pg_strcasecmp(filter_name, "near_final") == 0)
+		filter = EE_GRAPH_NEAR_FINAL;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unrecognized graph filter \"%s\"", filter_name),
+				 errhint("Valid filters are \"all\", \"final\" and \"near_final\".")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	nodes = filter_nodes(ee_load_plan_nodes(query_id, CurrentMemoryContext),
+						 filter);
+
+	/* Вершины, вошедшие в граф, и их распределение по уровням */
+	memset(&hash_ctl, 0, sizeof(HASHCTL));
+	hash_ctl.keysize = sizeof(int64);
+	hash_ctl.entrysize = sizeof(EEGraphNodeHashEntry);
+	hash_ctl.hcxt = CurrentMemoryContext;
+	included = hash_create("exported paths", Max(list_length(nodes), 32),
+						   &hash_ctl, HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+		EEGraphNodeHashEntry *entry;
+
+		entry = (EEGraphNodeHashEntry *) hash_search(included, &node->path_id,
+													 HASH_ENTER, NULL);
+		entry->node = node;
+		max_level = Max(max_level, node->level);
+	}
+
+	levels = (List **) palloc0(sizeof(List *) * (max_level + 1));
+
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+
+		levels[node->level] = lappend(levels[node->level], node);
+	}
+
+	initStringInfo(&buf);
+
+	/* Заголовок документа */
+	if (format == EE_GRAPH_DOT)
+	{
+		appendStringInfoString(&buf, "digraph paths {");
+		emit_line(rsinfo, &buf);
+		appendStringInfoString(&buf, "  node [shape=box];");
+		emit_line(rsinfo, &buf);
+	}
+	else
+	{
+		static const char *const header[] = {
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>",
+			"<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">",
+			"  <key id=\"type\" for=\"node\" attr.name=\"path_type\" attr.type=\"string\"/>",
+			"  <key id=\"rel\" for=\"node\" attr.name=\"rel\" attr.type=\"string\"/>",
+			"  <key id=\"level\" for=\"node\" attr.name=\"level\" attr.type=\"int\"/>",
+			"  <key id=\"cost\" for=\"node\" attr.name=\"total_cost\" attr.type=\"double\"/>",
+			"  <key id=\"result\" for=\"node\" attr.name=\"add_path_result\" attr.type=\"string\"/>",
+			"  <key id=\"final\" for=\"node\" attr.name=\"in_final_plan\" attr.type=\"boolean\"/>",
+			"  <key id=\"kind\" for=\"edge\" attr.name=\"kind\" attr.type=\"string\"/>",
+			"  <graph id=\"paths\" edgedefault=\"directed\">",
+		};
+		int			i;
+
+		for (i = 0; i < lengthof(header); i++)
+		{
+			appendStringInfoString(&buf, header[i]);
+			emit_line(rsinfo, &buf);
+		}
+	}
+
+	/* Вершины, сгруппированные по уровням */
+	for (level = 0; level <= max_level; level++)
+	{
+		if (levels[level] == NIL)
+			continue;
+
+		if (format == EE_GRAPH_DOT)
+		{
+			appendStringInfo(&buf, "  subgraph cluster_level_%d {", level);
+			emit_line(rsinfo, &buf);
+			appendStringInfo(&buf, "    label=\"level %d\";", level);
+			emit_line(rsinfo, &buf);
+		}
+
+		foreach(lc, levels[level])
+			emit_node(rsinfo, &buf, (EEPlanNode *) lfirst(lc), format);
+
+		if (format == EE_GRAPH_DOT)
+		{
+			appendStringInfoString(&buf, "  }");
+			emit_line(rsinfo, &buf);
+		}
+	}
+
+	/* Ребра между вершинами, вошедшими в граф */
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+		int			i;
+
+		for (i = 0; i < node->nchild; i++)
+		{
+			EEPlanNode *child = node->children[i];
+
+			if (filter != EE_GRAPH_ALL &&
+				hash_search(included, &child->path_id, HASH_FIND, NULL) == NULL)
+				continue;
+
+			emit_edge(rsinfo, &buf, node->path_id, child->path_id, "child",
+					  node->in_final_plan && child->in_final_plan, format);
+		}
+
+		if (node->displaced_by != 0 &&
+			hash_search(included, &node->displaced_by, HASH_FIND, NULL) != NULL)
+			emit_edge(rsinfo, &buf, node->path_id, node->displaced_by,
+					  "displaced_by", false, format);
+	}
+
+	if (format == EE_GRAPH_DOT)
+	{
+		appendStringInfoString(&buf, "}");
+		emit_line(rsinfo, &buf);
+	}
+	else
+	{
+		appendStringInfoString(&buf, "  </graph>");
+		emit_line(rsinfo, &buf);
+		appendStringInfoString(&buf, "</graphml>");
+		emit_line(rsinfo, &buf);
+	}
+
+	return (Datum) 0;
+}
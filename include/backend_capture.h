@@ -0,0 +1,19 @@
+/*-------------------------------------------------------------------------
+ *
+ * backend_capture.h
+ *
+ * IDENTIFICATION
+ *        include/backend_capture.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_BACKEND_CAPTURE_H
+#define EE_BACKEND_CAPTURE_H
+
+#include "postgres.h"
+
+extern void ee_backend_capture_init(void);
+extern bool ee_consume_capture_request(void);
+
+#endif							/* EE_BACKEND_CAPTURE_H */
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * capture_log.h
+ *
+ * IDENTIFICATION
+ *        include/capture_log.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_CAPTURE_LOG_H
+#define EE_CAPTURE_LOG_H
+
+#include "extended_explain.h"
+
+/* Место записи собранных путей (ee.sink) */
+typedef enum EESink
+{
+	EE_SINK_TABLES,				/* таблицы ee.query, ee.paths и т.д. */
+	EE_SINK_MMAP_LOG,			/* журнал сборов в $PGDATA/ee */
+	EE_SINK_PACKED,				/* ee.query.packed_paths вместо ee.paths */
+} EESink;
+
+extern int	ee_sink;
+
+extern void ee_capture_log_init(void);
+extern void ee_log_write_capture(const char *query_string, EEState *ee_state);
+
+#endif							/* EE_CAPTURE_LOG_H */
@@ -26,6 +26,8 @@
 #include "optimizer/planmain.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/planner.h"
+#include "tcop/utility.h"
+#include "access/xact.h"
 
 typedef enum
 {
@@ -60,6 +62,30 @@ typedef enum
 	COSTS_DIFFERENT,
 } PathCostComparison;
 
+/*
+ * Вид плана, для которого выполнялось планирование.
+ *
+ * Различается только при планировании подготовленных запросов (plancache):
+ * generic план строится без значений параметров, custom план -- с
+ * конкретными значениями параметров.
+ */
+typedef enum
+{
+	EE_PLAN_DEFAULT,
+	EE_PLAN_GENERIC,
+	EE_PLAN_CUSTOM,
+} EEPlanKind;
+
+/*
+ * Массив целых чисел переменной длины. Используется для компактного
+ * хранения pathkeys и множеств отношений (см. path_keys.c).
+ */
+typedef struct EEIntArray
+{
+	int			n;
+	int32		values[FLEXIBLE_ARRAY_MEMBER];
+}			EEIntArray;
+
 /*
  * EEPath -- информация об исходном пути
  *
@@ -74,12 +100,19 @@ typedef struct EEPath
 	/*
 	 * Указатель на структуру исходного пути.
 	 *
-	 * Является частью составного однозначного
-	 * идентификатора, который позволяет по исходному пути определить соответствующий
-	 * eepath.
+	 * По нему (EEState->eepath_by_path) исходный путь сопоставляется
+	 * соответствующему eepath, пока путь не освобожден функцией add_path.
 	 */
 	Path	   *path_pointer;
 
+	/*
+	 * Следующая запись того же исходного пути: один Path может быть
+	 * добавлен в несколько отношений (например, в отношение соединения и в
+	 * итоговое отношение). Записи одного Path образуют кольцо, NULL --
+	 * запись единственная.
+	 */
+	struct EEPath *same_path;
+
 	/*
 	 * Однозначный идентификатор eepath	пути в пределах одного
 	 * EXPLAIN запроса.
@@ -97,9 +130,12 @@ typedef struct EEPath
 	/* Количество дочерних путей */
 	int			nsub;
 
-	/* Указатели на дочерние пути */
-	struct EEPath *sub_eepath_1;
-	struct EEPath *sub_eepath_2;
+	/*
+	 * Массив указателей на дочерние пути длиной nsub. Для путей соединения
+	 * первым идет внешний путь, для Append/MergeAppend -- подпути в порядке
+	 * списка subpaths (включая частичные).
+	 */
+	struct EEPath **sub_eepaths;
 
 	/* Стоимости и кардинальность */
 	Cardinality rows;
@@ -116,6 +152,58 @@ typedef struct EEPath
 	 */
 	Oid			indexoid;
 
+	/*
+	 * Структурный отпечаток пути (get_path_fingerprint), по которому пути
+	 * сопоставляются с ee.fixate_paths
+	 */
+	int64		fingerprint;
+
+	/*
+	 * Параметры параллельного исполнения пути
+	 */
+	bool		parallel_aware;
+	int			parallel_workers;
+
+	/*
+	 * Путь является частичным: рассматривался функцией add_partial_path
+	 * (partial_pathlist) либо является дочерним путем частичного пути или
+	 * Gather/GatherMerge. Для таких путей add_path_result -- результат
+	 * работы add_partial_path.
+	 */
+	bool		partial;
+
+	/*
+	 * Путь выбран функцией set_cheapest наиболее дешевым путем своего
+	 * отношения: по полной стоимости, по стартовой стоимости или среди
+	 * параметризованных путей (cheapest_parameterized_paths).
+	 */
+	bool		cheapest_total;
+	bool		cheapest_startup;
+	bool		cheapest_parameterized;
+
+	/*
+	 * Путь вошел в итоговый план запроса (или в план SubPlan). plan_depth --
+	 * глубина пути в дереве плана (0 -- корень), -1 -- путь в план не вошел.
+	 */
+	bool		in_final_plan;
+	int			plan_depth;
+
+	/*
+	 * Pathkeys пути и множество отношений, от которых зависит
+	 * параметризованный путь (PATH_REQ_OUTER). Одинаковые значения разных
+	 * путей разделяются (EEState->interned_arrays), NULL -- пустое значение.
+	 */
+	EEIntArray *pathkeys;
+	EEIntArray *required_outer;
+
+	/*
+	 * Стратегия агрегации и оценка количества групп для AggPath и
+	 * GroupingSetsPath (для последнего -- сумма по всем rollup).
+	 * num_groups < 0 -- путь не является агрегацией.
+	 */
+	AggStrategy aggstrategy;
+	Cardinality num_groups;
+
 	/*
 	 * Результат работы add_path
 	 */
@@ -194,8 +282,201 @@ typedef struct EERel
 	 * ProjectionPath записаны?
 	 */
 	bool 		projection_processed;
+
+	/*
+	 * Профиль вызовов add_path для отношения: моменты первого и последнего
+	 * вызова, количество вызовов, наибольшая длина pathlist после вызова и
+	 * суммарное время работы хука add_path_hook.
+	 */
+	instr_time	first_add_path;
+	instr_time	last_add_path;
+	int64		add_path_calls;
+	int			max_pathlist_len;
+	instr_time	add_path_time;
+
+	/* Память планировщика на момент создания отношения, байт */
+	Size		planner_mem;
+
+	/* Базовые отношения (RelOptInfo->relids), NULL для верхних отношений */
+	EEIntArray *relids;
+
+	/*
+	 * Стадия верхнего отношения (UPPERREL_GROUP_AGG и т.д.), определяемая
+	 * при вызове create_upper_paths_hook. Для отношений сканирования и
+	 * соединения is_upper = false.
+	 */
+	bool		is_upper;
+	UpperRelationKind upper_stage;
+
+	/*
+	 * Имена базовых отношений, входящих в отношение, в том виде, в котором
+	 * их выводит EXPLAIN (List of char *). Заполняется по окончании
+	 * планирования подзапроса.
+	 */
+	List	   *rel_aliases;
+
+	/*
+	 * Количество вызовов add_path_precheck/add_partial_path_precheck и
+	 * пути, отброшенные ими (EEPrecheckedPath).
+	 */
+	int64		precheck_calls;
+	List	   *prechecked_paths;
+
+	/*
+	 * Пары отношений (EEJoinPair), соединением которых было получено данное
+	 * отношение соединения.
+	 */
+	List	   *join_pairs;
 }			EERel;
 
+/*
+ * Путь соединения, отброшенный функцией add_path_precheck или
+ * add_partial_path_precheck еще до создания структуры Path. Известны
+ * лишь предварительные оценки стоимости, дочерние пути не связываются.
+ */
+typedef struct EEPrecheckedPath
+{
+	/* Тип узла соединения (T_NestLoop, T_MergeJoin, T_HashJoin) */
+	NodeTag		pathtype;
+	JoinType	jointype;
+
+	/* Стартовая стоимость, -1 -- не оценивалась (частичный путь) */
+	Cost		startup_cost;
+	Cost		total_cost;
+	int			disabled_nodes;
+
+	/* Количество pathkeys пути */
+	int			npathkeys;
+
+	bool		parameterized;
+
+	/* Путь отброшен add_partial_path_precheck */
+	bool		partial;
+
+	/* Внешнее и внутреннее отношения соединения */
+	EERel	   *outer_rel;
+	EERel	   *inner_rel;
+
+	/* Путь, доминирующий над отброшенным (NULL, если он не был записан) */
+	struct EEPath *dominated_by;
+}			EEPrecheckedPath;
+
+/*
+ * Пара отношений, соединение которых рассматривалось при построении
+ * отношения соединения.
+ *
+ * Пара определяется по внешнему и внутреннему отношениям путей соединения,
+ * переданных в add_path_precheck, порядок отношений не учитывается
+ * (rel1->id < rel2->id).
+ */
+typedef struct EEJoinPair
+{
+	EERel	   *rel1;
+	EERel	   *rel2;
+
+	/* Между отношениями нет условий соединения (декартово произведение) */
+	bool		cartesian;
+
+	/* Все пути соединения пары отброшены add_path_precheck */
+	bool		pruned;
+}			EEJoinPair;
+
+/*
+ * Статистика одного уровня перебора соединений (standard_join_search).
+ */
+typedef struct EEJoinLevel
+{
+	/* Количество соединяемых базовых отношений */
+	int			level;
+
+	/* Количество отношений соединения, построенных на данном уровне */
+	int			nrels;
+
+	/* Время построения уровня без оверхеда расширения */
+	instr_time	time;
+
+	/* Память планировщика после построения уровня, байт */
+	Size		planner_mem;
+}			EEJoinLevel;
+
+/*
+ * Состояние измерения уровней перебора соединений.
+ *
+ * Перебор выполняет standard_join_search (или предыдущий join_search_hook),
+ * поэтому переход к следующему уровню определяется по root->join_cur_level
+ * при проверке очередного пути соединения.
+ */
+typedef struct EEJoinSearch
+{
+	/* PlannerInfo, для которого перебираются соединения (NULL вне перебора) */
+	PlannerInfo *root;
+
+	/* Массив отношений по уровням (root->join_rel_level) */
+	List	  **join_rel_level;
+
+	/* Измеряемый уровень (0, если путей соединения еще не было) */
+	int			level;
+
+	/* Начало построения уровня и оверхед расширения на этот момент */
+	instr_time	start;
+	instr_time	ee_time;
+}			EEJoinSearch;
+
+/*
+ * Базовое отношение графа соединений подзапроса
+ */
+typedef struct EEGraphRel
+{
+	/* Индекс RangeTblEntry отношения */
+	int			rtindex;
+
+	/* Отношение, если для него записывались пути */
+	struct EERel *eerel;
+
+	char	   *name;
+	char	   *alias;
+
+	/* Оценка количества строк после применения условий и размер таблицы */
+	Cardinality rows;
+	Cardinality tuples;
+}			EEGraphRel;
+
+/*
+ * Условие соединения (RestrictInfo из joininfo базовых отношений)
+ */
+typedef struct EEJoinClause
+{
+	char	   *clause;
+
+	/* Отношения, упоминаемые в условии, и его левой и правой частях */
+	EEIntArray *relids;
+	EEIntArray *left_relids;
+	EEIntArray *right_relids;
+
+	/* Селективность для внутреннего и внешнего соединений, -1 -- не оценена */
+	Selectivity norm_selec;
+	Selectivity outer_selec;
+
+	bool		pushed_down;
+	bool		hashable;
+	bool		mergeable;
+}			EEJoinClause;
+
+/*
+ * Класс эквивалентности подзапроса
+ */
+typedef struct EEEClass
+{
+	/* Позиция класса в root->eq_classes подзапроса (с единицы) */
+	int			id;
+
+	/* Члены класса (List of char *) */
+	List	   *members;
+
+	EEIntArray *relids;
+	bool		has_const;
+}			EEEClass;
+
 /*
  *
  */
@@ -212,14 +493,92 @@ typedef struct EESubQuery
 	 */
 	Index	subquery_level;
 
+	/*
+	 * Вид плана (generic/custom), в рамках планирования которого
+	 * обрабатывался подзапрос.
+	 */
+	EEPlanKind	plan_kind;
+
 	/* 
 	 * Список eerel отношений.
 	 *
 	 * Определяет принадлежность отношений к конкретному запросу/подзапросу.
 	 */
 	List	   *eerel_list;
+
+	/*
+	 * Статистика уровней перебора соединений (EEJoinLevel). Пуст, если
+	 * соединения не перебирались или использовался GEQO.
+	 */
+	List	   *join_levels;
+
+	/* Память планировщика по окончании планирования (UPPERREL_FINAL), байт */
+	Size		planner_mem;
+
+	/* Группы секций (EEPartitionGroup), режим collapse_partitions */
+	List	   *partition_groups;
+
+	/*
+	 * Итоговое отношение подзапроса (UPPERREL_FINAL), его PlannerInfo и
+	 * признак того, что путь, вошедший в план, уже определен. По root
+	 * путь подплана находится в root->glob->subpaths.
+	 */
+	RelOptInfo *final_rel;
+	PlannerInfo *root;
+	bool		final_marked;
+
+	/*
+	 * Граф соединений: базовые отношения (EEGraphRel), условия соединения
+	 * (EEJoinClause) и классы эквивалентности (EEEClass). Записывается по
+	 * окончании планирования подзапроса.
+	 */
+	List	   *graph_rels;
+	List	   *join_clauses;
+	List	   *eclasses;
 }			EESubQuery;
 
+/*
+ * Группа дочерних отношений (секций) одного секционированного отношения
+ * в режиме collapse_partitions.
+ *
+ * Пути записываются только для первого дочернего отношения группы
+ * (представителя). Для остальных учитывается лишь наименьшая стоимость
+ * путей, по которой строится распределение стоимостей секций.
+ */
+typedef struct EEPartitionGroup
+{
+	/* Секционированное отношение (или соединение секционированных) */
+	RelOptInfo *parent_roi;
+	EERel	   *parent_eerel;
+
+	/* Представитель группы */
+	EERel	   *representative;
+
+	/* Дочерние отношения группы (EECollapsedRel), включая представителя */
+	List	   *children;
+
+	/*
+	 * Количество секций, отсеченных при планировании, -1 -- неизвестно.
+	 * Заполняется на стадии UPPERREL_FINAL подзапроса.
+	 */
+	int			pruned;
+}			EEPartitionGroup;
+
+/*
+ * Дочернее отношение группы секций. Первое поле является ключом хеш-таблицы
+ * collapsed_by_roi.
+ */
+typedef struct EECollapsedRel
+{
+	RelOptInfo *roi;
+	EEPartitionGroup *group;
+
+	/* Наименьшая общая стоимость путей, переданных в add_path */
+	Cost		min_total_cost;
+
+	bool		representative;
+}			EECollapsedRel;
+
 typedef struct EERelHashEntry
 {
     void		*roi_ptr;
@@ -229,8 +588,6 @@ typedef struct EERelHashEntry
 typedef struct EEPathHashKey
 {
     void		*path_ptr;
-	Cost		startup_cost;
-	Cost		total_cost;
 } EEPathHashKey;
 
 typedef struct EEPathHashEntry
@@ -247,6 +604,9 @@ typedef struct extended_explain_options
 	bool		get_paths;
 	bool		hide_disabled;
 	bool		fixate_paths;
+	bool		save_aborted;
+	bool		collapse_partitions;
+	bool		alternatives;
 } extended_explain_options;
 
 /*
@@ -286,6 +646,22 @@ typedef struct EEState
 	 */
 	bool 		fixate_path;
 
+	/*
+	 * Вид плана, который строит планировщик в данный момент. Наследуется
+	 * каждым новым eesubquery.
+	 */
+	EEPlanKind	current_plan_kind;
+
+	/*
+	 * Статистика plancache для EXPLAIN EXECUTE: стоимости generic и custom
+	 * планов в том виде, в котором их сравнивает plancache, и выбранный им
+	 * вид плана (EE_PLAN_DEFAULT, если запрос не подготовленный).
+	 */
+	double		plancache_generic_cost;
+	double		plancache_avg_custom_cost;
+	int64		plancache_custom_plans;
+	EEPlanKind	plancache_choice;
+
 	/* 
 	 * Сохраненные RelOptInfo и EERel отношения, 
 	 * которые были обработаны функцией add_path() в последний раз
@@ -298,6 +674,63 @@ typedef struct EEState
 	HTAB		*eerel_by_roi;
 	HTAB		*eepath_by_path;
 
+	/* Дочерние отношения групп секций (EECollapsedRel) по RelOptInfo */
+	HTAB		*collapsed_by_roi;
+
+	/*
+	 * Уникальные значения pathkeys и множеств отношений (EEIntArray), а
+	 * также внутренние номера классов эквивалентности, встречавшихся в
+	 * pathkeys. eclasses -- записи о классах в порядке внутренних номеров
+	 * (см. path_keys.c).
+	 */
+	HTAB		*interned_arrays;
+	HTAB		*eclass_ids;
+	List		*eclasses;
+
+	/*
+	 * Идентификатор запроса (Query->queryId), совпадающий с queryid
+	 * расширения pg_stat_statements. Равен нулю, если не вычислялся.
+	 */
+	int64		queryid;
+
+	/* Текущий перебор соединений (см. ee_join_search) */
+	EEJoinSearch join_search;
+
+	/*
+	 * Параметры курсора (cursorOptions) последнего планирования. Нужны для
+	 * выбора пути запроса верхнего уровня так же, как в standard_planner.
+	 */
+	int			cursor_options;
+
+	/*
+	 * Состояние сбора: планирование завершено, сбор прерван ошибкой и текст
+	 * этой ошибки. Используются при записи частично собранных путей
+	 * (параметр save_aborted).
+	 */
+	bool		planning_finished;
+	bool		aborted;
+	char	   *error_message;
+
+	/*
+	 * Учет памяти планировщика. Память измеряется в контексте, в котором
+	 * начат сбор путей (вместе с дочерними контекстами), относительно ее
+	 * объема на момент начала сбора. Память самого расширения выделяется в
+	 * ee_ctx и в эти значения не входит.
+	 */
+	MemoryContext planner_mem_ctx;
+	Size		planner_mem_base;
+	Size		planner_mem_peak;
+
+	/* Память, занятая собранными путями (ee_ctx), байт */
+	Size		capture_mem;
+
+	/*
+	 * Пути, вошедшие в план, еще не сопоставленные узлам плана при выводе
+	 * EXPLAIN с параметром alternatives (см. plan_alternatives.c).
+	 */
+	List	   *plan_node_paths;
+	bool		plan_node_paths_built;
+
 	instr_time	ee_time; 		/* Оверхед расширения */
 	instr_time	planning_time; 	/* Время планирования без оверхеда*/
 	instr_time 	start_time; 	/* Время начала планирования */
@@ -308,30 +741,28 @@ typedef struct EEState
 	extended_explain_options options;
 }			EEState;
 
-/*
- * Типы PathWithOneSubPath и PathWithTwoSubPaths и макросы GET_SUB_PATH,
- * GET_OUTER_PATH, GET_INNER_PATH позволяют обращаться к дочерним путям.
- */
-typedef struct PathWithOneSubPath
-{
-	Path		path;
-	Path	   *subpath;
-}			PathWithOneSubPath;
-
-typedef JoinPath PathWithTwoSubPaths;
-
-#define GET_SUB_PATH(path) (((PathWithOneSubPath *) path)->subpath)
-#define GET_OUTER_PATH(path) (((PathWithTwoSubPaths *) path)->outerjoinpath)
-#define GET_INNER_PATH(path) (((PathWithTwoSubPaths *) path)->innerjoinpath)
-
 /*-------------------------------------------------------------------------
  * 								Заголовки функций
  *-------------------------------------------------------------------------
  */
 
+extern void ee_join_path_precheck_hook(PlannerInfo *root,
+									   RelOptInfo *joinrel,
+									   NodeTag pathtype, JoinType jointype,
+									   Path *outer_path, Path *inner_path,
+									   JoinCostWorkspace *workspace,
+									   List *pathkeys, Relids required_outer,
+									   bool partial, bool accepted,
+									   Path *dominating_path);
+
 extern void ee_add_path_hook(RelOptInfo *parent_rel,
 							 Path *new_path);
 
+extern void ee_add_partial_path_hook(RelOptInfo *parent_rel,
+									 Path *new_path);
+
+extern void ee_set_cheapest_hook(RelOptInfo *parent_rel);
+
 extern void ee_explain(Query *query, int cursorOptions,
 					   IntoClause *into, struct ExplainState *es,
 					   const char *queryString, ParamListInfo params,
@@ -348,6 +779,23 @@ extern void ee_process_upper_paths(PlannerInfo *root,
 								   RelOptInfo *output_rel,
 								   void *extra);
 
+extern void ee_process_utility(PlannedStmt *pstmt,
+							   const char *queryString,
+							   bool readOnlyTree,
+							   ProcessUtilityContext context,
+							   ParamListInfo params,
+							   QueryEnvironment *queryEnv,
+							   DestReceiver *dest,
+							   QueryCompletion *qc);
+
+extern PlannedStmt *ee_planner(Query *parse, const char *query_string,
+								int cursorOptions, ParamListInfo boundParams);
+
+extern void ee_xact_callback(XactEvent event, void *arg);
+
+extern RelOptInfo *ee_join_search(PlannerInfo *root, int levels_needed,
+								  List *initial_rels);
+
 extern void ee_explain_per_plan_hook(PlannedStmt *plannedstmt,
 							 IntoClause *into,
 							 struct ExplainState *es,
@@ -355,17 +803,30 @@ extern void ee_explain_per_plan_hook(PlannedStmt *plannedstmt,
 							 ParamListInfo params,
 							 QueryEnvironment *queryEnv);
 
+extern void ee_explain_per_node_hook(PlanState *planstate,
+									 List *ancestors,
+									 const char *relationship,
+									 const char *plan_name,
+									 struct ExplainState *es);
+
 extern EEState *create_ee_state(void);
 
-extern int	get_subpath_num(Path *path);
+extern EEState *ee_begin_capture(extended_explain_options *options);
+extern int64 ee_store_capture(const char *queryString);
+extern void ee_end_capture(void);
+extern void ee_abort_capture(const char *queryString);
+extern bool ee_capture_in_progress(void);
+extern int64 ee_capture_generic_plan(const char *query_string, int64 queryid);
+
 
 extern EEPath *create_eepath(Path *path, EERel *eerel);
 extern EEPath *search_eepath(Path *path);
-extern EEPath *record_eepath(EERel * eerel, Path *new_path);
+extern EEPath *record_eepath(EERel * eerel, Path *new_path, bool partial);
 
 extern EERel *create_eerel(RelOptInfo *roi);
 extern EERel *search_eerel(RelOptInfo *roi);
 
 extern void init_eesubquery(void);
+extern void ee_set_plan_kind(EEPlanKind plan_kind);
 
 #endif							/* EXTENDED_EXPLAIN_H */
\ No newline at end of file
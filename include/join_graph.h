@@ -0,0 +1,19 @@
+/*-------------------------------------------------------------------------
+ *
+ * join_graph.h
+ *
+ * IDENTIFICATION
+ *        include/join_graph.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_JOIN_GRAPH_H
+#define EE_JOIN_GRAPH_H
+
+#include "extended_explain.h"
+
+extern void ee_record_join_graph(EEState *ee_state, EESubQuery *eesubquery,
+								 PlannerInfo *root);
+
+#endif							/* EE_JOIN_GRAPH_H */
@@ -12,9 +12,32 @@
 #define EE_OUTPUT_RESULT_H
 
 #include "extended_explain.h"
+#include "race.h"
+
+/* Количество колонок таблицы ee.paths */
+#define NUM_OF_COLS_EEPATHS 38
+
+extern void form_eepath_values(int64 query_id, EEState *ee_state,
+							   EESubQuery *eesubquery, EERel *eerel,
+							   EEPath *eepath, Datum *values, bool *nulls);
 
 extern void insert_paths_into_eepaths(int64 query_id, EEState *ee_state, bool hide_disabled);
 
-extern int64 insert_query_info_into_eequery(const char *queryString);
+extern int64 insert_query_info_into_eequery(const char *queryString, EEState *ee_state,
+											 bool packed);
+
+extern void insert_rels_into_eerels(int64 query_id, EEState *ee_state);
+
+extern void insert_join_search_into_eetables(int64 query_id, EEState *ee_state);
+
+extern void insert_partition_groups_into_eepartgroups(int64 query_id, EEState *ee_state);
+
+extern void insert_prechecked_paths_into_eeprechecked(int64 query_id, EEState *ee_state);
+
+extern void insert_join_graph_into_eetables(int64 query_id, EEState *ee_state);
+
+extern const char *add_path_result_to_string(AddPathResult add_path_result);
+
+extern void insert_race_result_into_eerace(int64 query_id, EERaceResult *result);
 
 #endif							/* EE_OUTPUT_RESULT_H */
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * path_keys.h
+ *
+ * IDENTIFICATION
+ *        include/path_keys.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_PATH_KEYS_H
+#define EE_PATH_KEYS_H
+
+#include "extended_explain.h"
+
+/* Количество чисел, описывающих один pathkey */
+#define EE_PATHKEY_WIDTH 4
+
+extern void ee_init_interning(EEState *ee_state);
+extern int	ee_eclass_id(EEState *ee_state, EquivalenceClass *ec);
+extern void ee_set_eclass_position(EEState *ee_state, EquivalenceClass *ec,
+								   int position);
+extern uint64 ee_pathkeys_hash(EEState *ee_state, List *pathkeys);
+extern EEIntArray *ee_intern_pathkeys(EEState *ee_state, List *pathkeys);
+extern EEIntArray *ee_intern_relids(EEState *ee_state, Relids relids);
+extern Datum ee_pathkeys_datum(EEState *ee_state, EEIntArray *pathkeys);
+extern Datum ee_relids_datum(EEIntArray *relids);
+
+#endif							/* EE_PATH_KEYS_H */
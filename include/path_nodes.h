@@ -0,0 +1,23 @@
+/*-------------------------------------------------------------------------
+ *
+ * path_nodes.h
+ *
+ * IDENTIFICATION
+ *        include/path_nodes.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_PATH_NODES_H
+#define EE_PATH_NODES_H
+
+#include "postgres.h"
+
+#include "extended_explain.h"
+
+extern int	get_subpath_num(Path *path);
+extern Path *get_subpath(Path *path, int n);
+extern const char *plan_type_name(NodeTag pathtype);
+extern int64 get_path_fingerprint(EEState *ee_state, Path *path);
+
+#endif							/* EE_PATH_NODES_H */
@@ -0,0 +1,18 @@
+/*-------------------------------------------------------------------------
+ *
+ * path_pack.h
+ *
+ * IDENTIFICATION
+ *        include/path_pack.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_PATH_PACK_H
+#define EE_PATH_PACK_H
+
+#include "extended_explain.h"
+
+extern Datum ee_pack_paths(int64 query_id, EEState *ee_state, bool hide_disabled);
+
+#endif							/* EE_PATH_PACK_H */
@@ -0,0 +1,19 @@
+/*-------------------------------------------------------------------------
+ *
+ * plan_alternatives.h
+ *
+ * IDENTIFICATION
+ *        include/plan_alternatives.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_PLAN_ALTERNATIVES_H
+#define EE_PLAN_ALTERNATIVES_H
+
+#include "extended_explain.h"
+
+extern void ee_explain_alternatives(EEState *ee_state, Plan *plan,
+									struct ExplainState *es);
+
+#endif							/* EE_PLAN_ALTERNATIVES_H */
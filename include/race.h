@@ -0,0 +1,53 @@
+/*-------------------------------------------------------------------------
+ *
+ * race.h
+ *
+ * IDENTIFICATION
+ *        include/race.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_RACE_H
+#define EE_RACE_H
+
+#include "postgres.h"
+
+#include "nodes/nodes.h"
+
+/*
+ * EERaceResult -- результат исполнения одного из K самых дешевых планов
+ * функцией ee.race.
+ */
+typedef struct EERaceResult
+{
+	/* Место плана в порядке возрастания стоимости, начиная с 1 */
+	int			rank;
+
+	/* Корневой путь плана и его тип */
+	int64		path_id;
+	char	   *path_type;
+
+	/* Стоимость плана по оценке планировщика */
+	Cost		estimated_cost;
+
+	/*
+	 * Результаты EXPLAIN ANALYZE запроса с зафиксированным планом: стоимость
+	 * всего плана (вместе с верхними узлами), время планирования и
+	 * исполнения (мс), количество строк. Не заполняются, если время
+	 * исполнения превысило заданный лимит (timed_out).
+	 */
+	Cost		planned_cost;
+	double		planning_time;
+	double		execution_time;
+	double		actual_rows;
+	bool		timed_out;
+
+	/* Компактное текстовое представление плана */
+	char	   *plan;
+
+	/* Исполненный план содержит узел навязанного пути */
+	bool		plan_matched;
+} EERaceResult;
+
+#endif							/* EE_RACE_H */
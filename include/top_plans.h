@@ -0,0 +1,100 @@
+/*-------------------------------------------------------------------------
+ *
+ * top_plans.h
+ *
+ * IDENTIFICATION
+ *        include/top_plans.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef EE_TOP_PLANS_H
+#define EE_TOP_PLANS_H
+
+#include "postgres.h"
+
+#include "nodes/pg_list.h"
+#include "nodes/nodes.h"
+
+/*
+ * EEPlanNode -- путь, прочитанный из таблицы ee.paths.
+ *
+ * Пути связаны между собой через дочерние пути (child_paths) и образуют
+ * ориентированный ациклический граф. Каждый путь вместе со всеми своими
+ * потомками является полным (под)планом.
+ */
+typedef struct EEPlanNode
+{
+	int64		path_id;
+	int64		subquery_id;
+	int64		rel_id;
+
+	/* Количество соединяемых базовых отношений (ee.paths.level) */
+	int			level;
+
+	char	   *path_type;
+
+	/* Название отношения для вывода (алиас, имя таблицы или rel N) */
+	char	   *rel_label;
+
+	/* Имя таблицы (ee.paths.rel_name), NULL для прочих отношений */
+	char	   *rel_name;
+
+	Cost		startup_cost;
+	Cost		total_cost;
+	int			disabled_nodes;
+
+	/* Путь остался в pathlist (add_path_result = saved) */
+	bool		saved;
+
+	/* Частичный путь (partial_pathlist) */
+	bool		partial;
+
+	/* Путь вошел в итоговый план (ee.paths.in_final_plan) */
+	bool		in_final_plan;
+
+	/* Путь, вытеснивший данный путь из pathlist, 0 -- не вытеснен */
+	int64		displaced_by;
+	char	   *add_path_result;
+
+	/* Структурный отпечаток пути (ee.paths.fingerprint) */
+	int64		fingerprint;
+
+	/* Дочерние пути */
+	int			nchild;
+	struct EEPlanNode **children;
+
+	/*
+	 * Характеристики дерева плана с корнем в данном пути. Вычисляются один
+	 * раз для каждого пути (динамическое программирование по графу путей),
+	 * -1 -- еще не вычислены.
+	 */
+	int			tree_size;
+	int			tree_depth;
+} EEPlanNode;
+
+/*
+ * EETopPlan -- один из K самых дешевых записанных путей отношения вместе
+ * с потомками.
+ */
+typedef struct EETopPlan
+{
+	int64		subquery_id;
+	int64		rel_id;
+
+	/* Место плана в порядке возрастания стоимости, начиная с 1 */
+	int			rank;
+
+	/* Корневой путь плана */
+	EEPlanNode *root;
+
+	/* Корневой путь плана, выбранного планировщиком для того же отношения */
+	EEPlanNode *chosen;
+} EETopPlan;
+
+extern List *ee_load_plan_nodes(int64 query_id, MemoryContext ctx);
+extern List *ee_get_top_plans(int64 query_id, int k);
+extern void ee_collect_plan_nodes(EEPlanNode *root, List **nodes);
+extern char *ee_plan_text(EEPlanNode *root);
+
+#endif							/* EE_TOP_PLANS_H */
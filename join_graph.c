@@ -0,0 +1,227 @@
+/*-------------------------------------------------------------------------
+ *
+ * join_graph.c
+ *    Запись графа соединений подзапроса
+ *
+ * По окончании планирования подзапроса записываются его базовые отношения,
+ * условия соединения (RestrictInfo из joininfo базовых отношений) с оценками
+ * селективности и классы эквивалентности. Выражения выводятся так же, как
+ * их выводит EXPLAIN: с именами отношений из rtable_names.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/join_graph.h"
+#include "include/path_keys.h"
+
+#include "nodes/nodeFuncs.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/ruleutils.h"
+
+typedef struct EEDeparseContext
+{
+	List	   *rtable_names;
+	List	   *dpcontext;
+	MemoryContext ee_mcxt;
+} EEDeparseContext;
+
+/*
+ * Замена PlaceHolderVar содержащимся в нем выражением: ruleutils выводит
+ * только выражения, уже обработанные setrefs.
+ */
+static Node *
+strip_placeholders_mutator(Node *node, void *context)
+{
+	if (node == NULL)
+		return NULL;
+
+	if (IsA(node, PlaceHolderVar))
+		return strip_placeholders_mutator((Node *) ((PlaceHolderVar *) node)->phexpr,
+										  context);
+
+	return expression_tree_mutator(node, strip_placeholders_mutator, context);
+}
+
+/*
+ * Текстовое представление выражения в памяти расширения
+ */
+static char *
+deparse_to_ee(EEDeparseContext *ctx, Expr *expr)
+{
+	Node	   *node = strip_placeholders_mutator((Node *) expr, NULL);
+
+	return MemoryContextStrdup(ctx->ee_mcxt,
+							   deparse_expression(node, ctx->dpcontext,
+												  true, false));
+}
+
+/*
+ * Имена базовых отношений, входящих в множество relids. Вызывается в
+ * контексте памяти расширения.
+ */
+static List *
+relids_to_aliases(EEDeparseContext *ctx, PlannerInfo *root, EEIntArray *relids)
+{
+	List	   *aliases = NIL;
+	int			i;
+
+	if (relids == NULL)
+		return NIL;
+
+	for (i = 0; i < relids->n; i++)
+	{
+		int			rti = relids->values[i];
+		char	   *refname;
+
+		/* Индексы внешних соединений отношениям не соответствуют */
+		if (rti >= root->simple_rel_array_size ||
+			root->simple_rel_array[rti] == NULL)
+			continue;
+
+		refname = (char *) list_nth(ctx->rtable_names, rti - 1);
+		if (refname != NULL)
+			aliases = lappend(aliases, pstrdup(refname));
+	}
+
+	return aliases;
+}
+
+/*
+ * Запись графа соединений подзапроса root в eesubquery.
+ *
+ * Кроме того, для всех отношений подзапроса заполняется rel_aliases.
+ */
+void
+ee_record_join_graph(EEState *ee_state, EESubQuery *eesubquery, PlannerInfo *root)
+{
+	EEDeparseContext ctx;
+	PlannedStmt *pstmt;
+	Bitmapset  *rels_used = NULL;
+	List	   *joininfo = NIL;
+	MemoryContext old_ctx;
+	ListCell   *lc;
+	int			rti;
+
+	ctx.ee_mcxt = GetMemoryChunkContext(ee_state);
+
+	for (rti = 1; rti < root->simple_rel_array_size; rti++)
+		rels_used = bms_add_member(rels_used, rti);
+
+	/* Контекст вывода выражений, как у EXPLAIN плана подзапроса */
+	pstmt = makeNode(PlannedStmt);
+	pstmt->rtable = root->parse->rtable;
+
+	ctx.rtable_names = select_rtable_names_for_explain(pstmt->rtable, rels_used);
+	ctx.dpcontext = deparse_context_for_plan_tree(pstmt, ctx.rtable_names);
+
+	/* Базовые отношения и их условия соединения */
+	for (rti = 1; rti < root->simple_rel_array_size; rti++)
+	{
+		RelOptInfo *rel = root->simple_rel_array[rti];
+		RangeTblEntry *rte = root->simple_rte_array[rti];
+		EEGraphRel *graph_rel;
+
+		if (rel == NULL || rel->reloptkind != RELOPT_BASEREL)
+			continue;
+
+		foreach(lc, rel->joininfo)
+			joininfo = list_append_unique_ptr(joininfo, lfirst(lc));
+
+		old_ctx = MemoryContextSwitchTo(ctx.ee_mcxt);
+
+		graph_rel = (EEGraphRel *) palloc0(sizeof(EEGraphRel));
+		graph_rel->rtindex = rti;
+		graph_rel->eerel = search_eerel(rel);
+		graph_rel->rows = rel->rows;
+		graph_rel->tuples = rel->tuples;
+
+		if (rte->rtekind == RTE_RELATION)
+			graph_rel->name = get_rel_name(rte->relid);
+
+		if (list_nth(ctx.rtable_names, rti - 1) != NULL)
+			graph_rel->alias = pstrdup((char *) list_nth(ctx.rtable_names, rti - 1));
+
+		eesubquery->graph_rels = lappend(eesubquery->graph_rels, graph_rel);
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	foreach(lc, joininfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		EEJoinClause *clause;
+		char	   *clause_text = deparse_to_ee(&ctx, rinfo->clause);
+
+		old_ctx = MemoryContextSwitchTo(ctx.ee_mcxt);
+
+		clause = (EEJoinClause *) palloc0(sizeof(EEJoinClause));
+		clause->clause = clause_text;
+		clause->relids = ee_intern_relids(ee_state, rinfo->clause_relids);
+		clause->left_relids = ee_intern_relids(ee_state, rinfo->left_relids);
+		clause->right_relids = ee_intern_relids(ee_state, rinfo->right_relids);
+		clause->norm_selec = rinfo->norm_selec;
+		clause->outer_selec = rinfo->outer_selec;
+		clause->pushed_down = rinfo->is_pushed_down;
+		clause->hashable = OidIsValid(rinfo->hashjoinoperator);
+		clause->mergeable = rinfo->mergeopfamilies != NIL;
+
+		eesubquery->join_clauses = lappend(eesubquery->join_clauses, clause);
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	/* Классы эквивалентности */
+	foreach(lc, root->eq_classes)
+	{
+		EquivalenceClass *ec = (EquivalenceClass *) lfirst(lc);
+		int			position = foreach_current_index(lc) + 1;
+		EEEClass   *eeclass;
+		ListCell   *lc2;
+
+		if (ec->ec_merged != NULL)
+			continue;
+
+		ee_set_eclass_position(ee_state, ec, position);
+
+		old_ctx = MemoryContextSwitchTo(ctx.ee_mcxt);
+
+		eeclass = (EEEClass *) palloc0(sizeof(EEEClass));
+		eeclass->id = position;
+		eeclass->relids = ee_intern_relids(ee_state, ec->ec_relids);
+		eeclass->has_const = ec->ec_has_const;
+
+		MemoryContextSwitchTo(old_ctx);
+
+		foreach(lc2, ec->ec_members)
+		{
+			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
+			char	   *member;
+
+			if (em->em_is_child)
+				continue;
+
+			member = deparse_to_ee(&ctx, em->em_expr);
+
+			old_ctx = MemoryContextSwitchTo(ctx.ee_mcxt);
+			eeclass->members = lappend(eeclass->members, member);
+			MemoryContextSwitchTo(old_ctx);
+		}
+
+		old_ctx = MemoryContextSwitchTo(ctx.ee_mcxt);
+		eesubquery->eclasses = lappend(eesubquery->eclasses, eeclass);
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	/* Имена базовых отношений для всех отношений подзапроса */
+	old_ctx = MemoryContextSwitchTo(ctx.ee_mcxt);
+
+	foreach(lc, eesubquery->eerel_list)
+	{
+		EERel	   *eerel = (EERel *) lfirst(lc);
+
+		eerel->rel_aliases = relids_to_aliases(&ctx, root, eerel->relids);
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+}
@@ -10,6 +10,9 @@
  */
 
 #include "include/output_result.h"
+#include "include/path_nodes.h"
+#include "include/path_keys.h"
+#include "include/path_pack.h"
 
 #include "access/heapam.h"
 #include "access/relation.h"
@@ -23,7 +26,16 @@
 #include "executor/executor.h"
 #include "catalog/namespace.h"
 
-#define NUM_OF_COLS_EEPATHS 24
+#define NUM_OF_COLS_EEQUERY 25
+#define NUM_OF_COLS_EERACE 12
+#define NUM_OF_COLS_EERELS 17
+#define NUM_OF_COLS_EEJOINLEVELS 8
+#define NUM_OF_COLS_EEJOINPAIRS 8
+#define NUM_OF_COLS_EEPARTGROUPS 10
+#define NUM_OF_COLS_EEPRECHECKED 15
+#define NUM_OF_COLS_EEGRAPHRELS 8
+#define NUM_OF_COLS_EEJOINCLAUSES 12
+#define NUM_OF_COLS_EECLASSES 6
 
 static const char * 
 cost_cmp_to_string(PathCostComparison cmp)
@@ -119,7 +131,7 @@ parallel_safe_cmp_to_string(PathParallelSafeComparison cmp)
 	}
 }
 
-static const char * 
+const char *
 add_path_result_to_string(AddPathResult add_path_result)
 {
 	switch (add_path_result)
@@ -135,60 +147,93 @@ add_path_result_to_string(AddPathResult add_path_result)
 	}
 }
 
-/*
- * Получает название узла плана по его NodeTag
- */
 static const char *
-nodetag_to_string(NodeTag pathtype)
+agg_strategy_to_string(AggStrategy aggstrategy)
 {
-	switch (pathtype)
-	{
-		case T_SeqScan:
-			return "SeqScan";
-		case T_IndexScan:
-			return "IndexScan";
-		case T_IndexOnlyScan:
-			return "IndexOnlyScan";
-		case T_BitmapHeapScan:
-			return "BitmapHeapScan";
-		case T_TidScan:
-			return "TidScan";
-		case T_MergeJoin:
-			return "MergeJoin";
-		case T_HashJoin:
-			return "HashJoin";
-		case T_NestLoop:
-			return "NestLoop";
-		case T_Material:
-			return "Material";
-		case T_Memoize:
-			return "Memoize";
-		case T_Result:
-			return "Result";
-		case T_Limit:
-			return "Limit";
-		case T_SubqueryScan:
-			return "SubqueryScan";
-		case T_Agg:
-			return "Agg";
-		case T_Sort:
-			return "Sort";
-		case T_Gather:
-			return "Gather";
-		case T_GatherMerge:
-			return "GatherMerge";
-		case T_Append:
-			return "Append";
-		case T_Unique:
-			return "Unique";
-		case T_CteScan:
-			return "CteScan";
-		case T_WindowAgg:
-			return "WindowAgg";
-		case T_IncrementalSort:
-			return "IncrementalSort";
+	switch (aggstrategy)
+	{
+		case AGG_PLAIN:
+			return "plain";
+		case AGG_SORTED:
+			return "sorted";
+		case AGG_HASHED:
+			return "hashed";
+		case AGG_MIXED:
+			return "mixed";
 		default:
-			return "Unknown";
+			return "unknown";
+	}
+}
+
+static const char *
+join_type_to_string(JoinType jointype)
+{
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			return "inner";
+		case JOIN_LEFT:
+			return "left";
+		case JOIN_FULL:
+			return "full";
+		case JOIN_RIGHT:
+			return "right";
+		case JOIN_SEMI:
+			return "semi";
+		case JOIN_ANTI:
+			return "anti";
+		case JOIN_RIGHT_ANTI:
+			return "right_anti";
+#if (PG_VERSION_NUM >= 180000)
+		case JOIN_RIGHT_SEMI:
+			return "right_semi";
+#endif
+		case JOIN_UNIQUE_OUTER:
+			return "unique_outer";
+		case JOIN_UNIQUE_INNER:
+			return "unique_inner";
+		default:
+			return "unknown";
+	}
+}
+
+static const char *
+upper_stage_to_string(UpperRelationKind stage)
+{
+	switch (stage)
+	{
+		case UPPERREL_SETOP:
+			return "setop";
+		case UPPERREL_PARTIAL_GROUP_AGG:
+			return "partial_group_agg";
+		case UPPERREL_GROUP_AGG:
+			return "group_agg";
+		case UPPERREL_WINDOW:
+			return "window";
+		case UPPERREL_PARTIAL_DISTINCT:
+			return "partial_distinct";
+		case UPPERREL_DISTINCT:
+			return "distinct";
+		case UPPERREL_ORDERED:
+			return "ordered";
+		case UPPERREL_FINAL:
+			return "final";
+		default:
+			return "unknown";
+	}
+}
+
+static const char * 
+plan_kind_to_string(EEPlanKind plan_kind)
+{
+	switch (plan_kind)
+	{
+		case EE_PLAN_GENERIC:
+			return "generic";
+		case EE_PLAN_CUSTOM:
+			return "custom";
+		default:
+			return "unknown";
 	}
 }
 
@@ -210,6 +255,177 @@ get_next_query_id(void)
 	return query_id;
 }
 
+/*
+ * Значения колонок ee.paths для одного пути
+ */
+void
+form_eepath_values(int64 query_id, EEState *ee_state, EESubQuery *eesubquery,
+				   EERel *eerel, EEPath *eepath, Datum *values, bool *nulls)
+{
+	memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEPATHS);
+
+	values[0] = Int64GetDatum(query_id);
+	values[1] = Int64GetDatum(eesubquery->id);
+	values[2] = Int64GetDatum(eesubquery->subquery_level);
+	values[3] = Int64GetDatum(eerel->id);
+	values[4] = Int64GetDatum(eepath->id);
+
+	values[5] = CStringGetTextDatum(plan_type_name(eepath->pathtype));
+
+	if (eepath->nsub == 0)
+	{
+		nulls[6] = true;
+		values[6] = (Datum) 0;
+	}
+	else
+	{
+		Datum	   *sub_ids;
+		int			i;
+
+		sub_ids = (Datum *) palloc(sizeof(Datum) * eepath->nsub);
+
+		for (i = 0; i < eepath->nsub; i++)
+			sub_ids[i] = Int64GetDatum(eepath->sub_eepaths[i]->id);
+
+		nulls[6] = false;
+		values[6] = PointerGetDatum(construct_array(sub_ids,
+													eepath->nsub,
+													INT8OID,
+													8,
+													true,
+													'd'));
+		pfree(sub_ids);
+	}
+
+	values[7] = Float8GetDatum(eepath->startup_cost);
+	values[8] = Float8GetDatum(eepath->total_cost);
+	values[9] = Int64GetDatum(eepath->rows);
+	values[10] = Int64GetDatum(eerel->width);
+
+	if (eerel->name == NULL)
+	{
+		nulls[11] = true;
+	}
+	else
+	{
+		nulls[11] = false;
+		values[11] = CStringGetTextDatum(eerel->name);
+	}
+
+	if (eerel->alias == NULL)
+	{
+		nulls[12] = true;
+	}
+	else
+	{
+		nulls[12] = false;
+		values[12] = CStringGetTextDatum(eerel->alias);
+	}
+
+	if (eepath->indexoid == 0)
+	{
+		nulls[13] = true;
+	}
+	else
+	{
+		nulls[13] = false;
+		values[13] = ObjectIdGetDatum(eepath->indexoid);
+	}
+
+	values[14] = eerel->joined_rel_num;
+
+	values[15] = CStringGetTextDatum(add_path_result_to_string(eepath->add_path_result));
+	
+	if (eepath->add_path_result == APR_DISPLACED)
+	{
+		nulls[16] = false;
+		nulls[17] = false;
+		nulls[18] = false;
+		nulls[19] = false;
+		nulls[20] = false;
+		nulls[21] = false;
+		nulls[22] = false;
+
+		values[16] = Int64GetDatum(eepath->displaced_by);
+		values[17] = CStringGetTextDatum(cost_cmp_to_string(eepath->cost_cmp));
+		values[18] = Float8GetDatum(eepath->fuzz_factor);
+		values[19] = CStringGetTextDatum(pathkeys_cmp_to_string(eepath->pathkeys_cmp));
+		values[20] = CStringGetTextDatum(bms_cmp_to_string(eepath->bms_cmp));
+		values[21] = CStringGetTextDatum(rows_cmp_to_string(eepath->rows_cmp));
+		values[22] = CStringGetTextDatum(parallel_safe_cmp_to_string(eepath->parallel_safe_cmp));
+	}
+	else 
+	{
+		nulls[16] = true;
+		nulls[17] = true;
+		nulls[18] = true;
+		nulls[19] = true;
+		nulls[20] = true;
+		nulls[21] = true;
+		nulls[22] = true;
+	}
+
+	values[23] = Int32GetDatum(eepath->disabled_nodes);
+
+	if (eesubquery->plan_kind == EE_PLAN_DEFAULT)
+	{
+		nulls[24] = true;
+	}
+	else
+	{
+		nulls[24] = false;
+		values[24] = CStringGetTextDatum(plan_kind_to_string(eesubquery->plan_kind));
+	}
+
+	values[25] = BoolGetDatum(eepath->partial);
+	values[26] = BoolGetDatum(eepath->parallel_aware);
+	values[27] = Int32GetDatum(eepath->parallel_workers);
+
+	values[28] = BoolGetDatum(eepath->cheapest_total);
+	values[29] = BoolGetDatum(eepath->cheapest_startup);
+	values[30] = BoolGetDatum(eepath->cheapest_parameterized);
+	values[31] = BoolGetDatum(eepath->in_final_plan);
+
+	if (eepath->in_final_plan)
+	{
+		nulls[32] = false;
+		values[32] = Int32GetDatum(eepath->plan_depth);
+	}
+	else
+		nulls[32] = true;
+
+	if (eepath->pathkeys == NULL)
+		nulls[33] = true;
+	else
+	{
+		nulls[33] = false;
+		values[33] = ee_pathkeys_datum(ee_state, eepath->pathkeys);
+	}
+
+	if (eepath->required_outer == NULL)
+		nulls[34] = true;
+	else
+	{
+		nulls[34] = false;
+		values[34] = ee_relids_datum(eepath->required_outer);
+	}
+
+	if (eepath->num_groups < 0)
+	{
+		nulls[35] = true;
+		nulls[36] = true;
+	}
+	else
+	{
+		nulls[35] = false;
+		nulls[36] = false;
+		values[35] = CStringGetTextDatum(agg_strategy_to_string(eepath->aggstrategy));
+		values[36] = Float8GetDatum(eepath->num_groups);
+	}
+
+	values[37] = Int64GetDatum(eepath->fingerprint);
+}
+
 /*
  * Записывает все пути из ee_state в таблицу ee.paths
  */
@@ -227,8 +443,6 @@ insert_paths_into_eepaths(int64 query_id, EEState *ee_state, bool hide_disabled)
 	ListCell   *eer_lc;
 	ListCell   *eep_lc;
 
-	memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEPATHS);
-
 	estate = CreateExecutorState();
 
 	rel = table_openrv(makeRangeVar("ee", "paths", -1), RowExclusiveLock);
@@ -238,7 +452,7 @@ insert_paths_into_eepaths(int64 query_id, EEState *ee_state, bool hide_disabled)
 		EESubQuery	*eesubquery = (EESubQuery *) lfirst(eesq_lc);
 
 		if (eesubquery->eerel_list == NIL)
-			break;
+			continue;
 
 		foreach(eer_lc, eesubquery->eerel_list)
 		{
@@ -254,144 +468,144 @@ insert_paths_into_eepaths(int64 query_id, EEState *ee_state, bool hide_disabled)
 				/* Get the tuple descriptor for the table */
 				tupdesc = RelationGetDescr(rel);
 
-				values[0] = Int64GetDatum(query_id);
-				values[1] = Int64GetDatum(eesubquery->id);
-				values[2] = Int64GetDatum(eesubquery->subquery_level);
-				values[3] = Int64GetDatum(eerel->id);
-				values[4] = Int64GetDatum(eepath->id);
+				form_eepath_values(query_id, ee_state, eesubquery, eerel,
+								   eepath, values, nulls);
 
-				values[5] = CStringGetTextDatum(nodetag_to_string(eepath->pathtype));
+				/* Создание и вставка тапла */
+				tuple = heap_form_tuple(tupdesc, values, nulls);
+				simple_heap_insert(rel, tuple);
+				heap_freetuple(tuple);
+			}
+		}
+	}
 
-				if (eepath->nsub == 0)
-				{
-					nulls[6] = true;
-					values[6] = (Datum) 0;
+	FreeExecutorState(estate);
+	table_close(rel, RowExclusiveLock);
+}
 
-				}
-				else if (eepath->nsub == 1)
-				{
-					Datum		sub_ids[1];
-
-					nulls[6] = false;
-					sub_ids[0] = Int64GetDatum(eepath->sub_eepath_1->id);
-					values[6] = PointerGetDatum(construct_array(sub_ids,
-																1,
-																INT8OID,
-																8,
-																true,
-																'd'));
-				}
-				else if (eepath->nsub == 2)
-				{
-					Datum		sub_ids[2];
-
-					nulls[6] = false;
-					sub_ids[0] = Int64GetDatum(eepath->sub_eepath_1->id);
-					sub_ids[1] = Int64GetDatum(eepath->sub_eepath_2->id);
-					values[6] = PointerGetDatum(construct_array(sub_ids,
-																2,
-																INT8OID,
-																8,
-																true,
-																'd'));
-				}
+/*
+ * Массив памяти планировщика по подзапросам: i-й элемент соответствует
+ * подзапросу с subquery_id = i. Последний подзапрос в списке создается
+ * заранее, по окончании планирования, и в массив не входит, если не
+ * содержит отношений.
+ */
+static Datum
+subquery_planner_mem_array(EEState *ee_state)
+{
+	Datum	   *elems;
+	int			nelems = 0;
+	ListCell   *lc;
 
-				values[7] = Float8GetDatum(eepath->startup_cost);
-				values[8] = Float8GetDatum(eepath->total_cost);
-				values[9] = Int64GetDatum(eepath->rows);
-				values[10] = Int64GetDatum(eerel->width);
+	elems = (Datum *) palloc(sizeof(Datum) * Max(list_length(ee_state->eesubquery_list), 1));
 
-				if (eerel->name == NULL)
-				{
-					nulls[11] = true;
-				}
-				else
-				{
-					nulls[11] = false;
-					values[11] = CStringGetTextDatum(eerel->name);
-				}
+	foreach(lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(lc);
 
-				if (eerel->alias == NULL)
-				{
-					nulls[12] = true;
-				}
-				else
-				{
-					nulls[12] = false;
-					values[12] = CStringGetTextDatum(eerel->alias);
-				}
+		if (eesubquery->eerel_list == NIL && lnext(ee_state->eesubquery_list, lc) == NULL)
+			break;
 
-				if (eepath->indexoid == 0)
-				{
-					nulls[13] = true;
-				}
-				else
-				{
-					nulls[13] = false;
-					values[13] = ObjectIdGetDatum(eepath->indexoid);
-				}
+		elems[nelems++] = Int64GetDatum((int64) eesubquery->planner_mem);
+	}
 
-				values[14] = eerel->joined_rel_num;
+	return PointerGetDatum(construct_array(elems,
+										   nelems,
+										   INT8OID,
+										   8,
+										   true,
+										   'd'));
+}
 
-				values[15] = CStringGetTextDatum(add_path_result_to_string(eepath->add_path_result));
-				
-				if (eepath->add_path_result == APR_DISPLACED)
-				{
-					nulls[16] = false;
-					nulls[17] = false;
-					nulls[18] = false;
-					nulls[19] = false;
-					nulls[20] = false;
-					nulls[21] = false;
-					nulls[22] = false;
-
-					values[16] = Int64GetDatum(eepath->displaced_by);
-					values[17] = CStringGetTextDatum(cost_cmp_to_string(eepath->cost_cmp));
-					values[18] = Float8GetDatum(eepath->fuzz_factor);
-					values[19] = CStringGetTextDatum(pathkeys_cmp_to_string(eepath->pathkeys_cmp));
-					values[20] = CStringGetTextDatum(bms_cmp_to_string(eepath->bms_cmp));
-					values[21] = CStringGetTextDatum(rows_cmp_to_string(eepath->rows_cmp));
-					values[22] = CStringGetTextDatum(parallel_safe_cmp_to_string(eepath->parallel_safe_cmp));
-				}
-				else 
+/*
+ * Сводка по собранным путям для ee.query
+ */
+typedef struct EECaptureSummary
+{
+	int64		paths_saved;
+	int64		paths_displaced;
+	int64		paths_removed;
+	int64		paths_prechecked;
+	int			rels;
+	int			subqueries;
+	int			max_level;
+
+	/* Стоимость корневого пути плана запроса, -1 -- не определена */
+	Cost		final_plan_cost;
+} EECaptureSummary;
+
+static void
+compute_capture_summary(EEState *ee_state, EECaptureSummary *summary)
+{
+	ListCell   *lc1;
+	ListCell   *lc2;
+	ListCell   *lc3;
+
+	memset(summary, 0, sizeof(EECaptureSummary));
+	summary->final_plan_cost = -1;
+
+	foreach(lc1, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(lc1);
+
+		/* Заранее созданный последний подзапрос без отношений не учитывается */
+		if (eesubquery->eerel_list == NIL && lnext(ee_state->eesubquery_list, lc1) == NULL)
+			break;
+
+		summary->subqueries++;
+
+		foreach(lc2, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(lc2);
+
+			summary->rels++;
+			summary->max_level = Max(summary->max_level, eerel->joined_rel_num);
+			summary->paths_prechecked += list_length(eerel->prechecked_paths);
+
+			foreach(lc3, eerel->eepath_list)
+			{
+				EEPath	   *eepath = (EEPath *) lfirst(lc3);
+
+				switch (eepath->add_path_result)
 				{
-					nulls[16] = true;
-					nulls[17] = true;
-					nulls[18] = true;
-					nulls[19] = true;
-					nulls[20] = true;
-					nulls[21] = true;
-					nulls[22] = true;
+					case APR_SAVED:
+						summary->paths_saved++;
+						break;
+					case APR_DISPLACED:
+						summary->paths_displaced++;
+						break;
+					case APR_REMOVED:
+						summary->paths_removed++;
+						break;
 				}
 
-				values[23] = Int32GetDatum(eepath->disabled_nodes);
-
-				/* Создание и вставка тапла */
-				tuple = heap_form_tuple(tupdesc, values, nulls);
-				simple_heap_insert(rel, tuple);
-				heap_freetuple(tuple);
+				/* Для EXPLAIN EXECUTE берется последний (custom) план */
+				if (eepath->in_final_plan && eepath->plan_depth == 0 &&
+					eesubquery->subquery_level == 1)
+					summary->final_plan_cost = eepath->total_cost;
 			}
 		}
 	}
-
-	FreeExecutorState(estate);
-	table_close(rel, RowExclusiveLock);
 }
 
 /*
- * Записывает информацию о запросе в таблицу ee.query
+ * Записывает информацию о запросе в таблицу ee.query. packed -- пути
+ * упаковываются в ee.query.packed_paths (ee.sink = packed на момент сбора).
  */
 int64
-insert_query_info_into_eequery(const char *queryString)
+insert_query_info_into_eequery(const char *queryString, EEState *ee_state,
+							   bool packed)
 {
 	Relation	rel;
 	TupleDesc	tupdesc;
 	HeapTuple	tuple;
-	Datum		values[3];
-	bool		nulls[3] = {false, false, false};
+	Datum		values[NUM_OF_COLS_EEQUERY];
+	bool		nulls[NUM_OF_COLS_EEQUERY];
 	EState	   *estate;
 	int64		query_id;
 	TimestampTz execution_ts;
+	EECaptureSummary summary;
+
+	memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEQUERY);
 
 	estate = CreateExecutorState();
 
@@ -410,6 +624,81 @@ insert_query_info_into_eequery(const char *queryString)
 
 	values[2] = CStringGetTextDatum(queryString);
 
+	if (ee_state->queryid == 0)
+		nulls[3] = true;
+	else
+		values[3] = Int64GetDatum(ee_state->queryid);
+
+	/* Статистика plancache (только для EXPLAIN EXECUTE) */
+	if (ee_state->plancache_choice == EE_PLAN_DEFAULT)
+	{
+		nulls[4] = true;
+		nulls[5] = true;
+		nulls[6] = true;
+		nulls[7] = true;
+	}
+	else
+	{
+		nulls[4] = ee_state->plancache_generic_cost < 0;
+		values[4] = Float8GetDatum(ee_state->plancache_generic_cost);
+
+		nulls[5] = ee_state->plancache_avg_custom_cost < 0;
+		values[5] = Float8GetDatum(ee_state->plancache_avg_custom_cost);
+
+		values[6] = Int64GetDatum(ee_state->plancache_custom_plans);
+		values[7] = CStringGetTextDatum(plan_kind_to_string(ee_state->plancache_choice));
+	}
+
+	/* Состояние сбора путей и текст ошибки, прервавшей сбор */
+	if (!ee_state->aborted)
+		values[8] = CStringGetTextDatum("completed");
+	else if (ee_state->planning_finished)
+		values[8] = CStringGetTextDatum("execution aborted");
+	else
+		values[8] = CStringGetTextDatum("planning aborted");
+
+	if (ee_state->error_message == NULL)
+		nulls[9] = true;
+	else
+		values[9] = CStringGetTextDatum(ee_state->error_message);
+
+	/* Память планировщика и память, занятая собранными путями */
+	values[10] = Int64GetDatum((int64) ee_state->planner_mem_peak);
+	values[11] = subquery_planner_mem_array(ee_state);
+	values[12] = Int64GetDatum((int64) ee_state->capture_mem);
+
+	/* Сводка по собранным путям */
+	compute_capture_summary(ee_state, &summary);
+
+	values[13] = Int64GetDatum(summary.paths_saved + summary.paths_displaced +
+							   summary.paths_removed);
+	values[14] = Int64GetDatum(summary.paths_saved);
+	values[15] = Int64GetDatum(summary.paths_displaced);
+	values[16] = Int64GetDatum(summary.paths_removed);
+	values[17] = Int64GetDatum(summary.paths_prechecked);
+	values[18] = Int32GetDatum(summary.rels);
+	values[19] = Int32GetDatum(summary.subqueries);
+	values[20] = Int32GetDatum(summary.max_level);
+	values[21] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(ee_state->ee_time));
+
+	/* Время планирования определяется только при выводе плана EXPLAIN */
+	if (INSTR_TIME_IS_ZERO(ee_state->planning_time))
+		nulls[22] = true;
+	else
+		values[22] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(ee_state->planning_time));
+
+	if (summary.final_plan_cost < 0)
+		nulls[23] = true;
+	else
+		values[23] = Float8GetDatum(summary.final_plan_cost);
+
+	/* При ee.sink = packed пути хранятся в самой строке ee.query */
+	if (packed)
+		values[24] = ee_pack_paths(query_id, ee_state,
+								   ee_state->options.hide_disabled);
+	else
+		nulls[24] = true;
+
 	/* Создание и вставка тапла */
 	tuple = heap_form_tuple(tupdesc, values, nulls);
 	simple_heap_insert(rel, tuple);
@@ -420,3 +709,577 @@ insert_query_info_into_eequery(const char *queryString)
 
 	return query_id;
 }
+
+/*
+ * Время в миллисекундах от начала сбора путей до момента time
+ */
+static double
+ms_since_start(instr_time time, EEState *ee_state)
+{
+	INSTR_TIME_SUBTRACT(time, ee_state->start_time);
+
+	return INSTR_TIME_GET_MILLISEC(time);
+}
+
+/*
+ * Значение списка строк для записи в таблицу (text[])
+ */
+static Datum
+string_list_datum(List *strings)
+{
+	Datum	   *elems;
+	ListCell   *lc;
+	int			i = 0;
+	ArrayType  *result;
+
+	elems = (Datum *) palloc(sizeof(Datum) * list_length(strings));
+
+	foreach(lc, strings)
+		elems[i++] = CStringGetTextDatum((char *) lfirst(lc));
+
+	result = construct_array(elems, i, TEXTOID, -1, false, TYPALIGN_INT);
+	pfree(elems);
+
+	return PointerGetDatum(result);
+}
+
+/*
+ * Записывает профиль вызовов add_path всех отношений из ee_state в таблицу
+ * ee.rels
+ */
+void
+insert_rels_into_eerels(int64 query_id, EEState *ee_state)
+{
+	Relation	rel;
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_OF_COLS_EERELS];
+	bool		nulls[NUM_OF_COLS_EERELS];
+	ListCell   *eesq_lc;
+	ListCell   *eer_lc;
+
+	rel = table_openrv(makeRangeVar("ee", "rels", -1), RowExclusiveLock);
+
+	tupdesc = RelationGetDescr(rel);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+
+		foreach(eer_lc, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(eer_lc);
+
+			memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EERELS);
+
+			values[0] = Int64GetDatum(query_id);
+			values[1] = Int64GetDatum(eesubquery->id);
+			values[2] = Int64GetDatum(eerel->id);
+
+			if (eerel->name == NULL)
+				nulls[3] = true;
+			else
+				values[3] = CStringGetTextDatum(eerel->name);
+
+			if (eerel->alias == NULL)
+				nulls[4] = true;
+			else
+				values[4] = CStringGetTextDatum(eerel->alias);
+
+			values[5] = Int32GetDatum(eerel->joined_rel_num);
+			values[6] = Int64GetDatum(eerel->add_path_calls);
+			values[7] = Int32GetDatum(eerel->max_pathlist_len);
+
+			if (eerel->add_path_calls == 0)
+			{
+				nulls[8] = true;
+				nulls[9] = true;
+			}
+			else
+			{
+				values[8] = Float8GetDatum(ms_since_start(eerel->first_add_path, ee_state));
+				values[9] = Float8GetDatum(ms_since_start(eerel->last_add_path, ee_state));
+			}
+
+			values[10] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(eerel->add_path_time));
+			values[11] = Int64GetDatum((int64) eerel->planner_mem);
+			values[12] = Int64GetDatum(eerel->precheck_calls);
+			values[13] = Int32GetDatum(list_length(eerel->prechecked_paths));
+
+			if (eerel->relids == NULL)
+				nulls[14] = true;
+			else
+				values[14] = ee_relids_datum(eerel->relids);
+
+			if (eerel->rel_aliases == NIL)
+				nulls[15] = true;
+			else
+				values[15] = string_list_datum(eerel->rel_aliases);
+
+			if (!eerel->is_upper)
+				nulls[16] = true;
+			else
+				values[16] = CStringGetTextDatum(upper_stage_to_string(eerel->upper_stage));
+
+			tuple = heap_form_tuple(tupdesc, values, nulls);
+			simple_heap_insert(rel, tuple);
+			heap_freetuple(tuple);
+		}
+	}
+
+	table_close(rel, RowExclusiveLock);
+}
+
+/*
+ * Записывает статистику перебора соединений из ee_state в таблицы
+ * ee.join_levels и ee.join_pairs
+ */
+void
+insert_join_search_into_eetables(int64 query_id, EEState *ee_state)
+{
+	Relation	levels_rel;
+	Relation	pairs_rel;
+	HeapTuple	tuple;
+	ListCell   *eesq_lc;
+
+	levels_rel = table_openrv(makeRangeVar("ee", "join_levels", -1), RowExclusiveLock);
+	pairs_rel = table_openrv(makeRangeVar("ee", "join_pairs", -1), RowExclusiveLock);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+		ListCell   *lc1;
+		ListCell   *lc2;
+
+		/* Пары отношений */
+		foreach(lc1, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(lc1);
+
+			foreach(lc2, eerel->join_pairs)
+			{
+				EEJoinPair *pair = (EEJoinPair *) lfirst(lc2);
+				Datum		values[NUM_OF_COLS_EEJOINPAIRS];
+				bool		nulls[NUM_OF_COLS_EEJOINPAIRS];
+
+				memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEJOINPAIRS);
+
+				values[0] = Int64GetDatum(query_id);
+				values[1] = Int64GetDatum(eesubquery->id);
+				values[2] = Int32GetDatum(eerel->joined_rel_num);
+				values[3] = Int64GetDatum(eerel->id);
+				values[4] = Int64GetDatum(pair->rel1->id);
+				values[5] = Int64GetDatum(pair->rel2->id);
+				values[6] = BoolGetDatum(pair->cartesian);
+				values[7] = BoolGetDatum(pair->pruned);
+
+				tuple = heap_form_tuple(RelationGetDescr(pairs_rel), values, nulls);
+				simple_heap_insert(pairs_rel, tuple);
+				heap_freetuple(tuple);
+			}
+		}
+
+		/* Уровни перебора соединений */
+		foreach(lc1, eesubquery->join_levels)
+		{
+			EEJoinLevel *join_level = (EEJoinLevel *) lfirst(lc1);
+			Datum		values[NUM_OF_COLS_EEJOINLEVELS];
+			bool		nulls[NUM_OF_COLS_EEJOINLEVELS];
+			int			npairs = 0;
+			int			ncartesian = 0;
+
+			foreach(lc2, eesubquery->eerel_list)
+			{
+				EERel	   *eerel = (EERel *) lfirst(lc2);
+				ListCell   *lc3;
+
+				if (eerel->joined_rel_num != join_level->level)
+					continue;
+
+				foreach(lc3, eerel->join_pairs)
+				{
+					EEJoinPair *pair = (EEJoinPair *) lfirst(lc3);
+
+					npairs++;
+					if (pair->cartesian)
+						ncartesian++;
+				}
+			}
+
+			memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEJOINLEVELS);
+
+			values[0] = Int64GetDatum(query_id);
+			values[1] = Int64GetDatum(eesubquery->id);
+			values[2] = Int32GetDatum(join_level->level);
+			values[3] = Int32GetDatum(join_level->nrels);
+			values[4] = Int32GetDatum(npairs);
+			values[5] = Int32GetDatum(ncartesian);
+			values[6] = Float8GetDatum(INSTR_TIME_GET_MILLISEC(join_level->time));
+			values[7] = Int64GetDatum((int64) join_level->planner_mem);
+
+			tuple = heap_form_tuple(RelationGetDescr(levels_rel), values, nulls);
+			simple_heap_insert(levels_rel, tuple);
+			heap_freetuple(tuple);
+		}
+	}
+
+	table_close(pairs_rel, RowExclusiveLock);
+	table_close(levels_rel, RowExclusiveLock);
+}
+
+/*
+ * Сравнение стоимостей для qsort
+ */
+static int
+cost_qsort_cmp(const void *a, const void *b)
+{
+	Cost		ca = *(const Cost *) a;
+	Cost		cb = *(const Cost *) b;
+
+	if (ca < cb)
+		return -1;
+	if (ca > cb)
+		return 1;
+	return 0;
+}
+
+/*
+ * Записывает группы секций (режим collapse_partitions) в таблицу
+ * ee.partition_groups
+ */
+void
+insert_partition_groups_into_eepartgroups(int64 query_id, EEState *ee_state)
+{
+	Relation	rel;
+	HeapTuple	tuple;
+	ListCell   *eesq_lc;
+
+	if (!ee_state->options.collapse_partitions)
+		return;
+
+	rel = table_openrv(makeRangeVar("ee", "partition_groups", -1), RowExclusiveLock);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+		ListCell   *lc1;
+
+		foreach(lc1, eesubquery->partition_groups)
+		{
+			EEPartitionGroup *group = (EEPartitionGroup *) lfirst(lc1);
+			Datum		values[NUM_OF_COLS_EEPARTGROUPS];
+			bool		nulls[NUM_OF_COLS_EEPARTGROUPS];
+			int			nchildren = list_length(group->children);
+			Cost	   *costs;
+			Cost		median;
+			ListCell   *lc2;
+			int			i = 0;
+
+			/* Распределение наименьших стоимостей путей секций */
+			costs = (Cost *) palloc(sizeof(Cost) * nchildren);
+
+			foreach(lc2, group->children)
+				costs[i++] = ((EECollapsedRel *) lfirst(lc2))->min_total_cost;
+
+			qsort(costs, nchildren, sizeof(Cost), cost_qsort_cmp);
+
+			if (nchildren % 2 == 1)
+				median = costs[nchildren / 2];
+			else
+				median = (costs[nchildren / 2 - 1] + costs[nchildren / 2]) / 2;
+
+			memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEPARTGROUPS);
+
+			values[0] = Int64GetDatum(query_id);
+			values[1] = Int64GetDatum(eesubquery->id);
+			values[2] = Int64GetDatum(group->parent_eerel->id);
+			values[3] = Int64GetDatum(group->representative->id);
+			values[4] = Int32GetDatum(group->parent_eerel->joined_rel_num);
+			values[5] = Int32GetDatum(nchildren);
+
+			if (group->pruned < 0)
+				nulls[6] = true;
+			else
+				values[6] = Int32GetDatum(group->pruned);
+
+			values[7] = Float8GetDatum(costs[0]);
+			values[8] = Float8GetDatum(median);
+			values[9] = Float8GetDatum(costs[nchildren - 1]);
+
+			tuple = heap_form_tuple(RelationGetDescr(rel), values, nulls);
+			simple_heap_insert(rel, tuple);
+			heap_freetuple(tuple);
+
+			pfree(costs);
+		}
+	}
+
+	table_close(rel, RowExclusiveLock);
+}
+
+/*
+ * Записывает пути, отброшенные add_path_precheck и
+ * add_partial_path_precheck, в таблицу ee.prechecked_paths
+ */
+void
+insert_prechecked_paths_into_eeprechecked(int64 query_id, EEState *ee_state)
+{
+	Relation	rel;
+	HeapTuple	tuple;
+	ListCell   *eesq_lc;
+
+	rel = table_openrv(makeRangeVar("ee", "prechecked_paths", -1), RowExclusiveLock);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+		ListCell   *lc1;
+		ListCell   *lc2;
+
+		foreach(lc1, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(lc1);
+
+			foreach(lc2, eerel->prechecked_paths)
+			{
+				EEPrecheckedPath *prechecked = (EEPrecheckedPath *) lfirst(lc2);
+				Datum		values[NUM_OF_COLS_EEPRECHECKED];
+				bool		nulls[NUM_OF_COLS_EEPRECHECKED];
+
+				memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEPRECHECKED);
+
+				values[0] = Int64GetDatum(query_id);
+				values[1] = Int64GetDatum(eesubquery->id);
+				values[2] = Int64GetDatum(eerel->id);
+				values[3] = Int32GetDatum(eerel->joined_rel_num);
+				values[4] = BoolGetDatum(prechecked->partial);
+
+				if (prechecked->startup_cost < 0)
+					nulls[5] = true;
+				else
+					values[5] = Float8GetDatum(prechecked->startup_cost);
+
+				values[6] = Float8GetDatum(prechecked->total_cost);
+				values[7] = Int32GetDatum(prechecked->disabled_nodes);
+				values[8] = Int32GetDatum(prechecked->npathkeys);
+				values[9] = BoolGetDatum(prechecked->parameterized);
+
+				if (prechecked->dominated_by == NULL)
+					nulls[10] = true;
+				else
+					values[10] = Int64GetDatum(prechecked->dominated_by->id);
+
+				values[11] = CStringGetTextDatum(plan_type_name(prechecked->pathtype));
+				values[12] = CStringGetTextDatum(join_type_to_string(prechecked->jointype));
+				values[13] = Int64GetDatum(prechecked->outer_rel->id);
+				values[14] = Int64GetDatum(prechecked->inner_rel->id);
+
+				tuple = heap_form_tuple(RelationGetDescr(rel), values, nulls);
+				simple_heap_insert(rel, tuple);
+				heap_freetuple(tuple);
+			}
+		}
+	}
+
+	table_close(rel, RowExclusiveLock);
+}
+
+/*
+ * Записывает граф соединений подзапросов в таблицы ee.join_graph_rels,
+ * ee.join_clauses и ee.eclasses
+ */
+void
+insert_join_graph_into_eetables(int64 query_id, EEState *ee_state)
+{
+	Relation	rels_rel;
+	Relation	clauses_rel;
+	Relation	eclasses_rel;
+	HeapTuple	tuple;
+	ListCell   *eesq_lc;
+
+	rels_rel = table_openrv(makeRangeVar("ee", "join_graph_rels", -1), RowExclusiveLock);
+	clauses_rel = table_openrv(makeRangeVar("ee", "join_clauses", -1), RowExclusiveLock);
+	eclasses_rel = table_openrv(makeRangeVar("ee", "eclasses", -1), RowExclusiveLock);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+		ListCell   *lc;
+		int			clause_id = 0;
+
+		foreach(lc, eesubquery->graph_rels)
+		{
+			EEGraphRel *graph_rel = (EEGraphRel *) lfirst(lc);
+			Datum		values[NUM_OF_COLS_EEGRAPHRELS];
+			bool		nulls[NUM_OF_COLS_EEGRAPHRELS];
+
+			memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEGRAPHRELS);
+
+			values[0] = Int64GetDatum(query_id);
+			values[1] = Int64GetDatum(eesubquery->id);
+			values[2] = Int16GetDatum((int16) graph_rel->rtindex);
+
+			if (graph_rel->eerel == NULL)
+				nulls[3] = true;
+			else
+				values[3] = Int64GetDatum(graph_rel->eerel->id);
+
+			if (graph_rel->name == NULL)
+				nulls[4] = true;
+			else
+				values[4] = CStringGetTextDatum(graph_rel->name);
+
+			if (graph_rel->alias == NULL)
+				nulls[5] = true;
+			else
+				values[5] = CStringGetTextDatum(graph_rel->alias);
+
+			values[6] = Float8GetDatum(graph_rel->rows);
+			values[7] = Float8GetDatum(graph_rel->tuples);
+
+			tuple = heap_form_tuple(RelationGetDescr(rels_rel), values, nulls);
+			simple_heap_insert(rels_rel, tuple);
+			heap_freetuple(tuple);
+		}
+
+		foreach(lc, eesubquery->join_clauses)
+		{
+			EEJoinClause *clause = (EEJoinClause *) lfirst(lc);
+			Datum		values[NUM_OF_COLS_EEJOINCLAUSES];
+			bool		nulls[NUM_OF_COLS_EEJOINCLAUSES];
+
+			memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EEJOINCLAUSES);
+
+			values[0] = Int64GetDatum(query_id);
+			values[1] = Int64GetDatum(eesubquery->id);
+			values[2] = Int32GetDatum(++clause_id);
+			values[3] = CStringGetTextDatum(clause->clause);
+
+			if (clause->relids == NULL)
+				nulls[4] = true;
+			else
+				values[4] = ee_relids_datum(clause->relids);
+
+			if (clause->left_relids == NULL)
+				nulls[5] = true;
+			else
+				values[5] = ee_relids_datum(clause->left_relids);
+
+			if (clause->right_relids == NULL)
+				nulls[6] = true;
+			else
+				values[6] = ee_relids_datum(clause->right_relids);
+
+			if (clause->norm_selec < 0)
+				nulls[7] = true;
+			else
+				values[7] = Float8GetDatum(clause->norm_selec);
+
+			if (clause->outer_selec < 0)
+				nulls[8] = true;
+			else
+				values[8] = Float8GetDatum(clause->outer_selec);
+
+			values[9] = BoolGetDatum(clause->pushed_down);
+			values[10] = BoolGetDatum(clause->hashable);
+			values[11] = BoolGetDatum(clause->mergeable);
+
+			tuple = heap_form_tuple(RelationGetDescr(clauses_rel), values, nulls);
+			simple_heap_insert(clauses_rel, tuple);
+			heap_freetuple(tuple);
+		}
+
+		foreach(lc, eesubquery->eclasses)
+		{
+			EEEClass   *eeclass = (EEEClass *) lfirst(lc);
+			Datum		values[NUM_OF_COLS_EECLASSES];
+			bool		nulls[NUM_OF_COLS_EECLASSES];
+
+			memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EECLASSES);
+
+			values[0] = Int64GetDatum(query_id);
+			values[1] = Int64GetDatum(eesubquery->id);
+			values[2] = Int32GetDatum(eeclass->id);
+
+			if (eeclass->members == NIL)
+				nulls[3] = true;
+			else
+				values[3] = string_list_datum(eeclass->members);
+
+			if (eeclass->relids == NULL)
+				nulls[4] = true;
+			else
+				values[4] = ee_relids_datum(eeclass->relids);
+
+			values[5] = BoolGetDatum(eeclass->has_const);
+
+			tuple = heap_form_tuple(RelationGetDescr(eclasses_rel), values, nulls);
+			simple_heap_insert(eclasses_rel, tuple);
+			heap_freetuple(tuple);
+		}
+	}
+
+	table_close(eclasses_rel, RowExclusiveLock);
+	table_close(clauses_rel, RowExclusiveLock);
+	table_close(rels_rel, RowExclusiveLock);
+}
+
+/*
+ * Записывает результат исполнения плана функцией ee.race в таблицу
+ * ee.race_results
+ */
+void
+insert_race_result_into_eerace(int64 query_id, EERaceResult *result)
+{
+	Relation	rel;
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	Datum		values[NUM_OF_COLS_EERACE];
+	bool		nulls[NUM_OF_COLS_EERACE];
+
+	memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_EERACE);
+
+	rel = table_openrv(makeRangeVar("ee", "race_results", -1), RowExclusiveLock);
+
+	tupdesc = RelationGetDescr(rel);
+
+	values[0] = Int64GetDatum(query_id);
+	values[1] = Int32GetDatum(result->rank);
+	values[2] = Int64GetDatum(result->path_id);
+
+	if (result->path_type == NULL)
+		nulls[3] = true;
+	else
+		values[3] = CStringGetTextDatum(result->path_type);
+
+	values[4] = Float8GetDatum(result->estimated_cost);
+
+	if (result->timed_out)
+	{
+		nulls[5] = true;
+		nulls[6] = true;
+		nulls[7] = true;
+		nulls[8] = true;
+	}
+	else
+	{
+		values[5] = Float8GetDatum(result->planned_cost);
+		values[6] = Float8GetDatum(result->planning_time);
+		values[7] = Float8GetDatum(result->execution_time);
+		values[8] = Float8GetDatum(result->actual_rows);
+	}
+
+	values[9] = BoolGetDatum(result->timed_out);
+	values[10] = CStringGetTextDatum(result->plan);
+
+	if (result->timed_out)
+		nulls[11] = true;
+	else
+		values[11] = BoolGetDatum(result->plan_matched);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+	simple_heap_insert(rel, tuple);
+	heap_freetuple(tuple);
+
+	table_close(rel, RowExclusiveLock);
+}
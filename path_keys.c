@@ -0,0 +1,372 @@
+/*-------------------------------------------------------------------------
+ *
+ * path_keys.c
+ *    Компактное представление pathkeys и множеств отношений
+ *
+ * Pathkeys путей и множества отношений (relids, required_outer) хранятся
+ * в виде массивов целых чисел. Одинаковые массивы встречаются у большого
+ * количества путей, поэтому каждое уникальное значение хранится в EEState
+ * один раз, а пути ссылаются на него.
+ *
+ * Pathkey описывается четырьмя числами: номером класса эквивалентности,
+ * семейством операторов сортировки, направлением сортировки (1 -- ASC,
+ * -1 -- DESC) и признаком NULLS FIRST.
+ *
+ * Во время планирования классы эквивалентности нумеруются в порядке первого
+ * появления (ee_eclass_id): PlannerInfo подзапроса из add_path недоступен.
+ * По окончании планирования подзапроса каждому классу сопоставляется его
+ * позиция в root->eq_classes (ee_set_eclass_position), и в таблицы
+ * записывается она: позиция не зависит от порядка перебора путей и
+ * совпадает у разных сборов одного запроса.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/path_keys.h"
+
+#include "access/stratnum.h"
+#include "common/hashfn.h"
+#include "utils/memutils.h"
+
+typedef struct EEEClassHashEntry
+{
+	EquivalenceClass *ec;
+	int			id;
+
+	/* Позиция класса в root->eq_classes (с единицы); 0, пока неизвестна */
+	int			position;
+
+	/* Хеш выражений членов класса (eclass_content_hash) */
+	uint32		content_hash;
+} EEEClassHashEntry;
+
+typedef struct EEIntArrayHashEntry
+{
+	EEIntArray *array;
+} EEIntArrayHashEntry;
+
+/*
+ * Хеш-функция и функция сравнения для таблицы уникальных массивов.
+ * Ключом является указатель на массив, сравнивается же содержимое.
+ */
+static uint32
+int_array_hash(const void *key, Size keysize)
+{
+	const EEIntArray *array = *(EEIntArray *const *) key;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) array->values,
+								   array->n * sizeof(int32)));
+}
+
+static int
+int_array_match(const void *key1, const void *key2, Size keysize)
+{
+	const EEIntArray *array1 = *(EEIntArray *const *) key1;
+	const EEIntArray *array2 = *(EEIntArray *const *) key2;
+
+	if (array1->n != array2->n)
+		return 1;
+
+	return memcmp(array1->values, array2->values, array1->n * sizeof(int32));
+}
+
+/*
+ * Создание таблиц уникальных массивов и классов эквивалентности.
+ * Вызывается в контексте памяти расширения.
+ */
+void
+ee_init_interning(EEState *ee_state)
+{
+	HASHCTL		ctl;
+
+	memset(&ctl, 0, sizeof(HASHCTL));
+	ctl.keysize = sizeof(EEIntArray *);
+	ctl.entrysize = sizeof(EEIntArrayHashEntry);
+	ctl.hash = int_array_hash;
+	ctl.match = int_array_match;
+	ctl.hcxt = CurrentMemoryContext;
+	ee_state->interned_arrays = hash_create("EEIntArray by contents", 64, &ctl,
+											HASH_ELEM | HASH_FUNCTION |
+											HASH_COMPARE | HASH_CONTEXT);
+
+	memset(&ctl, 0, sizeof(HASHCTL));
+	ctl.keysize = sizeof(EquivalenceClass *);
+	ctl.entrysize = sizeof(EEEClassHashEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	ee_state->eclass_ids = hash_create("EquivalenceClass id", 32, &ctl,
+									   HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+
+	ee_state->eclasses = NIL;
+}
+
+/*
+ * Хеш содержимого класса эквивалентности: выражений его членов, кроме
+ * членов дочерних отношений. Члены добавляются в класс при разборе условий
+ * запроса, поэтому, в отличие от указателя на класс и порядка первого
+ * появления класса в pathkeys, хеш совпадает при повторном планировании
+ * того же запроса. Хеши членов складываются, чтобы результат не зависел от
+ * их порядка.
+ */
+static uint32
+eclass_content_hash(EquivalenceClass *ec)
+{
+	uint32		hash = 0;
+	ListCell   *lc;
+
+	foreach(lc, ec->ec_members)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+		char	   *str;
+
+		if (em->em_is_child)
+			continue;
+
+		str = nodeToString(em->em_expr);
+		hash += DatumGetUInt32(hash_any((const unsigned char *) str, strlen(str)));
+		pfree(str);
+	}
+
+	return hash;
+}
+
+/*
+ * Внутренний номер класса эквивалентности. Классы нумеруются с единицы в
+ * порядке первого появления; записи о них сохраняются в ee_state->eclasses.
+ */
+int
+ee_eclass_id(EEState *ee_state, EquivalenceClass *ec)
+{
+	EEEClassHashEntry *entry;
+	bool		found;
+
+	/* Объединенные классы заменяются итоговым */
+	while (ec->ec_merged != NULL)
+		ec = ec->ec_merged;
+
+	entry = (EEEClassHashEntry *) hash_search(ee_state->eclass_ids, &ec,
+											  HASH_ENTER, &found);
+
+	if (!found)
+	{
+		MemoryContext old_ctx;
+
+		entry->content_hash = eclass_content_hash(ec);
+
+		old_ctx = MemoryContextSwitchTo(GetMemoryChunkContext(ee_state));
+
+		ee_state->eclasses = lappend(ee_state->eclasses, entry);
+		entry->id = list_length(ee_state->eclasses);
+		entry->position = 0;
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	return entry->id;
+}
+
+/*
+ * Хеш pathkeys для структурного отпечатка пути (get_path_fingerprint).
+ * Классы эквивалентности представлены хешами своего содержимого, так как
+ * ни внутренние номера, ни позиции в root->eq_classes во время
+ * планирования для этого не годятся: первые зависят от порядка перебора
+ * путей, вторые становятся известны только по окончании планирования
+ * подзапроса.
+ */
+uint64
+ee_pathkeys_hash(EEState *ee_state, List *pathkeys)
+{
+	uint64		hash = 0;
+	ListCell   *lc;
+
+	foreach(lc, pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+		EEEClassHashEntry *entry;
+		int			id = ee_eclass_id(ee_state, pathkey->pk_eclass);
+
+		entry = (EEEClassHashEntry *) list_nth(ee_state->eclasses, id - 1);
+
+		hash = hash_combine64(hash, hash_bytes_uint32_extended(entry->content_hash, 0));
+		hash = hash_combine64(hash, hash_bytes_uint32_extended(pathkey->pk_opfamily, 0));
+#if PG_VERSION_NUM >= 180000
+		hash = hash_combine64(hash, hash_bytes_uint32_extended(pathkey->pk_cmptype, 0));
+#else
+		hash = hash_combine64(hash, hash_bytes_uint32_extended(pathkey->pk_strategy, 0));
+#endif
+		hash = hash_combine64(hash, hash_bytes_uint32_extended(pathkey->pk_nulls_first, 0));
+	}
+
+	return hash;
+}
+
+/*
+ * Позиция класса эквивалентности ec в root->eq_classes подзапроса.
+ * Вызывается по окончании планирования подзапроса для каждого его класса;
+ * классы, не встречавшиеся в pathkeys, пропускаются.
+ */
+void
+ee_set_eclass_position(EEState *ee_state, EquivalenceClass *ec, int position)
+{
+	EEEClassHashEntry *entry;
+
+	entry = (EEEClassHashEntry *) hash_search(ee_state->eclass_ids, &ec,
+											  HASH_FIND, NULL);
+
+	if (entry != NULL)
+		entry->position = position;
+}
+
+/*
+ * Поиск массива в таблице уникальных массивов. Если такого массива еще нет,
+ * в таблицу добавляется его копия. Массив array после вызова не нужен.
+ */
+static EEIntArray *
+intern_int_array(EEState *ee_state, EEIntArray *array)
+{
+	EEIntArrayHashEntry *entry;
+	bool		found;
+
+	entry = (EEIntArrayHashEntry *) hash_search(ee_state->interned_arrays,
+												&array, HASH_ENTER, &found);
+
+	if (!found)
+	{
+		Size		size = offsetof(EEIntArray, values) + array->n * sizeof(int32);
+
+		entry->array = (EEIntArray *) MemoryContextAlloc(GetMemoryChunkContext(ee_state),
+														 size);
+		memcpy(entry->array, array, size);
+	}
+
+	return entry->array;
+}
+
+/*
+ * Компактное представление pathkeys. Для пустого списка возвращает NULL.
+ */
+EEIntArray *
+ee_intern_pathkeys(EEState *ee_state, List *pathkeys)
+{
+	EEIntArray *array;
+	EEIntArray *result;
+	ListCell   *lc;
+	int			i = 0;
+
+	if (pathkeys == NIL)
+		return NULL;
+
+	array = (EEIntArray *) palloc(offsetof(EEIntArray, values) +
+								  list_length(pathkeys) * EE_PATHKEY_WIDTH * sizeof(int32));
+	array->n = list_length(pathkeys) * EE_PATHKEY_WIDTH;
+
+	foreach(lc, pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+
+		array->values[i++] = ee_eclass_id(ee_state, pathkey->pk_eclass);
+		array->values[i++] = (int32) pathkey->pk_opfamily;
+#if PG_VERSION_NUM >= 180000
+		array->values[i++] = pathkey->pk_cmptype == COMPARE_GT ? -1 : 1;
+#else
+		array->values[i++] = pathkey->pk_strategy == BTGreaterStrategyNumber ? -1 : 1;
+#endif
+		array->values[i++] = pathkey->pk_nulls_first ? 1 : 0;
+	}
+
+	result = intern_int_array(ee_state, array);
+	pfree(array);
+
+	return result;
+}
+
+/*
+ * Компактное представление множества отношений (индексы RangeTblEntry).
+ * Для пустого множества возвращает NULL.
+ */
+EEIntArray *
+ee_intern_relids(EEState *ee_state, Relids relids)
+{
+	EEIntArray *array;
+	EEIntArray *result;
+	int			relid = -1;
+	int			i = 0;
+
+	if (bms_is_empty(relids))
+		return NULL;
+
+	array = (EEIntArray *) palloc(offsetof(EEIntArray, values) +
+								  bms_num_members(relids) * sizeof(int32));
+	array->n = bms_num_members(relids);
+
+	while ((relid = bms_next_member(relids, relid)) >= 0)
+		array->values[i++] = relid;
+
+	result = intern_int_array(ee_state, array);
+	pfree(array);
+
+	return result;
+}
+
+/*
+ * Значение pathkeys для записи в таблицу: двумерный массив int[][],
+ * строка которого описывает один pathkey. Внутренние номера классов
+ * эквивалентности заменяются их позициями в root->eq_classes (0, если
+ * планирование подзапроса было прервано).
+ */
+Datum
+ee_pathkeys_datum(EEState *ee_state, EEIntArray *pathkeys)
+{
+	Datum	   *elems;
+	int			dims[2];
+	int			lbs[2] = {1, 1};
+	int			i;
+	ArrayType  *result;
+
+	elems = (Datum *) palloc(sizeof(Datum) * pathkeys->n);
+
+	for (i = 0; i < pathkeys->n; i++)
+	{
+		int32		value = pathkeys->values[i];
+
+		if (i % EE_PATHKEY_WIDTH == 0)
+		{
+			EEEClassHashEntry *entry;
+
+			entry = (EEEClassHashEntry *) list_nth(ee_state->eclasses, value - 1);
+			value = entry->position;
+		}
+
+		elems[i] = Int32GetDatum(value);
+	}
+
+	dims[0] = pathkeys->n / EE_PATHKEY_WIDTH;
+	dims[1] = EE_PATHKEY_WIDTH;
+
+	result = construct_md_array(elems, NULL, 2, dims, lbs,
+								INT4OID, sizeof(int32), true, TYPALIGN_INT);
+	pfree(elems);
+
+	return PointerGetDatum(result);
+}
+
+/*
+ * Значение множества отношений для записи в таблицу (int2[])
+ */
+Datum
+ee_relids_datum(EEIntArray *relids)
+{
+	Datum	   *elems;
+	int			i;
+	ArrayType  *result;
+
+	elems = (Datum *) palloc(sizeof(Datum) * relids->n);
+
+	for (i = 0; i < relids->n; i++)
+		elems[i] = Int16GetDatum((int16) relids->values[i]);
+
+	result = construct_array(elems, relids->n, INT2OID, sizeof(int16), true,
+							 TYPALIGN_SHORT);
+	pfree(elems);
+
+	return PointerGetDatum(result);
+}
@@ -0,0 +1,283 @@
+/*-------------------------------------------------------------------------
+ *
+ * path_nodes.c
+ *    Сведения об узлах путей планировщика
+ *
+ * Дочерние пути и названия узлов определяются по статическим таблицам,
+ * индексируемым NodeTag. Для каждого типа пути таблица хранит смещения
+ * полей с дочерними путями (Path *) и поля со списком дочерних путей
+ * (List *), что позволяет обходить пути любого типа без отдельной ветки
+ * для каждого из них.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/path_nodes.h"
+#include "include/path_keys.h"
+
+#include "common/hashfn.h"
+#include "nodes/bitmapset.h"
+#include "nodes/pg_list.h"
+
+/*
+ * Расположение дочерних путей в узле пути.
+ *
+ * Смещение 0 означает отсутствие поля: все поля с дочерними путями следуют
+ * за заголовком Path.
+ */
+typedef struct EEPathChildren
+{
+	/* Поля с одним дочерним путем (значение поля может быть NULL) */
+	uint16		field[2];
+
+	/* Поле со списком дочерних путей */
+	uint16		list;
+} EEPathChildren;
+
+#define SUBPATH(type) \
+	{{offsetof(type, subpath), 0}, 0}
+#define SUBPATH_PAIR(type, f1, f2) \
+	{{offsetof(type, f1), offsetof(type, f2)}, 0}
+#define SUBPATH_LIST(type, f) \
+	{{0, 0}, offsetof(type, f)}
+
+/*
+ * Дочерние пути по типу узла пути. Типы, отсутствующие в таблице
+ * (сканирования, IndexPath, TidPath, GroupResultPath), не имеют дочерних
+ * путей. Пути MinMaxAggPath строятся для отдельных подзапросов
+ * (MinMaxAggInfo->subroot) и дочерними не считаются.
+ */
+static const EEPathChildren path_children[] = {
+	[T_BitmapHeapPath] = {{offsetof(BitmapHeapPath, bitmapqual), 0}, 0},
+	[T_BitmapAndPath] = SUBPATH_LIST(BitmapAndPath, bitmapquals),
+	[T_BitmapOrPath] = SUBPATH_LIST(BitmapOrPath, bitmapquals),
+	[T_SubqueryScanPath] = SUBPATH(SubqueryScanPath),
+	[T_ForeignPath] = {{offsetof(ForeignPath, fdw_outerpath), 0}, 0},
+	[T_CustomPath] = SUBPATH_LIST(CustomPath, custom_paths),
+	[T_NestPath] = SUBPATH_PAIR(JoinPath, outerjoinpath, innerjoinpath),
+	[T_MergePath] = SUBPATH_PAIR(JoinPath, outerjoinpath, innerjoinpath),
+	[T_HashPath] = SUBPATH_PAIR(JoinPath, outerjoinpath, innerjoinpath),
+	[T_AppendPath] = SUBPATH_LIST(AppendPath, subpaths),
+	[T_MergeAppendPath] = SUBPATH_LIST(MergeAppendPath, subpaths),
+	[T_MaterialPath] = SUBPATH(MaterialPath),
+	[T_MemoizePath] = SUBPATH(MemoizePath),
+#if (PG_VERSION_NUM < 190000)
+	[T_UniquePath] = SUBPATH(UniquePath),
+#endif
+	[T_GatherPath] = SUBPATH(GatherPath),
+	[T_GatherMergePath] = SUBPATH(GatherMergePath),
+	[T_ProjectionPath] = SUBPATH(ProjectionPath),
+	[T_ProjectSetPath] = SUBPATH(ProjectSetPath),
+	[T_SortPath] = SUBPATH(SortPath),
+	[T_IncrementalSortPath] = {{offsetof(IncrementalSortPath, spath.subpath), 0}, 0},
+	[T_GroupPath] = SUBPATH(GroupPath),
+	[T_UpperUniquePath] = SUBPATH(UpperUniquePath),
+	[T_AggPath] = SUBPATH(AggPath),
+	[T_GroupingSetsPath] = SUBPATH(GroupingSetsPath),
+	[T_WindowAggPath] = SUBPATH(WindowAggPath),
+#if (PG_VERSION_NUM >= 180000)
+	[T_SetOpPath] = SUBPATH_PAIR(SetOpPath, leftpath, rightpath),
+#else
+	[T_SetOpPath] = SUBPATH(SetOpPath),
+#endif
+	[T_RecursiveUnionPath] = SUBPATH_PAIR(RecursiveUnionPath, leftpath, rightpath),
+	[T_LockRowsPath] = SUBPATH(LockRowsPath),
+	[T_ModifyTablePath] = SUBPATH(ModifyTablePath),
+	[T_LimitPath] = SUBPATH(LimitPath),
+};
+
+/*
+ * Названия узлов плана по типу узла (Path->pathtype)
+ */
+static const char *const plan_type_names[] = {
+	[T_Result] = "Result",
+	[T_ProjectSet] = "ProjectSet",
+	[T_ModifyTable] = "ModifyTable",
+	[T_Append] = "Append",
+	[T_MergeAppend] = "MergeAppend",
+	[T_RecursiveUnion] = "RecursiveUnion",
+	[T_BitmapAnd] = "BitmapAnd",
+	[T_BitmapOr] = "BitmapOr",
+	[T_SeqScan] = "SeqScan",
+	[T_SampleScan] = "SampleScan",
+	[T_IndexScan] = "IndexScan",
+	[T_IndexOnlyScan] = "IndexOnlyScan",
+	[T_BitmapIndexScan] = "BitmapIndexScan",
+	[T_BitmapHeapScan] = "BitmapHeapScan",
+	[T_TidScan] = "TidScan",
+	[T_TidRangeScan] = "TidRangeScan",
+	[T_SubqueryScan] = "SubqueryScan",
+	[T_FunctionScan] = "FunctionScan",
+	[T_ValuesScan] = "ValuesScan",
+	[T_TableFuncScan] = "TableFuncScan",
+	[T_CteScan] = "CteScan",
+	[T_NamedTuplestoreScan] = "NamedTuplestoreScan",
+	[T_WorkTableScan] = "WorkTableScan",
+	[T_ForeignScan] = "ForeignScan",
+	[T_CustomScan] = "CustomScan",
+	[T_NestLoop] = "NestLoop",
+	[T_MergeJoin] = "MergeJoin",
+	[T_HashJoin] = "HashJoin",
+	[T_Material] = "Material",
+	[T_Memoize] = "Memoize",
+	[T_Sort] = "Sort",
+	[T_IncrementalSort] = "IncrementalSort",
+	[T_Group] = "Group",
+	[T_Agg] = "Agg",
+	[T_WindowAgg] = "WindowAgg",
+	[T_Unique] = "Unique",
+	[T_Gather] = "Gather",
+	[T_GatherMerge] = "GatherMerge",
+	[T_Hash] = "Hash",
+	[T_SetOp] = "SetOp",
+	[T_LockRows] = "LockRows",
+	[T_Limit] = "Limit",
+};
+
+/*
+ * Описание дочерних путей узла, NULL -- дочерних путей нет
+ */
+static inline const EEPathChildren *
+path_children_of(Path *path)
+{
+	NodeTag		tag = nodeTag(path);
+	const EEPathChildren *children;
+
+	if ((size_t) tag >= lengthof(path_children))
+		return NULL;
+
+	children = &path_children[tag];
+
+	if (children->field[0] == 0 && children->list == 0)
+		return NULL;
+
+	return children;
+}
+
+#define PATH_FIELD(path, offset) \
+	(*(Path **) ((char *) (path) + (offset)))
+#define PATH_LIST(path, offset) \
+	(*(List **) ((char *) (path) + (offset)))
+
+/*
+ * Функция получения количества дочерних путей у указанного пути.
+ */
+int
+get_subpath_num(Path *path)
+{
+	const EEPathChildren *children = path_children_of(path);
+	int			subpath_num = 0;
+	int			i;
+
+	if (children == NULL)
+		return 0;
+
+	for (i = 0; i < lengthof(children->field) && children->field[i] != 0; i++)
+	{
+		if (PATH_FIELD(path, children->field[i]) != NULL)
+			subpath_num++;
+	}
+
+	if (children->list != 0)
+		subpath_num += list_length(PATH_LIST(path, children->list));
+
+	return subpath_num;
+}
+
+/*
+ * Получение n-го дочернего пути (нумерация с нуля, n < get_subpath_num(path)).
+ *
+ * Для путей соединения первым идет внешний путь, для путей со списком
+ * дочерних путей -- элементы списка по порядку.
+ */
+Path *
+get_subpath(Path *path, int n)
+{
+	const EEPathChildren *children = path_children_of(path);
+	int			i;
+
+	Assert(children != NULL);
+
+	for (i = 0; i < lengthof(children->field) && children->field[i] != 0; i++)
+	{
+		Path	   *subpath = PATH_FIELD(path, children->field[i]);
+
+		if (subpath == NULL)
+			continue;
+
+		if (n == 0)
+			return subpath;
+		n--;
+	}
+
+	return (Path *) list_nth(PATH_LIST(path, children->list), n);
+}
+
+/*
+ * Получает название узла плана по его NodeTag
+ */
+const char *
+plan_type_name(NodeTag pathtype)
+{
+	if ((size_t) pathtype >= lengthof(plan_type_names) ||
+		plan_type_names[pathtype] == NULL)
+		return "Unknown";
+
+	return plan_type_names[pathtype];
+}
+
+static uint64
+fingerprint_add(uint64 hash, uint32 value)
+{
+	return hash_combine64(hash, hash_bytes_uint32_extended(value, 0));
+}
+
+/*
+ * Характеристики одного узла пути, входящие в отпечаток. Классы
+ * эквивалентности pathkeys учитываются по содержимому (ee_pathkeys_hash),
+ * которое, в отличие от указателей на классы и их номеров, совпадает при
+ * повторном планировании того же запроса.
+ */
+static uint64
+fingerprint_node(uint64 hash, EEState *ee_state, Path *path)
+{
+	hash = fingerprint_add(hash, (uint32) path->pathtype);
+	hash = fingerprint_add(hash, bms_hash_value(path->parent->relids));
+	hash = fingerprint_add(hash, bms_hash_value(PATH_REQ_OUTER(path)));
+	hash = fingerprint_add(hash, path->parallel_aware);
+
+	if (path->pathkeys != NIL)
+		hash = hash_combine64(hash, ee_pathkeys_hash(ee_state, path->pathkeys));
+
+	if (path->type == T_IndexPath)
+		hash = fingerprint_add(hash, ((IndexPath *) path)->indexinfo->indexoid);
+	else if (IsA(path, NestPath) || IsA(path, MergePath) || IsA(path, HashPath))
+		hash = fingerprint_add(hash, ((JoinPath *) path)->jointype);
+
+	return hash;
+}
+
+/*
+ * Структурный отпечаток пути: тип узла, множество соединяемых отношений,
+ * параметризация (PATH_REQ_OUTER), pathkeys, индекс, тип соединения,
+ * признак parallel_aware и те же характеристики дочерних путей в порядке
+ * get_subpath. В отличие от стоимостей, отпечаток не меняется при
+ * изменении статистики и параметров стоимости.
+ *
+ * Старший бит сбрасывается, чтобы отпечаток был неотрицательным значением
+ * bigint (ee.paths.fingerprint) и мог быть задан в ee.fixate_paths.
+ */
+int64
+get_path_fingerprint(EEState *ee_state, Path *path)
+{
+	uint64		hash = fingerprint_node(0, ee_state, path);
+	int			subpath_num = get_subpath_num(path);
+	int			i;
+
+	hash = fingerprint_add(hash, subpath_num);
+
+	for (i = 0; i < subpath_num; i++)
+		hash = fingerprint_node(hash, ee_state, get_subpath(path, i));
+
+	return (int64) (hash & PG_INT64_MAX);
+}
@@ -0,0 +1,754 @@
+/*-------------------------------------------------------------------------
+ *
+ * path_pack.c
+ *    Упакованное хранение путей в ee.query
+ *
+ * При ee.sink = packed пути EXPLAIN запроса записываются не строками
+ * ee.paths, а одним значением bytea в колонке ee.query.packed_paths: вместо
+ * вставки кортежа на каждый путь выполняется одна запись в TOAST.
+ * Функция ee.unpack_paths(query_id) восстанавливает строки с колонками
+ * ee.paths.
+ *
+ * Пути кодируются по колонкам ee.paths (кроме query_id, который известен
+ * из ee.query). Колонка начинается с битовой карты NULL (бит на путь), за
+ * которой следуют непустые значения:
+ *
+ *   целые числа -- разность с предыдущим значением колонки (zigzag varint);
+ *     идентификаторы путей и отношений растут, поэтому разности малы;
+ *   float8 -- 8 байт;
+ *   bool -- 1 байт;
+ *   text -- номер строки в словаре колонки (varint); номер, равный размеру
+ *     словаря, добавляет в словарь строку, записанную следом (длина и байты);
+ *   массивы целых чисел -- количество и размеры измерений, затем элементы в
+ *     виде разностей с предыдущим элементом.
+ *
+ * Закодированные колонки сжимаются pglz. Сжатые данные предваряются
+ * заголовком EEPackHeader. Колонка packed_paths имеет STORAGE EXTERNAL,
+ * чтобы TOAST не пытался сжать их повторно.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/path_pack.h"
+#include "include/output_result.h"
+
+#include "access/table.h"
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "common/pg_lzcompress.h"
+#include "executor/spi.h"
+#include "funcapi.h"
+#include "nodes/makefuncs.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+/* Версия формата кодирования колонок */
+#define EE_PACK_VERSION 1
+
+/* Метод сжатия */
+#define EE_PACK_RAW		0
+#define EE_PACK_PGLZ	1
+
+typedef struct EEPackHeader
+{
+	int32		rawsize;		/* размер закодированных колонок до сжатия */
+	int32		method;
+} EEPackHeader;
+
+/*
+ * Колонка ee.paths при упаковке
+ */
+typedef struct EEPackColumn
+{
+	Oid			typid;
+
+	/* Тип элементов для массивов, иначе InvalidOid */
+	Oid			elemtype;
+
+	StringInfoData nullmap;
+	StringInfoData data;
+
+	/* Предыдущее значение целочисленной колонки */
+	int64		prev;
+
+	/* Словарь text колонки: номера строк по их содержимому */
+	HTAB	   *dict;
+	int			ndict;
+} EEPackColumn;
+
+typedef struct EEPackDictEntry
+{
+	text	   *value;
+	int			index;
+} EEPackDictEntry;
+
+/*
+ * Колонка ee.paths при распаковке
+ */
+typedef struct EEUnpackColumn
+{
+	Oid			typid;
+	Oid			elemtype;
+	int16		elemlen;
+	bool		elembyval;
+	char		elemalign;
+
+	const uint8 *nullmap;
+	const char *pos;
+	const char *end;
+
+	int64		prev;
+	List	   *dict;
+} EEUnpackColumn;
+
+static void
+pack_uvarint(StringInfo buf, uint64 value)
+{
+	while (value >= 0x80)
+	{
+		appendStringInfoChar(buf, (char) ((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	appendStringInfoChar(buf, (char) value);
+}
+
+/*
+ * Знаковые числа кодируются zigzag: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+ */
+static void
+pack_varint(StringInfo buf, int64 value)
+{
+	pack_uvarint(buf, ((uint64) value << 1) ^ (uint64) (value >> 63));
+}
+
+static void
+pack_corrupted(void)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_DATA_CORRUPTED),
+			 errmsg("packed paths are corrupted")));
+}
+
+static uint64
+unpack_uvarint(const char **pos, const char *end)
+{
+	uint64		value = 0;
+	int			shift = 0;
+
+	for (;;)
+	{
+		uint8		byte;
+
+		if (*pos >= end || shift > 63)
+			pack_corrupted();
+
+		byte = (uint8) *(*pos)++;
+		value |= (uint64) (byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0)
+			return value;
+
+		shift += 7;
+	}
+}
+
+static int64
+unpack_varint(const char **pos, const char *end)
+{
+	uint64		value = unpack_uvarint(pos, end);
+
+	return (int64) (value >> 1) ^ -(int64) (value & 1);
+}
+
+static const char *
+unpack_bytes(const char **pos, const char *end, Size len)
+{
+	const char *bytes = *pos;
+
+	if (end - *pos < len)
+		pack_corrupted();
+
+	*pos += len;
+
+	return bytes;
+}
+
+static int64
+int_datum_value(Datum value, Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+			return DatumGetInt16(value);
+		case INT4OID:
+			return DatumGetInt32(value);
+		case OIDOID:
+			return DatumGetObjectId(value);
+		default:
+			return DatumGetInt64(value);
+	}
+}
+
+static Datum
+int_value_datum(int64 value, Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+			return Int16GetDatum((int16) value);
+		case INT4OID:
+			return Int32GetDatum((int32) value);
+		case OIDOID:
+			return ObjectIdGetDatum((Oid) value);
+		default:
+			return Int64GetDatum(value);
+	}
+}
+
+static bool
+is_int_type(Oid typid)
+{
+	return typid == INT2OID || typid == INT4OID || typid == INT8OID ||
+		typid == OIDOID;
+}
+
+/*
+ * Проверка типа колонки ee.paths. Для массивов возвращает тип элементов.
+ */
+static Oid
+check_column_type(Form_pg_attribute attr)
+{
+	Oid			elemtype = get_element_type(attr->atttypid);
+
+	if (OidIsValid(elemtype) ? is_int_type(elemtype) :
+		(is_int_type(attr->atttypid) || attr->atttypid == FLOAT8OID ||
+		 attr->atttypid == BOOLOID || attr->atttypid == TEXTOID))
+		return elemtype;
+
+	elog(ERROR, "column \"%s\" of ee.paths has unsupported type %u",
+		 NameStr(attr->attname), attr->atttypid);
+	return InvalidOid;			/* keep compiler quiet */
+}
+
+/*
+ * Хеш-функция и функция сравнения для словаря text колонки.
+ * Ключом является указатель на строку, сравнивается же содержимое.
+ */
+static uint32
+dict_text_hash(const void *key, Size keysize)
+{
+	const text *str = *(text *const *) key;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) VARDATA_ANY(str),
+								   VARSIZE_ANY_EXHDR(str)));
+}
+
+static int
+dict_text_match(const void *key1, const void *key2, Size keysize)
+{
+	const text *str1 = *(text *const *) key1;
+	const text *str2 = *(text *const *) key2;
+	Size		len = VARSIZE_ANY_EXHDR(str1);
+
+	if (VARSIZE_ANY_EXHDR(str2) != len)
+		return 1;
+
+	return memcmp(VARDATA_ANY(str1), VARDATA_ANY(str2), len);
+}
+
+/*
+ * Создание словаря text колонки в текущем контексте памяти
+ */
+static void
+init_pack_dict(EEPackColumn *col)
+{
+	HASHCTL		ctl;
+
+	memset(&ctl, 0, sizeof(HASHCTL));
+	ctl.keysize = sizeof(text *);
+	ctl.entrysize = sizeof(EEPackDictEntry);
+	ctl.hash = dict_text_hash;
+	ctl.match = dict_text_match;
+	ctl.hcxt = CurrentMemoryContext;
+	col->dict = hash_create("ee pack paths dictionary", 64, &ctl,
+							HASH_ELEM | HASH_FUNCTION | HASH_COMPARE |
+							HASH_CONTEXT);
+	col->ndict = 0;
+}
+
+static void
+pack_text(EEPackColumn *col, Datum value, MemoryContext ctx)
+{
+	text	   *str = DatumGetTextPP(value);
+	Size		len = VARSIZE_ANY_EXHDR(str);
+	EEPackDictEntry *entry;
+	bool		found;
+
+	entry = (EEPackDictEntry *) hash_search(col->dict, &str, HASH_ENTER,
+											&found);
+
+	if (!found)
+	{
+		MemoryContext old_ctx = MemoryContextSwitchTo(ctx);
+
+		/* Ключ должен пережить строку, которая освобождается после пути */
+		entry->value = cstring_to_text_with_len(VARDATA_ANY(str), len);
+		entry->index = col->ndict++;
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	pack_uvarint(&col->data, entry->index);
+
+	if (!found)
+	{
+		pack_uvarint(&col->data, len);
+		appendBinaryStringInfo(&col->data, VARDATA_ANY(str), len);
+	}
+}
+
+static void
+pack_array(EEPackColumn *col, Datum value)
+{
+	ArrayType  *arr = DatumGetArrayTypeP(value);
+	Datum	   *elems;
+	bool	   *elem_nulls;
+	int			nelems;
+	int64		prev = 0;
+	int			i;
+
+	deconstruct_array_builtin(arr, col->elemtype, &elems, &elem_nulls, &nelems);
+
+	pack_uvarint(&col->data, ARR_NDIM(arr));
+	for (i = 0; i < ARR_NDIM(arr); i++)
+		pack_uvarint(&col->data, ARR_DIMS(arr)[i]);
+
+	for (i = 0; i < nelems; i++)
+	{
+		int64		elem = int_datum_value(elems[i], col->elemtype);
+
+		pack_varint(&col->data, elem - prev);
+		prev = elem;
+	}
+}
+
+static void
+pack_value(EEPackColumn *col, Datum value, MemoryContext ctx)
+{
+	if (OidIsValid(col->elemtype))
+		pack_array(col, value);
+	else if (col->typid == FLOAT8OID)
+	{
+		float8		f = DatumGetFloat8(value);
+
+		appendBinaryStringInfo(&col->data, &f, sizeof(float8));
+	}
+	else if (col->typid == BOOLOID)
+		appendStringInfoChar(&col->data, DatumGetBool(value) ? 1 : 0);
+	else if (col->typid == TEXTOID)
+		pack_text(col, value, ctx);
+	else
+	{
+		int64		v = int_datum_value(value, col->typid);
+
+		pack_varint(&col->data, v - col->prev);
+		col->prev = v;
+	}
+}
+
+/*
+ * Упаковка путей из ee_state в значение bytea для ee.query.packed_paths
+ */
+Datum
+ee_pack_paths(int64 query_id, EEState *ee_state, bool hide_disabled)
+{
+	MemoryContext pack_ctx;
+	MemoryContext row_ctx;
+	MemoryContext old_ctx;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	EEPackColumn *columns;
+	StringInfoData raw;
+	EEPackHeader header;
+	bytea	   *result;
+	char	   *dest;
+	int32		len;
+	int64		npaths = 0;
+	int			i;
+	ListCell   *eesq_lc;
+	ListCell   *eer_lc;
+	ListCell   *eep_lc;
+
+	pack_ctx = AllocSetContextCreate(CurrentMemoryContext,
+									 "ee pack paths",
+									 ALLOCSET_DEFAULT_SIZES);
+	row_ctx = AllocSetContextCreate(pack_ctx,
+									"ee pack paths row",
+									ALLOCSET_DEFAULT_SIZES);
+	old_ctx = MemoryContextSwitchTo(pack_ctx);
+
+	rel = table_openrv(makeRangeVar("ee", "paths", -1), AccessShareLock);
+	tupdesc = RelationGetDescr(rel);
+
+	if (tupdesc->natts != NUM_OF_COLS_EEPATHS)
+		elog(ERROR, "ee.paths has %d columns, expected %d",
+			 tupdesc->natts, NUM_OF_COLS_EEPATHS);
+
+	columns = (EEPackColumn *) palloc0(sizeof(EEPackColumn) * NUM_OF_COLS_EEPATHS);
+
+	/* Колонка query_id не упаковывается */
+	for (i = 1; i < NUM_OF_COLS_EEPATHS; i++)
+	{
+		columns[i].typid = TupleDescAttr(tupdesc, i)->atttypid;
+		columns[i].elemtype = check_column_type(TupleDescAttr(tupdesc, i));
+		initStringInfo(&columns[i].nullmap);
+		initStringInfo(&columns[i].data);
+		if (columns[i].typid == TEXTOID)
+			init_pack_dict(&columns[i]);
+	}
+
+	table_close(rel, AccessShareLock);
+
+	MemoryContextSwitchTo(row_ctx);
+
+	foreach(eesq_lc, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(eesq_lc);
+
+		foreach(eer_lc, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(eer_lc);
+
+			foreach(eep_lc, eerel->eepath_list)
+			{
+				EEPath	   *eepath = (EEPath *) lfirst(eep_lc);
+				Datum		values[NUM_OF_COLS_EEPATHS];
+				bool		nulls[NUM_OF_COLS_EEPATHS];
+
+				if (eepath->disabled_nodes != 0 && hide_disabled)
+					continue;
+
+				form_eepath_values(query_id, ee_state, eesubquery, eerel,
+								   eepath, values, nulls);
+
+				for (i = 1; i < NUM_OF_COLS_EEPATHS; i++)
+				{
+					EEPackColumn *col = &columns[i];
+
+					if (npaths % 8 == 0)
+						appendStringInfoChar(&col->nullmap, 0);
+
+					if (nulls[i])
+						col->nullmap.data[npaths / 8] |= 1 << (npaths % 8);
+					else
+						pack_value(col, values[i], pack_ctx);
+				}
+
+				npaths++;
+				MemoryContextReset(row_ctx);
+			}
+		}
+	}
+
+	MemoryContextSwitchTo(pack_ctx);
+
+	initStringInfo(&raw);
+	pack_uvarint(&raw, EE_PACK_VERSION);
+	pack_uvarint(&raw, npaths);
+	pack_uvarint(&raw, NUM_OF_COLS_EEPATHS);
+
+	for (i = 1; i < NUM_OF_COLS_EEPATHS; i++)
+	{
+		EEPackColumn *col = &columns[i];
+
+		pack_uvarint(&raw, col->typid);
+		pack_uvarint(&raw, col->nullmap.len + col->data.len);
+		appendBinaryStringInfo(&raw, col->nullmap.data, col->nullmap.len);
+		appendBinaryStringInfo(&raw, col->data.data, col->data.len);
+	}
+
+	MemoryContextSwitchTo(old_ctx);
+
+	result = (bytea *) palloc0(VARHDRSZ + sizeof(EEPackHeader) +
+							   PGLZ_MAX_OUTPUT(raw.len));
+	dest = VARDATA(result) + sizeof(EEPackHeader);
+
+	header.rawsize = raw.len;
+	header.method = EE_PACK_PGLZ;
+
+	len = pglz_compress(raw.data, raw.len, dest, PGLZ_strategy_always);
+	if (len < 0)
+	{
+		/* Данные не сжимаются */
+		header.method = EE_PACK_RAW;
+		memcpy(dest, raw.data, raw.len);
+		len = raw.len;
+	}
+
+	memcpy(VARDATA(result), &header, sizeof(EEPackHeader));
+	SET_VARSIZE(result, VARHDRSZ + sizeof(EEPackHeader) + len);
+
+	MemoryContextDelete(pack_ctx);
+
+	return PointerGetDatum(result);
+}
+
+static Datum
+unpack_text(EEUnpackColumn *col, MemoryContext ctx)
+{
+	uint64		index = unpack_uvarint(&col->pos, col->end);
+
+	if (index == list_length(col->dict))
+	{
+		MemoryContext old_ctx = MemoryContextSwitchTo(ctx);
+		uint64		len = unpack_uvarint(&col->pos, col->end);
+		const char *bytes = unpack_bytes(&col->pos, col->end, len);
+
+		col->dict = lappend(col->dict, cstring_to_text_with_len(bytes, len));
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+	else if (index > list_length(col->dict))
+		pack_corrupted();
+
+	return PointerGetDatum(list_nth(col->dict, index));
+}
+
+static Datum
+unpack_array(EEUnpackColumn *col)
+{
+	int			ndims = (int) unpack_uvarint(&col->pos, col->end);
+	int			dims[MAXDIM];
+	int			lbs[MAXDIM];
+	int			nelems = 1;
+	Datum	   *elems;
+	int64		prev = 0;
+	int			i;
+
+	if (ndims < 0 || ndims > MAXDIM)
+		pack_corrupted();
+
+	if (ndims == 0)
+		return PointerGetDatum(construct_empty_array(col->elemtype));
+
+	for (i = 0; i < ndims; i++)
+	{
+		uint64		dim = unpack_uvarint(&col->pos, col->end);
+
+		/* Каждый элемент занимает хотя бы один байт */
+		if (dim == 0 || (uint64) nelems * dim > (uint64) (col->end - col->pos))
+			pack_corrupted();
+
+		dims[i] = (int) dim;
+		lbs[i] = 1;
+		nelems *= dims[i];
+	}
+
+	elems = (Datum *) palloc(sizeof(Datum) * nelems);
+
+	for (i = 0; i < nelems; i++)
+	{
+		prev += unpack_varint(&col->pos, col->end);
+		elems[i] = int_value_datum(prev, col->elemtype);
+	}
+
+	return PointerGetDatum(construct_md_array(elems, NULL, ndims, dims, lbs,
+											  col->elemtype, col->elemlen,
+											  col->elembyval, col->elemalign));
+}
+
+static Datum
+unpack_value(EEUnpackColumn *col, MemoryContext ctx)
+{
+	if (OidIsValid(col->elemtype))
+		return unpack_array(col);
+	else if (col->typid == FLOAT8OID)
+	{
+		float8		f;
+
+		memcpy(&f, unpack_bytes(&col->pos, col->end, sizeof(float8)), sizeof(float8));
+		return Float8GetDatum(f);
+	}
+	else if (col->typid == BOOLOID)
+		return BoolGetDatum(*unpack_bytes(&col->pos, col->end, 1) != 0);
+	else if (col->typid == TEXTOID)
+		return unpack_text(col, ctx);
+	else
+	{
+		col->prev += unpack_varint(&col->pos, col->end);
+		return int_value_datum(col->prev, col->typid);
+	}
+}
+
+/*
+ * Распаковка путей в tuplestore функции
+ */
+static void
+unpack_paths(ReturnSetInfo *rsinfo, int64 query_id, bytea *packed)
+{
+	TupleDesc	tupdesc = rsinfo->setDesc;
+	MemoryContext row_ctx;
+	MemoryContext old_ctx;
+	EEPackHeader header;
+	EEUnpackColumn *columns;
+	const char *src;
+	Size		srclen;
+	char	   *raw;
+	const char *pos;
+	const char *end;
+	uint64		npaths;
+	uint64		row;
+	int			i;
+
+	if (VARSIZE_ANY_EXHDR(packed) < sizeof(EEPackHeader))
+		pack_corrupted();
+
+	memcpy(&header, VARDATA_ANY(packed), sizeof(EEPackHeader));
+	src = VARDATA_ANY(packed) + sizeof(EEPackHeader);
+	srclen = VARSIZE_ANY_EXHDR(packed) - sizeof(EEPackHeader);
+
+	if (header.rawsize < 0)
+		pack_corrupted();
+
+	if (header.method == EE_PACK_PGLZ)
+	{
+		raw = (char *) palloc(header.rawsize);
+		if (pglz_decompress(src, srclen, raw, header.rawsize, true) != header.rawsize)
+			pack_corrupted();
+	}
+	else if (header.method == EE_PACK_RAW && srclen == header.rawsize)
+		raw = (char *) src;
+	else
+		pack_corrupted();
+
+	pos = raw;
+	end = raw + header.rawsize;
+
+	if (unpack_uvarint(&pos, end) != EE_PACK_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("unsupported format of packed paths")));
+
+	npaths = unpack_uvarint(&pos, end);
+
+	if (unpack_uvarint(&pos, end) != tupdesc->natts)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("packed paths do not match columns of ee.paths")));
+
+	columns = (EEUnpackColumn *) palloc0(sizeof(EEUnpackColumn) * tupdesc->natts);
+
+	for (i = 1; i < tupdesc->natts; i++)
+	{
+		EEUnpackColumn *col = &columns[i];
+		uint64		len;
+		uint64		nullmap_len = (npaths + 7) / 8;
+
+		col->typid = TupleDescAttr(tupdesc, i)->atttypid;
+		col->elemtype = check_column_type(TupleDescAttr(tupdesc, i));
+		if (OidIsValid(col->elemtype))
+			get_typlenbyvalalign(col->elemtype, &col->elemlen,
+								 &col->elembyval, &col->elemalign);
+
+		if (unpack_uvarint(&pos, end) != col->typid)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("packed paths do not match columns of ee.paths")));
+
+		len = unpack_uvarint(&pos, end);
+		if (len < nullmap_len)
+			pack_corrupted();
+
+		col->nullmap = (const uint8 *) unpack_bytes(&pos, end, nullmap_len);
+		col->pos = unpack_bytes(&pos, end, len - nullmap_len);
+		col->end = pos;
+	}
+
+	row_ctx = AllocSetContextCreate(CurrentMemoryContext,
+									"ee unpack paths row",
+									ALLOCSET_DEFAULT_SIZES);
+
+	for (row = 0; row < npaths; row++)
+	{
+		Datum		values[NUM_OF_COLS_EEPATHS];
+		bool		nulls[NUM_OF_COLS_EEPATHS];
+		MemoryContext fn_ctx = CurrentMemoryContext;
+
+		old_ctx = MemoryContextSwitchTo(row_ctx);
+
+		values[0] = Int64GetDatum(query_id);
+		nulls[0] = false;
+
+		for (i = 1; i < tupdesc->natts; i++)
+		{
+			EEUnpackColumn *col = &columns[i];
+
+			nulls[i] = (col->nullmap[row / 8] & (1 << (row % 8))) != 0;
+			values[i] = nulls[i] ? (Datum) 0 : unpack_value(col, fn_ctx);
+		}
+
+		tuplestore_putvalues(rsinfo->setResult, tupdesc, values, nulls);
+
+		MemoryContextSwitchTo(old_ctx);
+		MemoryContextReset(row_ctx);
+	}
+
+	MemoryContextDelete(row_ctx);
+}
+
+/*
+ * ee.unpack_paths(query_id) -- пути, упакованные в ee.query.packed_paths
+ */
+PG_FUNCTION_INFO_V1(ee_unpack_paths);
+
+Datum
+ee_unpack_paths(PG_FUNCTION_ARGS)
+{
+	int64		query_id = PG_GETARG_INT64(0);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	MemoryContext fn_ctx = CurrentMemoryContext;
+	Oid			argtypes[1] = {INT8OID};
+	Datum		args[1];
+	bytea	   *packed = NULL;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (rsinfo->setDesc->natts != NUM_OF_COLS_EEPATHS)
+		elog(ERROR, "ee.paths has %d columns, expected %d",
+			 rsinfo->setDesc->natts, NUM_OF_COLS_EEPATHS);
+
+	args[0] = Int64GetDatum(query_id);
+
+	SPI_connect();
+
+	if (SPI_execute_with_args("SELECT packed_paths FROM ee.query WHERE id = $1",
+							  1, argtypes, args, NULL, true, 1) != SPI_OK_SELECT)
+		elog(ERROR, "could not read ee.query");
+
+	if (SPI_processed == 1)
+	{
+		Datum		value;
+		bool		isnull;
+
+		value = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1,
+							  &isnull);
+
+		if (!isnull)
+		{
+			MemoryContext old_ctx = MemoryContextSwitchTo(fn_ctx);
+
+			packed = DatumGetByteaPCopy(value);
+			MemoryContextSwitchTo(old_ctx);
+		}
+	}
+
+	SPI_finish();
+
+	if (packed != NULL)
+		unpack_paths(rsinfo, query_id, packed);
+
+	return (Datum) 0;
+}
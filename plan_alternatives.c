@@ -0,0 +1,273 @@
+/*-------------------------------------------------------------------------
+ *
+ * plan_alternatives.c
+ *    Вывод альтернатив путей в узлах плана EXPLAIN (параметр alternatives)
+ *
+ * Для каждого узла итогового плана выводится идентификатор пути, по
+ * которому он построен, количество путей, рассмотренных для его отношения,
+ * а также тип наилучшего из отвергнутых путей (runner-up) и разница их
+ * полных стоимостей. Все сведения берутся из собранных в памяти путей, в
+ * таблицы расширения ничего не записывается.
+ *
+ * Узел плана сопоставляется с путем, вошедшим в план (in_final_plan), по
+ * типу узла и стоимостям, которые createplan копирует из пути. Узлы, не
+ * имеющие собственного пути (Hash, Sort для соединения слиянием и т.д.), не
+ * дополняются.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/plan_alternatives.h"
+#include "include/path_nodes.h"
+
+#include "commands/explain_format.h"
+#include "utils/memutils.h"
+
+/*
+ * Путь, вошедший в план, и отношение, которому он принадлежит. origin --
+ * путь, под которым исходный Path был записан впервые: итоговое и другие
+ * верхние отношения могут принять путь нижнего отношения без изменений, и
+ * альтернативы такого пути следует искать в отношении, построившем его.
+ */
+typedef struct EEPlanNodePath
+{
+	EEPath	   *eepath;
+	EEPath	   *origin;
+	EERel	   *origin_rel;
+} EEPlanNodePath;
+
+/*
+ * Есть ли у того же Path запись, сделанная позже eepath
+ */
+static bool
+has_later_record(EEPath *eepath)
+{
+	EEPath	   *same;
+
+	for (same = eepath->same_path; same != NULL && same != eepath;
+		 same = same->same_path)
+	{
+		if (same->id > eepath->id)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Являются ли eepath и other записями одного и того же Path
+ */
+static bool
+is_same_path_record(EEPath *eepath, EEPath *other)
+{
+	EEPath	   *same;
+
+	for (same = eepath->same_path; same != NULL && same != eepath;
+		 same = same->same_path)
+	{
+		if (same == other)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Список путей, вошедших в план. Строится при выводе первого узла плана.
+ */
+static List *
+build_plan_node_paths(EEState *ee_state)
+{
+	List	   *result = NIL;
+	ListCell   *lc1;
+	ListCell   *lc2;
+	ListCell   *lc3;
+	ListCell   *lc4;
+
+	foreach(lc1, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(lc1);
+
+		foreach(lc2, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(lc2);
+
+			foreach(lc3, eerel->eepath_list)
+			{
+				EEPath	   *eepath = (EEPath *) lfirst(lc3);
+				EEPlanNodePath *node_path;
+
+				/*
+				 * Path, записанный в нескольких отношениях, сопоставляется
+				 * узлу плана один раз -- по последней записи
+				 */
+				if (!eepath->in_final_plan || has_later_record(eepath))
+					continue;
+
+				node_path = (EEPlanNodePath *) palloc(sizeof(EEPlanNodePath));
+				node_path->eepath = eepath;
+				node_path->origin = eepath;
+				node_path->origin_rel = eerel;
+
+				result = lappend(result, node_path);
+			}
+		}
+	}
+
+	/* Поиск первых записей тех же Path */
+	foreach(lc1, ee_state->eesubquery_list)
+	{
+		EESubQuery *eesubquery = (EESubQuery *) lfirst(lc1);
+
+		foreach(lc2, eesubquery->eerel_list)
+		{
+			EERel	   *eerel = (EERel *) lfirst(lc2);
+
+			foreach(lc3, eerel->eepath_list)
+			{
+				EEPath	   *eepath = (EEPath *) lfirst(lc3);
+
+				foreach(lc4, result)
+				{
+					EEPlanNodePath *node_path = (EEPlanNodePath *) lfirst(lc4);
+					EEPath	   *origin = node_path->origin;
+
+					if (eepath->id < origin->id &&
+						is_same_path_record(eepath, origin))
+					{
+						node_path->origin = eepath;
+						node_path->origin_rel = eerel;
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Поиск пути, по которому построен узел плана. Найденный путь удаляется из
+ * списка, чтобы одинаковые узлы плана сопоставлялись разным путям.
+ *
+ * Если проекция не потребовала отдельного узла Result, узел плана получает
+ * стоимости ProjectionPath, поэтому ему сопоставляется и путь типа Result,
+ * единственный дочерний путь которого имеет тип узла.
+ */
+static EEPlanNodePath *
+take_plan_node_path(EEState *ee_state, Plan *plan)
+{
+	NodeTag		tag = nodeTag(plan);
+	int			pass;
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		ListCell   *lc;
+
+		foreach(lc, ee_state->plan_node_paths)
+		{
+			EEPlanNodePath *node_path = (EEPlanNodePath *) lfirst(lc);
+			EEPath	   *eepath = node_path->eepath;
+
+			if (eepath->startup_cost != plan->startup_cost ||
+				eepath->total_cost != plan->total_cost)
+				continue;
+
+			if (pass == 0 ? eepath->pathtype != tag :
+				(eepath->pathtype != T_Result || eepath->nsub != 1 ||
+				 eepath->sub_eepaths[0] == NULL ||
+				 eepath->sub_eepaths[0]->pathtype != tag))
+				continue;
+
+			ee_state->plan_node_paths =
+				foreach_delete_current(ee_state->plan_node_paths, lc);
+
+			return node_path;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Наилучший по полной стоимости путь отношения, отвергнутый в пользу
+ * chosen. Сравниваются только пути с той же параметризацией и того же вида
+ * (частичные или нет); пути, непосредственно содержащие chosen (например,
+ * его проекции), альтернативами не считаются.
+ */
+static EEPath *
+find_runner_up(EERel *eerel, EEPath *chosen)
+{
+	EEPath	   *runner_up = NULL;
+	ListCell   *lc;
+
+	foreach(lc, eerel->eepath_list)
+	{
+		EEPath	   *eepath = (EEPath *) lfirst(lc);
+		bool		wraps_chosen = false;
+		int			i;
+
+		if (eepath == chosen || eepath->in_final_plan ||
+			eepath->path_pointer == chosen->path_pointer ||
+			eepath->partial != chosen->partial ||
+			eepath->required_outer != chosen->required_outer)
+			continue;
+
+		for (i = 0; i < eepath->nsub; i++)
+		{
+			if (eepath->sub_eepaths[i] == chosen)
+				wraps_chosen = true;
+		}
+
+		if (wraps_chosen)
+			continue;
+
+		if (runner_up == NULL || eepath->total_cost < runner_up->total_cost)
+			runner_up = eepath;
+	}
+
+	return runner_up;
+}
+
+/*
+ * Вывод сведений об альтернативах для узла плана plan
+ */
+void
+ee_explain_alternatives(EEState *ee_state, Plan *plan, ExplainState *es)
+{
+	EEPlanNodePath *node_path;
+	EEPath	   *runner_up;
+
+	if (!ee_state->plan_node_paths_built)
+	{
+		MemoryContext old_ctx;
+
+		old_ctx = MemoryContextSwitchTo(GetMemoryChunkContext(ee_state));
+
+		ee_state->plan_node_paths = build_plan_node_paths(ee_state);
+		ee_state->plan_node_paths_built = true;
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	node_path = take_plan_node_path(ee_state, plan);
+
+	if (node_path == NULL)
+		return;
+
+	ExplainPropertyInteger("Path", NULL, node_path->origin->id, es);
+	ExplainPropertyInteger("Paths Considered", NULL,
+						   list_length(node_path->origin_rel->eepath_list), es);
+
+	runner_up = find_runner_up(node_path->origin_rel, node_path->origin);
+
+	if (runner_up == NULL)
+		return;
+
+	ExplainPropertyText("Runner-up", plan_type_name(runner_up->pathtype), es);
+
+	if (es->costs)
+		ExplainPropertyFloat("Runner-up Cost Margin", NULL,
+							 runner_up->total_cost - node_path->origin->total_cost,
+							 2, es);
+}
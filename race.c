@@ -0,0 +1,593 @@
+/*-------------------------------------------------------------------------
+ *
+ * race.c
+ *    Исполнение K самых дешевых альтернативных планов запроса
+ *
+ * Функция ee.race собирает пути запроса, выбирает K самых дешевых полных
+ * планов отношения, соединяющего все базовые отношения запроса, и по
+ * очереди исполняет запрос с каждым из них. Нужный план навязывается
+ * планировщику механизмом fixate_paths: в ee.fixate_paths перечисляются
+ * (уровень, отпечаток пути, полная стоимость) всех путей плана, остальные
+ * пути соответствующих уровней отключаются.
+ *
+ * Фиксация ограничивается подзапросом, которому принадлежит план
+ * (ee.fixate_subquery): пути других подзапросов тех же уровней планировщик
+ * выбирает как обычно.
+ *
+ * Каждый план исполняется командой EXPLAIN ANALYZE в отдельной
+ * подтранзакции, которая всегда откатывается, поэтому изменяющие запросы
+ * не оставляют после себя изменений. По выводу EXPLAIN проверяется, что
+ * исполненный план действительно имеет форму навязанного: те же типы
+ * соединений и сканирований, те же таблицы и тот же порядок внешних и
+ * внутренних отношений.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/race.h"
+#include "include/extended_explain.h"
+#include "include/output_result.h"
+#include "include/top_plans.h"
+
+#include <math.h>
+
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "storage/latch.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/jsonb.h"
+#include "utils/resowner.h"
+#include "utils/snapmgr.h"
+#include "utils/timeout.h"
+
+#define NUM_OF_COLS_RACE 12
+
+/*
+ * Таймаут исполнения одного плана. Регистрируется при первом вызове
+ * ee.race.
+ */
+static TimeoutId race_timeout_id = MAX_TIMEOUTS;
+static volatile sig_atomic_t race_timed_out = false;
+
+static void
+race_timeout_handler(void)
+{
+	race_timed_out = true;
+	InterruptPending = true;
+	QueryCancelPending = true;
+	SetLatch(MyLatch);
+}
+
+/*
+ * Формирование значения ee.fixate_paths, фиксирующего все пути плана
+ * с корнем в root.
+ *
+ * Пути верхних отношений (level = 0) не фиксируются: планировщик строит их
+ * поверх зафиксированного плана соединения.
+ *
+ * Фиксация гарантирует только совпадение отпечатков и стоимостей путей, а
+ * не сам план: исполненный план может отличаться от навязанного (например,
+ * при совпадении отпечатков разных путей или из-за незафиксированных путей
+ * верхних отношений). Поэтому результат сверяется с выводом EXPLAIN
+ * (plan_matched).
+ */
+static char *
+build_fixate_paths(EEPlanNode *root)
+{
+	List	   *nodes = NIL;
+	StringInfoData buf;
+	ListCell   *lc;
+
+	ee_collect_plan_nodes(root, &nodes);
+
+	initStringInfo(&buf);
+
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+
+		if (node->level == 0)
+			continue;
+
+		if (buf.len > 0)
+			appendStringInfoChar(&buf, ',');
+
+		appendStringInfo(&buf, "%d," INT64_FORMAT "," INT64_FORMAT,
+						 node->level,
+						 node->fingerprint,
+						 (int64) floor(100.0 * node->total_cost + 0.5));
+	}
+
+	list_free(nodes);
+
+	return buf.data;
+}
+
+/*
+ * Форма узла плана: название типа узла, для сканирований -- с именем
+ * таблицы, для узлов с несколькими дочерними узлами -- с формами дочерних
+ * узлов в их порядке, например "HashJoin(SeqScan[t2],SeqScan[t1])".
+ *
+ * Узлы с одним дочерним узлом (Hash, Sort, Material, Gather, Agg и т.п.)
+ * имеют форму дочернего узла: createplan добавляет и удаляет их независимо
+ * от путей соединения, а setrefs удаляет тривиальные Append и
+ * SubqueryScan. По той же причине SubqueryScan не считается сканированием.
+ * Дочерние узлы сканирований (условия BitmapHeapScan) в форму не входят.
+ */
+static char *
+node_shape(const char *type, const char *rel_name, List *child_shapes)
+{
+	StringInfoData buf;
+	size_t		len = strlen(type);
+	ListCell   *lc;
+
+	if (len >= 4 && strcmp(type + len - 4, "Scan") == 0 &&
+		strcmp(type, "SubqueryScan") != 0)
+	{
+		if (rel_name == NULL)
+			return pstrdup(type);
+
+		return psprintf("%s[%s]", type, rel_name);
+	}
+
+	if (list_length(child_shapes) == 1)
+		return (char *) linitial(child_shapes);
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, type);
+
+	if (child_shapes != NIL)
+	{
+		appendStringInfoChar(&buf, '(');
+		foreach(lc, child_shapes)
+		{
+			if (foreach_current_index(lc) > 0)
+				appendStringInfoChar(&buf, ',');
+			appendStringInfoString(&buf, (char *) lfirst(lc));
+		}
+		appendStringInfoChar(&buf, ')');
+	}
+
+	return buf.data;
+}
+
+/*
+ * Форма дерева путей с корнем в node (см. node_shape)
+ */
+static char *
+path_shape(EEPlanNode *node)
+{
+	List	   *child_shapes = NIL;
+	int			i;
+
+	check_stack_depth();
+
+	for (i = 0; i < node->nchild; i++)
+		child_shapes = lappend(child_shapes, path_shape(node->children[i]));
+
+	return node_shape(node->path_type ? node->path_type : "",
+					  node->rel_name, child_shapes);
+}
+
+/*
+ * Строковое значение ключа key объекта JSON, NULL -- ключа нет
+ */
+static char *
+json_string_value(JsonbContainer *container, const char *key)
+{
+	JsonbValue	vbuf;
+	JsonbValue *v;
+
+	v = getKeyJsonValueFromContainer(container, key, strlen(key), &vbuf);
+	if (v == NULL || v->type != jbvString)
+		return NULL;
+
+	return pnstrdup(v->val.string.val, v->val.string.len);
+}
+
+/*
+ * Форма узла plan из JSON вывода EXPLAIN (см. node_shape).
+ *
+ * Название типа узла приводится к названию типа пути ("Nested Loop" --
+ * "NestLoop", "CTE Scan" -- "CteScan", в остальных удаляются пробелы).
+ * Узлы InitPlan и SubPlan относятся к другим подзапросам и в форму не
+ * входят. matched устанавливается, если форма какого-либо узла совпала с
+ * target: навязанный план может оказаться поддеревом исполненного (план
+ * подзапроса).
+ */
+static char *
+json_plan_shape(JsonbContainer *plan, const char *target, bool *matched)
+{
+	JsonbValue	vbuf;
+	JsonbValue *plans;
+	char	   *node_type;
+	char	   *type;
+	char	   *rel_name;
+	List	   *child_shapes = NIL;
+	char	   *shape;
+	int			i;
+	int			j;
+
+	check_stack_depth();
+
+	node_type = json_string_value(plan, "Node Type");
+	if (node_type == NULL)
+		elog(ERROR, "could not parse EXPLAIN ANALYZE output");
+
+	if (strcmp(node_type, "Nested Loop") == 0)
+		type = pstrdup("NestLoop");
+	else if (strcmp(node_type, "CTE Scan") == 0)
+		type = pstrdup("CteScan");
+	else
+	{
+		type = palloc(strlen(node_type) + 1);
+		for (i = 0, j = 0; node_type[i] != '\0'; i++)
+			if (node_type[i] != ' ')
+				type[j++] = node_type[i];
+		type[j] = '\0';
+	}
+
+	rel_name = json_string_value(plan, "Relation Name");
+
+	plans = getKeyJsonValueFromContainer(plan, "Plans", strlen("Plans"), &vbuf);
+	if (plans != NULL && plans->type == jbvBinary)
+	{
+		JsonbContainer *children = plans->val.binary.data;
+		uint32		nchildren = JsonContainerSize(children);
+		uint32		k;
+
+		for (k = 0; k < nchildren; k++)
+		{
+			JsonbValue *child = getIthJsonbValueFromContainer(children, k);
+			char	   *relationship;
+
+			if (child == NULL || child->type != jbvBinary)
+				continue;
+
+			relationship = json_string_value(child->val.binary.data,
+											 "Parent Relationship");
+			if (relationship != NULL &&
+				(strcmp(relationship, "InitPlan") == 0 ||
+				 strcmp(relationship, "SubPlan") == 0))
+			{
+				(void) json_plan_shape(child->val.binary.data, target, matched);
+				continue;
+			}
+
+			child_shapes = lappend(child_shapes,
+								   json_plan_shape(child->val.binary.data,
+												   target, matched));
+		}
+	}
+
+	shape = node_shape(type, rel_name, child_shapes);
+
+	if (strcmp(shape, target) == 0)
+		*matched = true;
+
+	return shape;
+}
+
+/*
+ * Разбор JSON вывода EXPLAIN ANALYZE.
+ *
+ * План считается совпавшим с навязанным (plan_matched), если форма дерева
+ * путей с корнем в root (типы соединений и сканирований, таблицы и порядок
+ * внешних и внутренних отношений) совпадает с формой исполненного плана
+ * или одного из его поддеревьев. Иначе fixate_paths не смог навязать план,
+ * и результаты относятся к другому плану.
+ */
+static void
+parse_explain_output(const char *explain_output, EEPlanNode *root,
+					 EERaceResult *result)
+{
+	Oid			argtypes[1] = {TEXTOID};
+	Datum		args[1];
+	HeapTuple	tuple;
+	TupleDesc	tupdesc;
+	Datum		value;
+	bool		isnull;
+
+	args[0] = CStringGetTextDatum(explain_output);
+
+	if (SPI_execute_with_args("SELECT (p->'Plan'->>'Total Cost')::float8, "
+							  "(p->>'Planning Time')::float8, "
+							  "(p->>'Execution Time')::float8, "
+							  "(p->'Plan'->>'Actual Rows')::float8, "
+							  "p->'Plan' "
+							  "FROM (SELECT ($1::jsonb)->0 AS p) s",
+							  1, argtypes, args, NULL, true, 1) != SPI_OK_SELECT ||
+		SPI_processed != 1)
+		elog(ERROR, "could not parse EXPLAIN ANALYZE output");
+
+	tuple = SPI_tuptable->vals[0];
+	tupdesc = SPI_tuptable->tupdesc;
+
+	value = SPI_getbinval(tuple, tupdesc, 1, &isnull);
+	result->planned_cost = isnull ? 0 : DatumGetFloat8(value);
+
+	value = SPI_getbinval(tuple, tupdesc, 2, &isnull);
+	result->planning_time = isnull ? 0 : DatumGetFloat8(value);
+
+	value = SPI_getbinval(tuple, tupdesc, 3, &isnull);
+	result->execution_time = isnull ? 0 : DatumGetFloat8(value);
+
+	value = SPI_getbinval(tuple, tupdesc, 4, &isnull);
+	result->actual_rows = isnull ? 0 : DatumGetFloat8(value);
+
+	value = SPI_getbinval(tuple, tupdesc, 5, &isnull);
+	result->plan_matched = false;
+	if (!isnull)
+		(void) json_plan_shape(&DatumGetJsonbP(value)->root, path_shape(root),
+							   &result->plan_matched);
+
+	SPI_freetuptable(SPI_tuptable);
+}
+
+/*
+ * Исполнение запроса с зафиксированным планом root.
+ *
+ * Запрос исполняется командой EXPLAIN ANALYZE в подтранзакции, которая
+ * откатывается в любом случае. Если время исполнения превысило timeout
+ * миллисекунд, исполнение прерывается и план помечается как timed_out.
+ * Остальные ошибки пробрасываются дальше.
+ *
+ * Должна вызываться после SPI_connect().
+ */
+static void
+race_plan(const char *query_string, int64 subquery_id, EEPlanNode *root,
+		  int timeout, EERaceResult *result)
+{
+	MemoryContext fn_ctx = CurrentMemoryContext;
+	ResourceOwner fn_owner = CurrentResourceOwner;
+	char	   *fixate_paths = build_fixate_paths(root);
+	char	   *fixate_subquery = psprintf(INT64_FORMAT, subquery_id);
+	char	   *volatile explain_output = NULL;
+	ErrorData  *volatile edata = NULL;
+	StringInfoData sql;
+
+	initStringInfo(&sql);
+#if (PG_VERSION_NUM >= 180000)
+	appendStringInfo(&sql, "EXPLAIN (ANALYZE, TIMING OFF, FORMAT JSON, fixate_paths) %s",
+					 query_string);
+#else
+	appendStringInfo(&sql, "EXPLAIN (ANALYZE, TIMING OFF, FORMAT JSON) %s",
+					 query_string);
+#endif
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(fn_ctx);
+
+	PG_TRY();
+	{
+		/* Значения параметров восстанавливаются при откате подтранзакции */
+		(void) set_config_option("ee.fixate_paths", fixate_paths,
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_LOCAL, true, 0, false);
+		(void) set_config_option("ee.fixate_subquery", fixate_subquery,
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_LOCAL, true, 0, false);
+#if (PG_VERSION_NUM < 180000)
+		(void) set_config_option("ee.enable_fixate_paths", "on",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_LOCAL, true, 0, false);
+#endif
+
+		race_timed_out = false;
+		if (timeout > 0)
+			enable_timeout_after(race_timeout_id, timeout);
+
+		if (SPI_execute(sql.data, false, 0) != SPI_OK_UTILITY ||
+			SPI_processed != 1)
+			elog(ERROR, "could not execute EXPLAIN ANALYZE");
+
+		if (timeout > 0)
+			disable_timeout(race_timeout_id, false);
+
+		/* Таймаут сработал уже после завершения исполнения */
+		if (race_timed_out)
+		{
+			QueryCancelPending = false;
+			race_timed_out = false;
+		}
+
+		explain_output = MemoryContextStrdup(fn_ctx,
+											 SPI_getvalue(SPI_tuptable->vals[0],
+														  SPI_tuptable->tupdesc, 1));
+	}
+	PG_CATCH();
+	{
+		if (timeout > 0)
+			disable_timeout(race_timeout_id, false);
+
+		MemoryContextSwitchTo(fn_ctx);
+		edata = CopyErrorData();
+		FlushErrorState();
+	}
+	PG_END_TRY();
+
+	/* Изменения, сделанные запросом, не сохраняются */
+	RollbackAndReleaseCurrentSubTransaction();
+	MemoryContextSwitchTo(fn_ctx);
+	CurrentResourceOwner = fn_owner;
+
+	if (edata != NULL)
+	{
+		if (!race_timed_out || edata->sqlerrcode != ERRCODE_QUERY_CANCELED)
+			ReThrowError(edata);
+
+		race_timed_out = false;
+		result->timed_out = true;
+
+		FreeErrorData(edata);
+		return;
+	}
+
+	parse_explain_output(explain_output, root, result);
+}
+
+/*
+ * ee.race(query, k, timeout) -- исполнение K самых дешевых планов запроса
+ * query и сравнение их реального времени исполнения с оценкой стоимости.
+ *
+ * Результаты записываются в таблицу ee.race_results и возвращаются
+ * функцией.
+ */
+PG_FUNCTION_INFO_V1(ee_race);
+
+Datum
+ee_race(PG_FUNCTION_ARGS)
+{
+	char	   *query_string = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int32		k = PG_GETARG_INT32(1);
+	int32		timeout = PG_GETARG_INT32(2);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int64		query_id;
+	int64		subquery_id = -1;
+	List	   *top_plans;
+	List	   *alternatives = NIL;
+	EERaceResult *results;
+	int			nresults;
+	ListCell   *lc;
+	int			i;
+
+	if (k <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of plans must be positive")));
+
+	if (timeout < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("timeout must not be negative")));
+
+	if (ee_capture_in_progress())
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("path capture is already in progress")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	query_id = ee_capture_generic_plan(query_string, 0);
+
+	/* Записанные пути должны быть видны при чтении ee.paths */
+	CommandCounterIncrement();
+	PushCopiedSnapshot(GetActiveSnapshot());
+	UpdateActiveSnapshotCommandId();
+
+	top_plans = ee_get_top_plans(query_id, k);
+
+	PopActiveSnapshot();
+
+	/*
+	 * Верхний запрос планируется последним, поэтому его пути относятся к
+	 * подзапросу с наибольшим идентификатором. Исполняются планы отношения,
+	 * соединяющего все базовые отношения запроса.
+	 */
+	foreach(lc, top_plans)
+	{
+		EETopPlan  *top_plan = (EETopPlan *) lfirst(lc);
+
+		if (top_plan->root->level > 0 && top_plan->subquery_id > subquery_id)
+			subquery_id = top_plan->subquery_id;
+	}
+
+	foreach(lc, top_plans)
+	{
+		EETopPlan  *top_plan = (EETopPlan *) lfirst(lc);
+
+		if (top_plan->root->level > 0 && top_plan->subquery_id == subquery_id)
+			alternatives = lappend(alternatives, top_plan);
+	}
+
+	nresults = list_length(alternatives);
+	if (nresults == 0)
+		return (Datum) 0;
+
+	if (race_timeout_id == MAX_TIMEOUTS)
+		race_timeout_id = RegisterTimeout(USER_TIMEOUT, race_timeout_handler);
+
+	results = (EERaceResult *) palloc0(sizeof(EERaceResult) * nresults);
+
+	i = 0;
+	foreach(lc, alternatives)
+	{
+		EETopPlan  *top_plan = (EETopPlan *) lfirst(lc);
+		EERaceResult *result = &results[i++];
+
+		result->rank = top_plan->rank;
+		result->path_id = top_plan->root->path_id;
+		result->path_type = top_plan->root->path_type;
+		result->estimated_cost = top_plan->root->total_cost;
+		result->plan = ee_plan_text(top_plan->root);
+	}
+
+	SPI_connect();
+
+	i = 0;
+	foreach(lc, alternatives)
+	{
+		EETopPlan  *top_plan = (EETopPlan *) lfirst(lc);
+
+		CHECK_FOR_INTERRUPTS();
+
+		race_plan(query_string, subquery_id, top_plan->root, timeout,
+				  &results[i++]);
+	}
+
+	SPI_finish();
+
+	for (i = 0; i < nresults; i++)
+	{
+		EERaceResult *result = &results[i];
+		Datum		values[NUM_OF_COLS_RACE];
+		bool		nulls[NUM_OF_COLS_RACE];
+
+		insert_race_result_into_eerace(query_id, result);
+
+		memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_RACE);
+
+		values[0] = Int64GetDatum(query_id);
+		values[1] = Int32GetDatum(result->rank);
+		values[2] = Int64GetDatum(result->path_id);
+
+		if (result->path_type == NULL)
+			nulls[3] = true;
+		else
+			values[3] = CStringGetTextDatum(result->path_type);
+
+		values[4] = Float8GetDatum(result->estimated_cost);
+
+		if (result->timed_out)
+		{
+			nulls[5] = true;
+			nulls[6] = true;
+			nulls[7] = true;
+			nulls[8] = true;
+		}
+		else
+		{
+			values[5] = Float8GetDatum(result->planned_cost);
+			values[6] = Float8GetDatum(result->planning_time);
+			values[7] = Float8GetDatum(result->execution_time);
+			values[8] = Float8GetDatum(result->actual_rows);
+		}
+
+		values[9] = BoolGetDatum(result->timed_out);
+		values[10] = CStringGetTextDatum(result->plan);
+
+		if (result->timed_out)
+			nulls[11] = true;
+		else
+			values[11] = BoolGetDatum(result->plan_matched);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
@@ -0,0 +1,397 @@
+#!/usr/bin/env python3
+#
+# Эталонный поток Arrow IPC для регрессионного теста eefunctions.
+#
+# Независимая реализация записи потока из arrow_export.c: схема, словари и
+# пакеты записей строятся так же, как в C-коде, для двух путей, которые
+# тест вставляет в ee.paths. Скрипт печатает длину потока, md5 сообщения
+# схемы и md5 всего потока -- значения, с которыми тест сравнивает вывод
+# ee.export_arrow. Если установлен pyarrow, поток дополнительно читается
+# им, чтобы убедиться, что эталон -- корректный поток Arrow.
+#
+# Запуск: python3 test/arrow_reference.py
+#
+
+import hashlib
+import struct
+import sys
+
+ARROW_METADATA_V5 = 4
+
+HEADER_SCHEMA = 1
+HEADER_DICTIONARY_BATCH = 2
+HEADER_RECORD_BATCH = 3
+
+TYPE_INT = 2
+TYPE_FLOATING_POINT = 3
+TYPE_UTF8 = 5
+TYPE_BOOL = 6
+TYPE_LIST = 12
+
+BATCH_ROWS = 65536
+
+# Колонки ee.paths в порядке arrow_export.c
+COLUMNS = [
+    ("query_id", "int64"), ("subquery_id", "int64"),
+    ("subquery_level", "int64"), ("rel_id", "int64"), ("path_id", "int64"),
+    ("path_type", "dict"), ("child_paths", "list"),
+    ("startup_cost", "float64"), ("total_cost", "float64"),
+    ("rows", "int32"), ("width", "int32"), ("rel_name", "dict"),
+    ("rel_alias", "dict"), ("level", "int32"), ("add_path_result", "dict"),
+    ("displaced_by", "int64"), ("cost_cmp", "dict"),
+    ("fuzz_factor", "float64"), ("pathkeys_cmp", "dict"),
+    ("bms_cmp", "dict"), ("rows_cmp", "dict"), ("parallel_safe_cmp", "dict"),
+    ("disabled_nodes", "int32"), ("plan_kind", "dict"), ("partial", "bool"),
+    ("parallel_aware", "bool"), ("parallel_workers", "int32"),
+    ("cheapest_total", "bool"), ("cheapest_startup", "bool"),
+    ("cheapest_parameterized", "bool"), ("in_final_plan", "bool"),
+    ("plan_depth", "int32"), ("agg_strategy", "dict"),
+    ("num_groups", "float64"), ("fingerprint", "int64"),
+]
+
+# Пути, которые вставляет test/sql/eefunctions.sql; отсутствующие колонки
+# равны NULL
+ROWS = [
+    dict(query_id=1000000, subquery_id=1, subquery_level=1, rel_id=1,
+         path_id=1, path_type="SeqScan", child_paths=[], startup_cost=0.0,
+         total_cost=2.5, rows=100, width=4, rel_name="t1", rel_alias="t1",
+         level=1, add_path_result="saved", disabled_nodes=0,
+         plan_kind="default", partial=False, parallel_aware=False,
+         parallel_workers=0, cheapest_total=True, cheapest_startup=True,
+         cheapest_parameterized=False, in_final_plan=True, plan_depth=1,
+         fingerprint=42),
+    dict(query_id=1000000, subquery_id=1, subquery_level=1, rel_id=2,
+         path_id=2, path_type="HashJoin", child_paths=[1, 1],
+         startup_cost=1.25, total_cost=8.0, rows=50, width=8, level=2,
+         add_path_result="displaced", displaced_by=1, cost_cmp="BETTER1",
+         fuzz_factor=1.01, disabled_nodes=0, plan_kind="default",
+         partial=False, parallel_aware=False, parallel_workers=0,
+         cheapest_total=False, cheapest_startup=False,
+         cheapest_parameterized=False, in_final_plan=False, fingerprint=-7),
+]
+
+
+class Builder:
+    """Построитель flatbuffers, заполняющий буфер с конца, как в C-коде"""
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.buf = bytearray()
+        self.minalign = 1
+
+    @property
+    def used(self):
+        return len(self.buf)
+
+    def push(self, data):
+        self.buf[0:0] = data
+
+    def pad(self, n):
+        self.push(b"\0" * n)
+
+    def prep(self, align, additional):
+        self.minalign = max(self.minalign, align)
+        self.pad((-(self.used + additional)) & (align - 1))
+
+    def push_uint(self, value, size):
+        self.push((value & ((1 << (8 * size)) - 1)).to_bytes(size, "little"))
+
+    def push_ref(self, ref):
+        self.prep(4, 0)
+        self.push_uint(self.used + 4 - ref, 4)
+
+    def string(self, s):
+        data = s.encode()
+        self.prep(4, len(data) + 1)
+        self.pad(1)
+        self.push(data)
+        self.push_uint(len(data), 4)
+        return self.used
+
+    def ref_vector(self, refs):
+        self.prep(4, 4 * len(refs))
+        for ref in reversed(refs):
+            self.push_ref(ref)
+        self.push_uint(len(refs), 4)
+        return self.used
+
+    def pair_vector(self, values):
+        n = len(values) // 2
+        self.prep(4, 16 * n)
+        self.prep(8, 16 * n)
+        for value in reversed(values):
+            self.push_uint(value, 8)
+        self.push_uint(n, 4)
+        return self.used
+
+    def start(self):
+        self.table_start = self.used
+        self.fields = [0] * 8
+        self.nfields = 0
+
+    def scalar(self, field, value, size):
+        self.prep(size, 0)
+        self.push_uint(value, size)
+        self.fields[field] = self.used
+        self.nfields = max(self.nfields, field + 1)
+
+    def ref(self, field, ref):
+        self.push_ref(ref)
+        self.fields[field] = self.used
+        self.nfields = max(self.nfields, field + 1)
+
+    def end(self):
+        self.prep(4, 0)
+        self.pad(4)
+        table = self.used
+        for i in range(self.nfields - 1, -1, -1):
+            self.push_uint(table - self.fields[i] if self.fields[i] else 0, 2)
+        self.push_uint(table - self.table_start, 2)
+        self.push_uint((self.nfields + 2) * 2, 2)
+        pos = len(self.buf) - table
+        self.buf[pos:pos + 4] = (self.used - table).to_bytes(4, "little")
+        return table
+
+    def finish(self, root):
+        self.prep(self.minalign, 4)
+        self.push_ref(root)
+
+
+class Body:
+    """Тело сообщения: узлы полей и буферы, выровненные по 8 байт"""
+
+    def __init__(self):
+        self.reset()
+
+    def reset(self):
+        self.data = bytearray()
+        self.buffers = []
+        self.nodes = []
+
+    def node(self, length, null_count):
+        self.nodes += [length, null_count]
+
+    def buffer(self, data):
+        self.buffers += [len(self.data), len(data)]
+        self.data += data
+        self.data += b"\0" * (-len(self.data) & 7)
+
+
+class Writer:
+    def __init__(self):
+        self.out = bytearray()
+        self.fb = Builder()
+        self.body = Body()
+        self.dicts = [{"values": [], "index": {}, "nwritten": 0}
+                      for _ in COLUMNS]
+
+    def message(self, header_type, header, body):
+        fb = self.fb
+        fb.start()
+        fb.scalar(3, len(body.data) if body else 0, 8)
+        fb.ref(2, header)
+        fb.scalar(0, ARROW_METADATA_V5, 2)
+        fb.scalar(1, header_type, 1)
+        fb.finish(fb.end())
+        padding = -fb.used & 7
+        self.out += struct.pack("<Ii", 0xFFFFFFFF, fb.used + padding)
+        self.out += fb.buf + b"\0" * padding
+        if body:
+            self.out += body.data
+        fb.reset()
+
+    def int_type(self, bit_width):
+        self.fb.start()
+        self.fb.scalar(0, bit_width, 4)
+        self.fb.scalar(1, 1, 1)
+        return self.fb.end()
+
+    def field(self, name, type_type, type_ref, dictionary, children):
+        fb = self.fb
+        name_ref = fb.string(name)
+        fb.start()
+        fb.ref(0, name_ref)
+        fb.ref(3, type_ref)
+        if dictionary:
+            fb.ref(4, dictionary)
+        fb.ref(5, children)
+        fb.scalar(1, 1, 1)
+        fb.scalar(2, type_type, 1)
+        return fb.end()
+
+    def schema(self):
+        fb = self.fb
+        fields = []
+        for i, (name, kind) in enumerate(COLUMNS):
+            children = fb.ref_vector([])
+            dictionary = 0
+            if kind in ("int32", "int64"):
+                type_ref = self.int_type(32 if kind == "int32" else 64)
+                type_type = TYPE_INT
+            elif kind == "float64":
+                fb.start()
+                fb.scalar(0, 2, 2)
+                type_ref = fb.end()
+                type_type = TYPE_FLOATING_POINT
+            elif kind == "bool":
+                fb.start()
+                type_ref = fb.end()
+                type_type = TYPE_BOOL
+            elif kind == "dict":
+                index_type = self.int_type(32)
+                fb.start()
+                fb.scalar(0, i, 8)
+                fb.ref(1, index_type)
+                dictionary = fb.end()
+                fb.start()
+                type_ref = fb.end()
+                type_type = TYPE_UTF8
+            else:
+                item_type = self.int_type(64)
+                item = self.field("item", TYPE_INT, item_type, 0, children)
+                children = fb.ref_vector([item])
+                fb.start()
+                type_ref = fb.end()
+                type_type = TYPE_LIST
+            fields.append(self.field(name, type_type, type_ref, dictionary,
+                                     children))
+        fields_ref = fb.ref_vector(fields)
+        fb.start()
+        fb.ref(1, fields_ref)
+        fb.scalar(0, 0, 2)
+        self.message(HEADER_SCHEMA, fb.end(), None)
+
+    def record_batch(self, length):
+        fb = self.fb
+        nodes = fb.pair_vector(self.body.nodes)
+        buffers = fb.pair_vector(self.body.buffers)
+        fb.start()
+        fb.scalar(0, length, 8)
+        fb.ref(1, nodes)
+        fb.ref(2, buffers)
+        return fb.end()
+
+    def dictionary(self, column):
+        d = self.dicts[column]
+        values = d["values"][d["nwritten"]:]
+        data = bytearray()
+        offsets = [0]
+        for value in values:
+            data += value.encode()
+            offsets.append(len(data))
+        body = self.body
+        body.reset()
+        body.node(len(values), 0)
+        body.buffer(b"")
+        body.buffer(struct.pack("<%di" % len(offsets), *offsets))
+        body.buffer(bytes(data))
+        batch = self.record_batch(len(values))
+        fb = self.fb
+        fb.start()
+        fb.scalar(0, column, 8)
+        fb.ref(1, batch)
+        if d["nwritten"] > 0:
+            fb.scalar(2, 1, 1)
+        self.message(HEADER_DICTIONARY_BATCH, fb.end(), body)
+        d["nwritten"] = len(d["values"])
+
+    def dictionary_index(self, column, value):
+        d = self.dicts[column]
+        if value not in d["index"]:
+            d["index"][value] = len(d["values"])
+            d["values"].append(value)
+        return d["index"][value]
+
+    def batch(self, rows):
+        n = len(rows)
+        bitmap_len = (n + 7) // 8
+        body = self.body
+        body.reset()
+        for i, (name, kind) in enumerate(COLUMNS):
+            values = [row.get(name) for row in rows]
+            nulls = sum(value is None for value in values)
+            body.node(n, nulls)
+            validity = bytearray(bitmap_len)
+            for j, value in enumerate(values):
+                if value is not None:
+                    validity[j // 8] |= 1 << (j % 8)
+            body.buffer(bytes(validity) if nulls > 0 else b"")
+            if kind == "dict":
+                body.buffer(b"".join(
+                    struct.pack("<i", 0 if value is None
+                                else self.dictionary_index(i, value))
+                    for value in values))
+            elif kind == "int32":
+                body.buffer(b"".join(struct.pack("<i", value or 0)
+                                     for value in values))
+            elif kind == "int64":
+                body.buffer(b"".join(struct.pack("<q", value or 0)
+                                     for value in values))
+            elif kind == "float64":
+                body.buffer(b"".join(struct.pack("<d", value or 0.0)
+                                     for value in values))
+            elif kind == "bool":
+                bitmap = bytearray(bitmap_len)
+                for j, value in enumerate(values):
+                    if value:
+                        bitmap[j // 8] |= 1 << (j % 8)
+                body.buffer(bytes(bitmap))
+            else:
+                offsets = [0]
+                items = []
+                for value in values:
+                    items += value or []
+                    offsets.append(len(items))
+                body.buffer(struct.pack("<%di" % len(offsets), *offsets))
+                body.node(len(items), 0)
+                body.buffer(b"")
+                body.buffer(struct.pack("<%dq" % len(items), *items))
+
+    def export(self, rows):
+        self.schema()
+        schema_len = len(self.out)
+        for start in range(0, len(rows), BATCH_ROWS):
+            batch = rows[start:start + BATCH_ROWS]
+            # Словари пополняются при чтении пакета и записываются до него
+            for i, (name, kind) in enumerate(COLUMNS):
+                if kind == "dict":
+                    for row in batch:
+                        if row.get(name) is not None:
+                            self.dictionary_index(i, row[name])
+            for i, (name, kind) in enumerate(COLUMNS):
+                d = self.dicts[i]
+                if kind == "dict" and (start == 0 or
+                                       len(d["values"]) > d["nwritten"]):
+                    self.dictionary(i)
+            self.batch(batch)
+            self.message(HEADER_RECORD_BATCH, self.record_batch(len(batch)),
+                         self.body)
+        self.out += struct.pack("<Ii", 0xFFFFFFFF, 0)
+        return bytes(self.out), schema_len
+
+
+def main():
+    stream, schema_len = Writer().export(ROWS)
+
+    try:
+        import pyarrow.ipc
+    except ImportError:
+        pass
+    else:
+        table = pyarrow.ipc.open_stream(stream).read_all()
+        if table.num_rows != len(ROWS):
+            sys.exit("pyarrow read %d rows" % table.num_rows)
+
+    print(" bytes |              schema              |"
+          "              stream              ")
+    print("-------+----------------------------------+"
+          "----------------------------------")
+    print(" %5d | %s | %s" % (len(stream),
+                              hashlib.md5(stream[:schema_len]).hexdigest(),
+                              hashlib.md5(stream).hexdigest()))
+
+
+if __name__ == "__main__":
+    main()
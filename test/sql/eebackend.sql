@@ -0,0 +1,75 @@
+--
+-- Сбор путей другого процесса (ee.capture_backend)
+--
+-- Функция требует загрузки расширения через shared_preload_libraries.
+-- Вывод при загрузке расширения без нее -- eebackend_1.out
+--
+
+SET debug_parallel_query = off;
+SET jit = off;
+
+CREATE TABLE cb (a int);
+
+INSERT INTO cb SELECT generate_series(1, 100);
+
+ANALYZE cb;
+
+--
+-- 1. Проверка аргументов и прав
+--
+
+SELECT ee.capture_backend(pg_backend_pid(), 0);
+
+SELECT ee.capture_backend(0, 1);
+
+CREATE ROLE regress_ee_capture;
+GRANT USAGE ON SCHEMA ee TO regress_ee_capture;
+
+SET ROLE regress_ee_capture;
+
+SELECT ee.capture_backend(pg_backend_pid(), 1);
+
+RESET ROLE;
+
+DROP OWNED BY regress_ee_capture;
+DROP ROLE regress_ee_capture;
+
+--
+-- 2. Сбор путей собственного процесса: перехватывается следующее
+-- планирование, пути записываются в журнал сборов, а не в ee.query
+--
+
+SELECT ee.capture_backend(pg_backend_pid(), 1);
+
+SELECT count(*) FROM cb WHERE a < 10;
+
+SELECT count(*) > 0 AS captured,
+	bool_or(path_type = 'SeqScan') AS scan,
+	bool_or(in_final_plan) AS final_plan,
+	bool_and(query LIKE 'SELECT count(*) FROM cb%') AS query
+FROM ee.read_log((SELECT max(segment)
+				  FROM pg_ls_dir('ee', true, false) AS segment
+				  WHERE split_part(segment, '_', 2)::int = pg_backend_pid()));
+
+SELECT count(*) AS stored
+FROM ee.query
+WHERE query_text LIKE 'SELECT count(*) FROM cb%';
+
+-- Запрос на сбор исчерпан
+SELECT count(*) FROM cb WHERE a < 20;
+
+SELECT count(*) AS records
+FROM ee.read_log((SELECT max(segment)
+				  FROM pg_ls_dir('ee', true, false) AS segment
+				  WHERE split_part(segment, '_', 2)::int = pg_backend_pid()))
+WHERE query LIKE 'SELECT count(*) FROM cb WHERE a < 20%';
+
+--
+-- Очистка
+--
+
+SELECT coalesce(bool_and(ee.remove_log(segment)), true) AS removed
+FROM pg_ls_dir('ee', true, false) AS segment
+WHERE split_part(segment, '_', 2)::int = pg_backend_pid();
+
+DROP TABLE cb;
@@ -0,0 +1,468 @@
+--
+-- Проверка SQL-функций расширения
+--
+
+SET debug_parallel_query = off;
+SET jit = off;
+
+CREATE TABLE t1 (a int);
+CREATE TABLE t2 (b int);
+
+INSERT INTO t1 SELECT generate_series(1, 100);
+INSERT INTO t2 SELECT generate_series(1, 200);
+
+ANALYZE t1, t2;
+--
+-- 1. ee.top_plans, ee.rels и статистика перебора соединений
+--
+
+EXPLAIN (get_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+SELECT rel_id, rank, path_id, path_type, chosen, plan_nodes, plan_depth, plan, differences
+FROM ee.top_plans((SELECT max(id) FROM ee.query), 3)
+ORDER BY rel_id, rank;
+
+SELECT * FROM ee.export_graph((SELECT max(id) FROM ee.query), 'dot', 'final');
+
+SELECT count(*) AS nodes
+FROM ee.export_graph((SELECT max(id) FROM ee.query), 'graphml', 'near_final') AS line
+WHERE line LIKE '%<node %';
+
+SELECT substr(ee.export_arrow(ARRAY[(SELECT max(id) FROM ee.query)]), 1, 4)
+	AS continuation;
+
+SELECT ee.export_arrow(ARRAY[1], 'ee_paths.arrow');
+
+--
+-- Эталонный поток Arrow для двух путей с известными значениями: схема и
+-- весь поток сравниваются побайтно. Эталонные значения печатает
+-- test/arrow_reference.py
+--
+
+INSERT INTO ee.query (id, query_text) VALUES (1000000, 'arrow');
+INSERT INTO ee.paths (query_id, subquery_id, subquery_level, rel_id, path_id,
+	path_type, child_paths, startup_cost, total_cost, rows, width, rel_name,
+	rel_alias, level, add_path_result, displaced_by, cost_cmp, fuzz_factor,
+	disabled_nodes, plan_kind, partial, parallel_aware, parallel_workers,
+	cheapest_total, cheapest_startup, cheapest_parameterized, in_final_plan,
+	plan_depth, fingerprint)
+VALUES (1000000, 1, 1, 1, 1, 'SeqScan', '{}', 0, 2.5, 100, 4, 't1', 't1', 1,
+		'saved', NULL, NULL, NULL, 0, 'default', false, false, 0,
+		true, true, false, true, 1, 42),
+	(1000000, 1, 1, 2, 2, 'HashJoin', '{1,1}', 1.25, 8, 50, 8, NULL, NULL, 2,
+	 'displaced', 1, 'BETTER1', 1.01, 0, 'default', false, false, 0,
+	 false, false, false, false, NULL, -7);
+
+SELECT length(s) AS bytes,
+	md5(substr(s, 1, 8 + get_byte(s, 4) + (get_byte(s, 5) << 8))) AS schema,
+	md5(s) AS stream
+FROM ee.export_arrow(ARRAY[1000000]) AS s;
+
+-- Тот же поток, записанный в файл
+
+\getenv abs_builddir PG_ABS_BUILDDIR
+\set arrow_file :abs_builddir '/results/ee_paths.arrow'
+
+SELECT ee.export_arrow(ARRAY[1000000], :'arrow_file') AS exported;
+
+SELECT pg_read_binary_file(:'arrow_file') = ee.export_arrow(ARRAY[1000000])
+	AS same_stream;
+
+DELETE FROM ee.paths WHERE query_id = 1000000;
+DELETE FROM ee.query WHERE id = 1000000;
+
+SELECT rel_id, rel_name, level, add_path_calls, max_pathlist_len,
+	first_add_path_ms <= last_add_path_ms AS ordered
+FROM ee.rels
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY rel_id;
+
+SELECT rel_id, precheck_calls > 0 AS prechecked
+FROM ee.rels r
+WHERE query_id = (SELECT max(id) FROM ee.query) AND level = 2;
+
+SELECT count(*) > 0 AS rejected,
+	bool_and(join_type = 'inner') AS inner_join,
+	bool_and(path_type IN ('NestLoop', 'MergeJoin', 'HashJoin')) AS join_node,
+	bool_and(outer_rel_id <> inner_rel_id) AS rels
+FROM ee.prechecked_paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND dominated_by IS NOT NULL;
+
+SELECT rel_id, path_id, path_type
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND cheapest_total
+ORDER BY rel_id;
+
+SELECT plan_depth, path_id, path_type, rel_name
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND in_final_plan
+ORDER BY plan_depth, path_id;
+
+SELECT rel_id, relids, rel_aliases
+FROM ee.rels
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY rel_id;
+
+SELECT path_id, array_length(pathkeys, 1) AS npathkeys,
+	pathkeys[1][1] AS eclass, pathkeys[1][3] AS direction,
+	pathkeys[1][4] AS nulls_first, required_outer
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'MergeJoin';
+
+SELECT count(DISTINCT fingerprint) AS fingerprints, count(*) AS paths
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND level = 2;
+
+SELECT set_config('ee.fixate_paths',
+				  string_agg(format('%s,%s,%s', level, fingerprint,
+									round(total_cost * 100)), ','),
+				  false) <> '' AS fixated
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_id IN (1, 2, 3);
+
+EXPLAIN (COSTS OFF, fixate_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+RESET ee.fixate_paths;
+
+-- Отпечаток MergeJoin совпадает, но стоимость вдвое больше указанной: при
+-- ee.fixate_cost_tolerance путь отключается, и план строится соединением
+-- хешированием
+SET ee.fixate_cost_tolerance = 0.01;
+
+SELECT set_config('ee.fixate_paths',
+				  string_agg(format('%s,%s,%s', level, fingerprint,
+									round(total_cost * 100) *
+									CASE WHEN path_id = 3 THEN 2 ELSE 1 END), ','),
+				  false) <> '' AS fixated
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_id IN (1, 2, 3);
+
+EXPLAIN (COSTS OFF, fixate_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+RESET ee.fixate_paths;
+RESET ee.fixate_cost_tolerance;
+
+-- Тройки прежнего формата: уровень, стоимость запуска и полная стоимость
+
+SELECT set_config('ee.fixate_paths',
+				  string_agg(format('%s,%s,%s', level, round(startup_cost * 100),
+									round(total_cost * 100)), ','),
+				  false) <> '' AS fixated
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_id IN (1, 2, 3);
+
+EXPLAIN (COSTS OFF, fixate_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+RESET ee.fixate_paths;
+
+SELECT subquery_id, level, joinrels, join_pairs, cartesian_pairs, time_ms >= 0 AS timed
+FROM ee.join_levels
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY subquery_id, level;
+
+SELECT level, joinrel_id, rel1_id, rel2_id, cartesian, pruned
+FROM ee.join_pairs
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY joinrel_id, rel1_id, rel2_id;
+
+SELECT array_length(subquery_planner_mem_bytes, 1) AS subqueries,
+	planner_mem_bytes >= ALL (subquery_planner_mem_bytes) AS peak,
+	capture_mem_bytes > 0 AS captured
+FROM ee.query
+WHERE id = (SELECT max(id) FROM ee.query);
+
+SELECT paths, paths_saved, paths_displaced + paths_removed AS rejected,
+	paths_prechecked = (SELECT count(*) FROM ee.prechecked_paths p
+						WHERE p.query_id = q.id) AS prechecked,
+	rels, subqueries, max_level, overhead_ms >= 0 AS overhead,
+	planning_ms >= 0 AS planning, final_plan_cost
+FROM ee.query q
+WHERE id = (SELECT max(id) FROM ee.query);
+
+SELECT rtindex, rel_id, name, alias, rows, tuples
+FROM ee.join_graph_rels
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY rtindex;
+
+SELECT eclass_id, members, relids, has_const
+FROM ee.eclasses
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY eclass_id;
+
+SELECT count(*) AS pathkeys, count(e.eclass_id) AS eclasses
+FROM ee.paths p
+	CROSS JOIN LATERAL generate_subscripts(p.pathkeys, 1) AS k
+	LEFT JOIN ee.eclasses e ON e.query_id = p.query_id AND
+		e.subquery_id = p.subquery_id AND e.eclass_id = p.pathkeys[k][1]
+WHERE p.query_id = (SELECT max(id) FROM ee.query);
+
+SELECT count(*) AS join_clauses
+FROM ee.join_clauses
+WHERE query_id = (SELECT max(id) FROM ee.query);
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) SELECT * FROM t1 JOIN t2 ON t1.a < t2.b';
+END $$;
+
+SELECT clause_id, clause, left_relids, right_relids,
+	round(selectivity::numeric, 4) AS selectivity, outer_selectivity,
+	hashable, mergeable
+FROM ee.join_clauses
+WHERE query_id = (SELECT max(id) FROM ee.query);
+
+--
+-- Два класса эквивалентности. Первым в pathkeys встречается второй класс
+-- (индексное сканирование t3 по d), но номера классов -- их позиции в
+-- root->eq_classes. Отпечаток соединения слиянием по второму классу
+-- совпадает при планировании с фиксацией
+--
+
+CREATE TABLE t3 (c int, d int);
+
+INSERT INTO t3 SELECT i, i FROM generate_series(1, 150) AS i;
+
+CREATE INDEX t3_d_idx ON t3 (d);
+
+ANALYZE t3;
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths)
+			 SELECT * FROM t1 JOIN t3 ON t1.a = t3.c JOIN t2 ON t2.b = t3.d';
+END $$;
+
+SELECT eclass_id, members
+FROM ee.eclasses
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY eclass_id;
+
+SELECT DISTINCT path_type, pathkeys[1][1] AS eclass
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND level = 1 AND
+	pathkeys IS NOT NULL;
+
+SELECT set_config('ee.fixate_paths',
+				  string_agg(format('%s,%s,%s', level, fingerprint,
+									round(total_cost * 100)), ','),
+				  false) <> '' AS fixated
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND level = 2 AND
+	path_type = 'MergeJoin' AND pathkeys[1][1] = 2;
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths, fixate_paths)
+			 SELECT * FROM t1 JOIN t3 ON t1.a = t3.c JOIN t2 ON t2.b = t3.d';
+END $$;
+
+RESET ee.fixate_paths;
+
+SELECT path_type, pathkeys[1][1] AS eclass, disabled_nodes,
+	fingerprint IN (SELECT fingerprint
+					FROM ee.paths
+					WHERE query_id = (SELECT max(id) - 1 FROM ee.query)) AS captured
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND level = 2 AND in_final_plan;
+
+--
+-- 2. ee.race
+--
+
+SELECT rank, path_id, path_type, round(estimated_cost::numeric, 2) AS estimated_cost,
+	abs(planned_cost - estimated_cost) <= 0.01 AS same_cost, plan_matched,
+	actual_rows, timed_out, plan
+FROM ee.race('SELECT * FROM t1 JOIN t2 ON t1.a = t2.b', 3)
+ORDER BY rank;
+
+SELECT rank, path_type, timed_out, execution_time IS NULL AS no_timing
+FROM ee.race('SELECT pg_sleep(0.1) FROM t1 JOIN t2 ON t1.a = t2.b', 1, 100);
+
+SELECT count(*) FROM ee.race_results;
+
+--
+-- 3. Режим collapse_partitions
+--
+
+CREATE TABLE pt (a int) PARTITION BY RANGE (a);
+CREATE TABLE pt_1 PARTITION OF pt FOR VALUES FROM (1) TO (101);
+CREATE TABLE pt_2 PARTITION OF pt FOR VALUES FROM (101) TO (201);
+CREATE TABLE pt_3 PARTITION OF pt FOR VALUES FROM (201) TO (301);
+CREATE TABLE pt_4 PARTITION OF pt FOR VALUES FROM (301) TO (401);
+
+INSERT INTO pt SELECT generate_series(1, 400);
+
+ANALYZE pt;
+
+EXPLAIN (COSTS OFF, get_paths, collapse_partitions)
+SELECT * FROM pt WHERE a > 100;
+
+SELECT level, partitions, pruned, min_cost = max_cost AS equal_costs
+FROM ee.partition_groups
+WHERE query_id = (SELECT max(id) FROM ee.query);
+
+SELECT count(*) AS rels
+FROM ee.rels
+WHERE query_id = (SELECT max(id) FROM ee.query);
+
+CREATE TABLE pt2 (b int) PARTITION BY RANGE (b);
+CREATE TABLE pt2_1 PARTITION OF pt2 FOR VALUES FROM (1) TO (101);
+CREATE TABLE pt2_2 PARTITION OF pt2 FOR VALUES FROM (101) TO (201);
+CREATE TABLE pt2_3 PARTITION OF pt2 FOR VALUES FROM (201) TO (301);
+CREATE TABLE pt2_4 PARTITION OF pt2 FOR VALUES FROM (301) TO (401);
+
+INSERT INTO pt2 SELECT generate_series(1, 400);
+
+ANALYZE pt2;
+
+SET enable_partitionwise_join = on;
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths, collapse_partitions)
+			 SELECT * FROM pt JOIN pt2 ON pt.a = pt2.b WHERE pt.a > 100';
+END $$;
+
+RESET enable_partitionwise_join;
+
+SELECT level, partitions, pruned
+FROM ee.partition_groups
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY level, parent_rel_id;
+
+--
+-- 4. Частичные пути
+--
+
+SET min_parallel_table_scan_size = 0;
+
+EXPLAIN (COSTS OFF, get_paths)
+SELECT * FROM t1;
+
+SELECT path_type, add_path_result, parallel_aware, parallel_workers
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND partial AND level = 1;
+
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) SELECT * FROM t1 JOIN t2 ON t1.a = t2.b';
+END $$;
+
+SELECT count(*) FILTER (WHERE add_path_result <> 'saved') > 0 AS rejected,
+	count(*) FILTER (WHERE displaced_by IS NOT NULL) > 0 AS displaced
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND partial AND level = 2;
+
+SELECT DISTINCT g.path_type, g.partial, c.partial AS child_partial
+FROM ee.paths g
+	JOIN ee.paths c ON c.query_id = g.query_id AND c.path_id = g.child_paths[1]
+WHERE g.query_id = (SELECT max(id) FROM ee.query) AND g.path_type = 'Gather';
+
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+
+RESET min_parallel_table_scan_size;
+
+--
+-- 5. Верхние отношения
+--
+
+EXPLAIN (COSTS OFF, get_paths)
+SELECT a, count(*) FROM t1 GROUP BY a;
+
+SELECT level, upper_stage
+FROM ee.rels
+WHERE query_id = (SELECT max(id) FROM ee.query)
+ORDER BY rel_id;
+
+SELECT path_type, agg_strategy, num_groups
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query) AND agg_strategy IS NOT NULL
+ORDER BY path_id;
+
+--
+-- 6. Параметр alternatives
+--
+
+EXPLAIN (COSTS OFF, alternatives)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+--
+-- 7. Журнал сборов (ee.sink = mmap_log)
+--
+
+SET ee.sink = mmap_log;
+
+EXPLAIN (COSTS OFF, get_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+RESET ee.sink;
+
+SELECT path_id, path_type, child_paths, level, add_path_result, displaced_by,
+	in_final_plan
+FROM ee.read_log((SELECT max(segment) FROM pg_ls_dir('ee') AS segment
+				  WHERE split_part(segment, '_', 2)::int = pg_backend_pid()))
+ORDER BY path_id;
+
+SELECT * FROM ee.read_log('../PG_VERSION');
+
+SELECT ee.remove_log('../PG_VERSION');
+
+--
+-- 8. Упакованные пути (ee.sink = packed)
+--
+
+-- Тот же запрос, собранный в таблицы: упакованные пути должны совпасть с
+-- путями ee.paths во всех колонках, кроме query_id
+
+EXPLAIN (COSTS OFF, get_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+SET ee.sink = packed;
+
+EXPLAIN (COSTS OFF, get_paths)
+SELECT * FROM t1 JOIN t2 ON t1.a = t2.b;
+
+RESET ee.sink;
+
+SELECT packed_paths IS NOT NULL AS packed,
+	(SELECT count(*) FROM ee.paths WHERE query_id = q.id) AS table_paths
+FROM ee.query q
+WHERE id = (SELECT max(id) FROM ee.query);
+
+SELECT path_id, path_type, child_paths, level, add_path_result, displaced_by,
+	in_final_plan
+FROM ee.unpack_paths((SELECT max(id) FROM ee.query))
+ORDER BY path_id;
+
+WITH t AS (SELECT to_jsonb(p) - 'query_id' AS path
+		   FROM ee.paths p
+		   WHERE query_id = (SELECT max(id) - 1 FROM ee.query)),
+	u AS (SELECT to_jsonb(p) - 'query_id' AS path
+		  FROM ee.unpack_paths((SELECT max(id) FROM ee.query)) p)
+SELECT (SELECT count(*) FROM t) AS table_paths,
+	(SELECT count(*) FROM (SELECT path FROM u EXCEPT SELECT path FROM t) d) AS only_packed,
+	(SELECT count(*) FROM (SELECT path FROM t EXCEPT SELECT path FROM u) d) AS only_tables;
+
+SELECT rel_id, rank, path_id, plan
+FROM ee.top_plans((SELECT max(id) FROM ee.query), 1)
+ORDER BY rel_id;
+
+--
+-- Очистка
+--
+
+SELECT ee.clear();
+
+SELECT bool_and(ee.remove_log(segment)) AS removed
+FROM pg_ls_dir('ee') AS segment
+WHERE split_part(segment, '_', 2)::int = pg_backend_pid();
+
+DROP TABLE t1, t2, t3, pt, pt2;
@@ -196,7 +196,98 @@ ORDER BY path_id;
 
 SELECT ee.clear();
 
+--
+-- 10. Дочерние пути узлов ModifyTable, SetOp, GroupingSets, Memoize,
+-- LockRows и RecursiveUnion: количество дочерних путей и наличие каждого
+-- из них в ee.paths
+--
+
+CREATE TABLE tm (x int);
+INSERT INTO tm SELECT g % 10 FROM generate_series(1, 1000) g;
+CREATE INDEX ON t3(c);
+ANALYZE tm, t3;
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) UPDATE t3 SET c = c + 1';
+END $$;
+
+SELECT DISTINCT path_type, cardinality(child_paths) AS children,
+	(SELECT count(*) FROM ee.paths c
+	 WHERE c.query_id = p.query_id AND c.path_id = ANY (p.child_paths)) =
+	cardinality(child_paths) AS linked
+FROM ee.paths p
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'ModifyTable';
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) SELECT a FROM t1 INTERSECT SELECT b FROM t2';
+END $$;
+
+SELECT DISTINCT path_type, cardinality(child_paths) AS children,
+	(SELECT count(*) FROM ee.paths c
+	 WHERE c.query_id = p.query_id AND c.path_id = ANY (p.child_paths)) =
+	cardinality(child_paths) AS linked
+FROM ee.paths p
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'SetOp';
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) SELECT a, count(*) FROM t1 GROUP BY GROUPING SETS ((a), ())';
+END $$;
+
+SELECT DISTINCT path_type, cardinality(child_paths) AS children,
+	(SELECT count(*) FROM ee.paths c
+	 WHERE c.query_id = p.query_id AND c.path_id = ANY (p.child_paths)) =
+	cardinality(child_paths) AS linked
+FROM ee.paths p
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'Agg';
+
+SET enable_hashjoin = off;
+SET enable_mergejoin = off;
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) SELECT * FROM tm JOIN t3 ON t3.c = tm.x';
+END $$;
+
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+
+SELECT DISTINCT path_type, cardinality(child_paths) AS children,
+	(SELECT count(*) FROM ee.paths c
+	 WHERE c.query_id = p.query_id AND c.path_id = ANY (p.child_paths)) =
+	cardinality(child_paths) AS linked
+FROM ee.paths p
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'Memoize';
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) SELECT * FROM t1 FOR UPDATE';
+END $$;
+
+SELECT DISTINCT path_type, cardinality(child_paths) AS children,
+	(SELECT count(*) FROM ee.paths c
+	 WHERE c.query_id = p.query_id AND c.path_id = ANY (p.child_paths)) =
+	cardinality(child_paths) AS linked
+FROM ee.paths p
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'LockRows';
+
+DO $$
+BEGIN
+	EXECUTE 'EXPLAIN (get_paths) WITH RECURSIVE r(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM r WHERE n < 3) SELECT * FROM r';
+END $$;
+
+SELECT DISTINCT path_type, cardinality(child_paths) AS children,
+	(SELECT count(*) FROM ee.paths c
+	 WHERE c.query_id = p.query_id AND c.path_id = ANY (p.child_paths)) =
+	cardinality(child_paths) AS linked
+FROM ee.paths p
+WHERE query_id = (SELECT max(id) FROM ee.query) AND path_type = 'RecursiveUnion';
+
+SELECT ee.clear();
+
 --
 -- Очистка
 --
-DROP TABLE test_table, t1, t2, t3;
\ No newline at end of file
+DROP TABLE test_table, t1, t2, t3, tm;
\ No newline at end of file
@@ -15,4 +15,67 @@ SELECT * FROM test_table;
 
 SELECT id, query_text FROM ee.query;
 
-DROP TABLE test_table;
\ No newline at end of file
+--
+-- Параметр save_aborted: пути прерванного планирования записываются при
+-- фиксации следующей транзакции
+--
+
+EXPLAIN (get_paths, save_aborted)
+SELECT * FROM test_table WHERE col = 1 / 0;
+
+BEGIN;
+COMMIT;
+
+SELECT id = (SELECT max(id) FROM ee.query) AS last_query, status, error_message
+FROM ee.query
+WHERE status <> 'completed';
+
+DROP TABLE test_table;
+
+--
+-- EXPLAIN (get_paths) EXECUTE: пути generic и custom планов и статистика
+-- plancache при принудительном выборе вида плана
+--
+
+CREATE TABLE test_table(col integer);
+INSERT INTO test_table SELECT generate_series(1,1000);
+
+PREPARE generic_q(int) AS SELECT * FROM test_table WHERE col = $1;
+PREPARE custom_q(int) AS SELECT * FROM test_table WHERE col = $1;
+
+SET plan_cache_mode = force_generic_plan;
+
+EXPLAIN (COSTS OFF, get_paths) EXECUTE generic_q(1);
+
+SELECT plancache_generic_cost > 0 AS generic_cost,
+	plancache_avg_custom_cost IS NULL AS no_custom_cost,
+	plancache_custom_plans, plancache_choice
+FROM ee.query
+WHERE id = (SELECT max(id) FROM ee.query);
+
+SELECT plan_kind, count(*) > 0 AS captured
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query)
+GROUP BY plan_kind
+ORDER BY plan_kind;
+
+SET plan_cache_mode = force_custom_plan;
+
+EXPLAIN (COSTS OFF, get_paths) EXECUTE custom_q(1);
+
+SELECT plancache_generic_cost IS NULL AS no_generic_cost,
+	plancache_avg_custom_cost > 0 AS custom_cost,
+	plancache_custom_plans, plancache_choice
+FROM ee.query
+WHERE id = (SELECT max(id) FROM ee.query);
+
+SELECT plan_kind, count(*) > 0 AS captured
+FROM ee.paths
+WHERE query_id = (SELECT max(id) FROM ee.query)
+GROUP BY plan_kind
+ORDER BY plan_kind;
+
+RESET plan_cache_mode;
+DEALLOCATE generic_q;
+DEALLOCATE custom_q;
+DROP TABLE test_table;
@@ -0,0 +1,59 @@
+--
+-- Сбор путей запросов из pg_stat_statements (ee.capture_top_statements)
+--
+-- Сбор выполняется, только если pg_stat_statements загружен через
+-- shared_preload_libraries. Вывод в этом случае -- eestatements_1.out
+--
+
+SET debug_parallel_query = off;
+SET jit = off;
+
+CREATE TABLE ct (a int);
+
+INSERT INTO ct SELECT generate_series(1, 100);
+
+ANALYZE ct;
+
+--
+-- 1. Проверка аргументов
+--
+
+SELECT * FROM ee.capture_top_statements(0);
+
+-- Расширение pg_stat_statements не установлено в базе данных
+SELECT * FROM ee.capture_top_statements(1);
+
+--
+-- 2. Сбор путей generic плана запроса с параметром
+--
+
+SELECT current_setting('shared_preload_libraries') ~ 'pg_stat_statements'
+	AS pgss_loaded \gset
+
+\if :pgss_loaded
+CREATE EXTENSION pg_stat_statements;
+SET pg_stat_statements.track_utility = off;
+SELECT pg_stat_statements_reset() IS NOT NULL AS reset;
+
+SELECT count(*) FROM ct WHERE a = 1;
+
+-- Строки ee.query, записанные функцией, не видны в снимке вызвавшей ее команды
+CREATE TEMP TABLE captured AS SELECT * FROM ee.capture_top_statements(10);
+
+SELECT q.query_text, count(p.path_id) > 0 AS has_paths
+FROM captured AS c
+	JOIN ee.query q ON q.id = c.query_id AND q.queryid = c.queryid
+	LEFT JOIN ee.paths p ON p.query_id = q.id
+WHERE q.query_text LIKE '%FROM ct%'
+GROUP BY q.query_text;
+
+DROP TABLE captured;
+RESET pg_stat_statements.track_utility;
+DROP EXTENSION pg_stat_statements;
+\endif
+
+--
+-- Очистка
+--
+
+DROP TABLE ct;
@@ -0,0 +1,647 @@
+/*-------------------------------------------------------------------------
+ *
+ * top_plans.c
+ *    Ранжирование записанных путей отношений по стоимости
+ *
+ * Записанные в ee.paths пути образуют граф: каждый путь ссылается на свои
+ * дочерние пути, поэтому любой путь вместе с потомками является полным
+ * планом для своего отношения. Для каждого запроса/подзапроса
+ * рассматриваются два отношения: итоговое (UPPERREL_FINAL) и отношение,
+ * соединяющее все базовые отношения подзапроса. Для каждого из них
+ * выводятся K самых дешевых планов и их отличия от плана, выбранного
+ * планировщиком.
+ *
+ * Это не перебор K наилучших комбинаций путей дочерних отношений: дочерние
+ * пути каждого записанного пути зафиксированы планировщиком при его
+ * создании, а стоимость пути с другими дочерними путями неизвестна (путь
+ * не строился). Поэтому выводятся не K наилучших планов запроса, а K самых
+ * дешевых записанных путей самого отношения, каждый вместе со своими
+ * потомками.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "include/top_plans.h"
+
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+
+#define NUM_OF_COLS_TOP_PLANS 13
+
+typedef struct EEPlanNodeHashEntry
+{
+	int64		path_id;
+	EEPlanNode *node;
+} EEPlanNodeHashEntry;
+
+/*
+ * Отношение, для которого перебираются планы
+ */
+typedef struct EETopRel
+{
+	int64		subquery_id;
+	int64		rel_id;
+	int			level;
+	List	   *nodes;
+} EETopRel;
+
+/*
+ * Сравнение путей по стоимости так же, как это делает планировщик:
+ * сначала количество отключенных узлов, затем полная и начальная стоимости.
+ */
+static int
+plan_node_cost_cmp(const void *a, const void *b)
+{
+	EEPlanNode *n1 = *(EEPlanNode *const *) a;
+	EEPlanNode *n2 = *(EEPlanNode *const *) b;
+
+	if (n1->disabled_nodes != n2->disabled_nodes)
+		return n1->disabled_nodes < n2->disabled_nodes ? -1 : 1;
+	if (n1->total_cost != n2->total_cost)
+		return n1->total_cost < n2->total_cost ? -1 : 1;
+	if (n1->startup_cost != n2->startup_cost)
+		return n1->startup_cost < n2->startup_cost ? -1 : 1;
+	if (n1->path_id != n2->path_id)
+		return n1->path_id < n2->path_id ? -1 : 1;
+	return 0;
+}
+
+static int
+cstring_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/*
+ * Чтение всех путей EXPLAIN запроса query_id из таблицы ee.paths или из
+ * ee.query.packed_paths, если пути были упакованы.
+ *
+ * Возвращает список EEPlanNode в порядке возрастания path_id. Память
+ * выделяется в контексте ctx.
+ */
+List *
+ee_load_plan_nodes(int64 query_id, MemoryContext ctx)
+{
+	Oid			argtypes[1] = {INT8OID};
+	Datum		args[1];
+	HASHCTL		hash_ctl;
+	HTAB	   *node_by_id;
+	List	   *nodes = NIL;
+	List	   *child_ids = NIL;
+	ListCell   *lc1;
+	ListCell   *lc2;
+	uint64		i;
+
+	args[0] = Int64GetDatum(query_id);
+
+	SPI_connect();
+
+	if (SPI_execute_with_args("SELECT path_id, subquery_id, rel_id, level, path_type, "
+							  "coalesce(rel_alias, rel_name), startup_cost, total_cost, "
+							  "disabled_nodes, add_path_result, child_paths, partial, "
+							  "in_final_plan, displaced_by, fingerprint, rel_name "
+							  "FROM (SELECT * FROM ee.paths WHERE query_id = $1 "
+							  "UNION ALL SELECT * FROM ee.unpack_paths($1)) p "
+							  "ORDER BY path_id",
+							  1, argtypes, args, NULL, true, 0) != SPI_OK_SELECT)
+		elog(ERROR, "could not read ee.paths");
+
+	memset(&hash_ctl, 0, sizeof(HASHCTL));
+	hash_ctl.keysize = sizeof(int64);
+	hash_ctl.entrysize = sizeof(EEPlanNodeHashEntry);
+	hash_ctl.hcxt = ctx;
+	node_by_id = hash_create("EEPlanNode by path_id", Max(SPI_processed, 32),
+							 &hash_ctl, HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+
+	for (i = 0; i < SPI_processed; i++)
+	{
+		HeapTuple	tuple = SPI_tuptable->vals[i];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+		MemoryContext old_ctx;
+		EEPlanNode *node;
+		EEPlanNodeHashEntry *entry;
+		char	   *result;
+		Datum		value;
+		bool		isnull;
+
+		old_ctx = MemoryContextSwitchTo(ctx);
+
+		node = (EEPlanNode *) palloc0(sizeof(EEPlanNode));
+
+		node->path_id = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+		node->subquery_id = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 2, &isnull));
+		node->rel_id = DatumGetInt64(SPI_getbinval(tuple, tupdesc, 3, &isnull));
+		node->level = DatumGetInt32(SPI_getbinval(tuple, tupdesc, 4, &isnull));
+		node->path_type = SPI_getvalue(tuple, tupdesc, 5);
+		node->rel_label = SPI_getvalue(tuple, tupdesc, 6);
+		if (node->rel_label == NULL)
+			node->rel_label = psprintf("rel " INT64_FORMAT, node->rel_id);
+		node->startup_cost = DatumGetFloat8(SPI_getbinval(tuple, tupdesc, 7, &isnull));
+		node->total_cost = DatumGetFloat8(SPI_getbinval(tuple, tupdesc, 8, &isnull));
+		value = SPI_getbinval(tuple, tupdesc, 9, &isnull);
+		node->disabled_nodes = isnull ? 0 : DatumGetInt32(value);
+
+		result = SPI_getvalue(tuple, tupdesc, 10);
+		node->saved = (result != NULL && strcmp(result, "saved") == 0);
+		node->add_path_result = result;
+
+		value = SPI_getbinval(tuple, tupdesc, 12, &isnull);
+		node->partial = !isnull && DatumGetBool(value);
+
+		value = SPI_getbinval(tuple, tupdesc, 13, &isnull);
+		node->in_final_plan = !isnull && DatumGetBool(value);
+
+		value = SPI_getbinval(tuple, tupdesc, 14, &isnull);
+		node->displaced_by = isnull ? 0 : DatumGetInt64(value);
+
+		value = SPI_getbinval(tuple, tupdesc, 15, &isnull);
+		node->fingerprint = isnull ? 0 : DatumGetInt64(value);
+
+		node->rel_name = SPI_getvalue(tuple, tupdesc, 16);
+
+		node->tree_size = -1;
+		node->tree_depth = -1;
+
+		/* Дочерние пути связываются после чтения всех путей */
+		value = SPI_getbinval(tuple, tupdesc, 11, &isnull);
+		if (isnull)
+			child_ids = lappend(child_ids, NULL);
+		else
+			child_ids = lappend(child_ids, DatumGetArrayTypePCopy(value));
+
+		nodes = lappend(nodes, node);
+
+		entry = (EEPlanNodeHashEntry *) hash_search(node_by_id, &node->path_id,
+													HASH_ENTER, NULL);
+		entry->node = node;
+
+		MemoryContextSwitchTo(old_ctx);
+	}
+
+	SPI_finish();
+
+	forboth(lc1, nodes, lc2, child_ids)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc1);
+		ArrayType  *arr = (ArrayType *) lfirst(lc2);
+		Datum	   *elems;
+		bool	   *elem_nulls;
+		int			nelems;
+		int			j;
+
+		if (arr == NULL)
+			continue;
+
+		deconstruct_array(arr, INT8OID, 8, true, TYPALIGN_DOUBLE,
+						  &elems, &elem_nulls, &nelems);
+
+		node->children = (EEPlanNode **) MemoryContextAlloc(ctx, sizeof(EEPlanNode *) * nelems);
+
+		for (j = 0; j < nelems; j++)
+		{
+			int64		child_id;
+			EEPlanNodeHashEntry *entry;
+
+			if (elem_nulls[j])
+				continue;
+
+			child_id = DatumGetInt64(elems[j]);
+			entry = (EEPlanNodeHashEntry *) hash_search(node_by_id, &child_id,
+														HASH_FIND, NULL);
+
+			/* Дочерний путь мог быть скрыт опцией hide_disabled */
+			if (entry != NULL)
+				node->children[node->nchild++] = entry->node;
+		}
+	}
+
+	return nodes;
+}
+
+/*
+ * Вычисление размера и глубины дерева плана с корнем в node.
+ *
+ * Подпланы общие для многих путей, поэтому результат запоминается в самом
+ * пути и каждый путь обрабатывается один раз.
+ */
+static void
+compute_tree_stats(EEPlanNode *node)
+{
+	int			i;
+
+	if (node->tree_size >= 0)
+		return;
+
+	check_stack_depth();
+
+	node->tree_size = 1;
+	node->tree_depth = 1;
+
+	for (i = 0; i < node->nchild; i++)
+	{
+		EEPlanNode *child = node->children[i];
+
+		compute_tree_stats(child);
+
+		node->tree_size += child->tree_size;
+		node->tree_depth = Max(node->tree_depth, child->tree_depth + 1);
+	}
+}
+
+/*
+ * Сбор всех узлов дерева плана с корнем в root (в порядке обхода в глубину).
+ */
+void
+ee_collect_plan_nodes(EEPlanNode *root, List **nodes)
+{
+	int			i;
+
+	check_stack_depth();
+
+	*nodes = lappend(*nodes, root);
+
+	for (i = 0; i < root->nchild; i++)
+		ee_collect_plan_nodes(root->children[i], nodes);
+}
+
+/*
+ * Поиск или создание отношения в списке отношений, для которых
+ * перебираются планы.
+ */
+static EETopRel *
+get_top_rel(List **top_rels, int64 subquery_id, bool final)
+{
+	ListCell   *lc;
+	EETopRel   *top_rel;
+
+	foreach(lc, *top_rels)
+	{
+		top_rel = (EETopRel *) lfirst(lc);
+
+		if (top_rel->subquery_id == subquery_id &&
+			(top_rel->level == 0) == final)
+			return top_rel;
+	}
+
+	top_rel = (EETopRel *) palloc0(sizeof(EETopRel));
+	top_rel->subquery_id = subquery_id;
+	top_rel->rel_id = -1;
+	top_rel->level = final ? 0 : -1;
+
+	*top_rels = lappend(*top_rels, top_rel);
+
+	return top_rel;
+}
+
+/*
+ * Получение K самых дешевых записанных путей (вместе с потомками) для
+ * каждого запроса/подзапроса EXPLAIN запроса query_id.
+ *
+ * Для каждого запроса/подзапроса перебираются пути двух отношений:
+ * итогового (последнее созданное верхнее отношение подзапроса) и отношения
+ * с наибольшим количеством соединенных базовых отношений. Планы каждого
+ * отношения упорядочиваются по стоимости. Выбранным считается путь,
+ * вошедший в итоговый план (in_final_plan); если такого пути у отношения нет
+ * (например, планирование было прервано), -- самый дешевый из сохраненных в
+ * pathlist путей.
+ */
+List *
+ee_get_top_plans(int64 query_id, int k)
+{
+	List	   *nodes;
+	List	   *top_rels = NIL;
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	nodes = ee_load_plan_nodes(query_id, CurrentMemoryContext);
+
+	/*
+	 * Определяем итоговое отношение и отношение верхнего уровня соединения
+	 * для каждого подзапроса.
+	 */
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+		EETopRel   *top_rel;
+
+		if (node->level == 0)
+		{
+			top_rel = get_top_rel(&top_rels, node->subquery_id, true);
+
+			if (top_rel->rel_id < node->rel_id)
+				top_rel->rel_id = node->rel_id;
+		}
+		else
+		{
+			top_rel = get_top_rel(&top_rels, node->subquery_id, false);
+
+			if (top_rel->level < node->level ||
+				(top_rel->level == node->level && top_rel->rel_id < node->rel_id))
+			{
+				top_rel->level = node->level;
+				top_rel->rel_id = node->rel_id;
+			}
+		}
+	}
+
+	foreach(lc, nodes)
+	{
+		EEPlanNode *node = (EEPlanNode *) lfirst(lc);
+		ListCell   *lc2;
+
+		/*
+		 * Частичные пути исполняются только под Gather/GatherMerge и
+		 * полными планами не являются.
+		 */
+		if (node->partial)
+			continue;
+
+		foreach(lc2, top_rels)
+		{
+			EETopRel   *top_rel = (EETopRel *) lfirst(lc2);
+
+			if (top_rel->subquery_id == node->subquery_id &&
+				top_rel->rel_id == node->rel_id)
+			{
+				top_rel->nodes = lappend(top_rel->nodes, node);
+				break;
+			}
+		}
+	}
+
+	foreach(lc, top_rels)
+	{
+		EETopRel   *top_rel = (EETopRel *) lfirst(lc);
+		int			nnodes = list_length(top_rel->nodes);
+		EEPlanNode **sorted;
+		EEPlanNode *chosen = NULL;
+		ListCell   *lc2;
+		int			i;
+
+		sorted = (EEPlanNode **) palloc(sizeof(EEPlanNode *) * nnodes);
+
+		i = 0;
+		foreach(lc2, top_rel->nodes)
+			sorted[i++] = (EEPlanNode *) lfirst(lc2);
+
+		qsort(sorted, nnodes, sizeof(EEPlanNode *), plan_node_cost_cmp);
+
+		for (i = 0; i < nnodes; i++)
+		{
+			if (sorted[i]->in_final_plan)
+			{
+				chosen = sorted[i];
+				break;
+			}
+		}
+
+		for (i = 0; i < nnodes && chosen == NULL; i++)
+		{
+			if (sorted[i]->saved)
+				chosen = sorted[i];
+		}
+
+		if (chosen == NULL)
+			chosen = sorted[0];
+
+		compute_tree_stats(chosen);
+
+		for (i = 0; i < nnodes && i < k; i++)
+		{
+			EETopPlan  *top_plan = (EETopPlan *) palloc0(sizeof(EETopPlan));
+
+			compute_tree_stats(sorted[i]);
+
+			top_plan->subquery_id = top_rel->subquery_id;
+			top_plan->rel_id = top_rel->rel_id;
+			top_plan->rank = i + 1;
+			top_plan->root = sorted[i];
+			top_plan->chosen = chosen;
+
+			result = lappend(result, top_plan);
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Название узла плана для вывода: тип пути и отношение.
+ */
+static char *
+plan_node_label(EEPlanNode *node)
+{
+	return psprintf("%s[%s]", node->path_type ? node->path_type : "?",
+					node->rel_label);
+}
+
+/*
+ * Название узла плана для сравнения планов: помимо типа пути и отношения
+ * содержит отношения дочерних путей, чтобы различать, например, соединения
+ * с переставленными внешним и внутренним отношениями.
+ */
+static char *
+plan_node_signature(EEPlanNode *node)
+{
+	StringInfoData buf;
+	int			i;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, plan_node_label(node));
+
+	if (node->nchild > 0)
+	{
+		appendStringInfoChar(&buf, '(');
+		for (i = 0; i < node->nchild; i++)
+		{
+			if (i > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf, node->children[i]->rel_label);
+		}
+		appendStringInfoChar(&buf, ')');
+	}
+
+	return buf.data;
+}
+
+/*
+ * Компактное текстовое представление дерева плана
+ */
+static void
+append_plan_text(StringInfo buf, EEPlanNode *node)
+{
+	int			i;
+
+	check_stack_depth();
+
+	appendStringInfoString(buf, plan_node_label(node));
+
+	if (node->nchild == 0)
+		return;
+
+	appendStringInfoChar(buf, '(');
+	for (i = 0; i < node->nchild; i++)
+	{
+		if (i > 0)
+			appendStringInfoString(buf, ", ");
+		append_plan_text(buf, node->children[i]);
+	}
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * Компактное текстовое представление дерева плана с корнем в root,
+ * например "HashJoin[rel 3](SeqScan[t2], SeqScan[t1])".
+ */
+char *
+ee_plan_text(EEPlanNode *root)
+{
+	StringInfoData buf;
+
+	initStringInfo(&buf);
+	append_plan_text(&buf, root);
+
+	return buf.data;
+}
+
+/*
+ * Отличия плана root от выбранного плана chosen.
+ *
+ * Узлы обоих планов сравниваются как мультимножества названий вида
+ * "HashJoin[rel 3](t2, t1)": узлы, которые есть только в плане root,
+ * помечаются знаком "+", узлы, которые есть только в выбранном плане, --
+ * знаком "-".
+ */
+static Datum
+plan_differences(EEPlanNode *root, EEPlanNode *chosen)
+{
+	List	   *nodes1 = NIL;
+	List	   *nodes2 = NIL;
+	char	  **labels1;
+	char	  **labels2;
+	Datum	   *diffs;
+	int			n1;
+	int			n2;
+	int			ndiffs = 0;
+	int			i;
+	int			j;
+	ListCell   *lc;
+
+	ee_collect_plan_nodes(root, &nodes1);
+	ee_collect_plan_nodes(chosen, &nodes2);
+
+	n1 = list_length(nodes1);
+	n2 = list_length(nodes2);
+
+	labels1 = (char **) palloc(sizeof(char *) * n1);
+	labels2 = (char **) palloc(sizeof(char *) * n2);
+	diffs = (Datum *) palloc(sizeof(Datum) * (n1 + n2));
+
+	i = 0;
+	foreach(lc, nodes1)
+		labels1[i++] = plan_node_signature((EEPlanNode *) lfirst(lc));
+
+	i = 0;
+	foreach(lc, nodes2)
+		labels2[i++] = plan_node_signature((EEPlanNode *) lfirst(lc));
+
+	qsort(labels1, n1, sizeof(char *), cstring_cmp);
+	qsort(labels2, n2, sizeof(char *), cstring_cmp);
+
+	i = 0;
+	j = 0;
+	while (i < n1 || j < n2)
+	{
+		int			cmp;
+
+		if (i >= n1)
+			cmp = 1;
+		else if (j >= n2)
+			cmp = -1;
+		else
+			cmp = strcmp(labels1[i], labels2[j]);
+
+		if (cmp == 0)
+		{
+			i++;
+			j++;
+		}
+		else if (cmp < 0)
+			diffs[ndiffs++] = CStringGetTextDatum(psprintf("+%s", labels1[i++]));
+		else
+			diffs[ndiffs++] = CStringGetTextDatum(psprintf("-%s", labels2[j++]));
+	}
+
+	return PointerGetDatum(construct_array(diffs, ndiffs, TEXTOID, -1, false,
+										   TYPALIGN_INT));
+}
+
+/*
+ * ee.top_plans(query_id, k) -- K самых дешевых записанных путей каждого
+ * запроса/подзапроса EXPLAIN запроса query_id.
+ */
+PG_FUNCTION_INFO_V1(ee_top_plans);
+
+Datum
+ee_top_plans(PG_FUNCTION_ARGS)
+{
+	int64		query_id = PG_GETARG_INT64(0);
+	int32		k = PG_GETARG_INT32(1);
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	List	   *top_plans;
+	ListCell   *lc;
+
+	if (k <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of plans must be positive")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	top_plans = ee_get_top_plans(query_id, k);
+
+	foreach(lc, top_plans)
+	{
+		EETopPlan  *top_plan = (EETopPlan *) lfirst(lc);
+		EEPlanNode *root = top_plan->root;
+		Datum		values[NUM_OF_COLS_TOP_PLANS];
+		bool		nulls[NUM_OF_COLS_TOP_PLANS];
+
+		memset(nulls, 0x00, sizeof(bool) * NUM_OF_COLS_TOP_PLANS);
+
+		values[0] = Int64GetDatum(top_plan->subquery_id);
+		values[1] = Int64GetDatum(top_plan->rel_id);
+		values[2] = Int32GetDatum(top_plan->rank);
+		values[3] = Int64GetDatum(root->path_id);
+
+		if (root->path_type == NULL)
+			nulls[4] = true;
+		else
+			values[4] = CStringGetTextDatum(root->path_type);
+
+		values[5] = Float8GetDatum(root->startup_cost);
+		values[6] = Float8GetDatum(root->total_cost);
+
+		if (top_plan->chosen->total_cost > 0)
+			values[7] = Float8GetDatum(root->total_cost / top_plan->chosen->total_cost);
+		else
+			nulls[7] = true;
+
+		values[8] = BoolGetDatum(root == top_plan->chosen);
+		values[9] = Int32GetDatum(root->tree_size);
+		values[10] = Int32GetDatum(root->tree_depth);
+		values[11] = CStringGetTextDatum(ee_plan_text(root));
+		values[12] = plan_differences(root, top_plan->chosen);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}